@@ -1,6 +1,19 @@
 
 # Compile Step
-gcc src/main/main.c -lm -o src/main/main
+gcc -c -fPIC src/main/calql8r.c -o src/main/calql8r.o
+gcc -c -fPIC src/main/calql8r_program.c -o src/main/calql8r_program.o
+gcc -c -fPIC src/main/calql8r_arena.c -o src/main/calql8r_arena.o
+gcc -c -fPIC src/main/calql8r_columns.c -o src/main/calql8r_columns.o
+gcc -c -fPIC src/main/calql8r_cache.c -o src/main/calql8r_cache.o
+gcc -c -fPIC src/main/calql8r_tree.c -o src/main/calql8r_tree.o
+gcc -c -fPIC src/main/calql8r_number.c -o src/main/calql8r_number.o
+gcc -c -fPIC src/main/calql8r_jit.c -o src/main/calql8r_jit.o
+gcc -c -fPIC src/main/calql8r_integer.c -o src/main/calql8r_integer.o
+gcc -c -fPIC src/main/calql8r_session.c -o src/main/calql8r_session.o
+gcc -c -fPIC src/main/calql8r_gradient.c -o src/main/calql8r_gradient.o
+ar rcs src/main/libcalql8r.a src/main/calql8r*.o
+gcc -shared -fPIC src/main/calql8r*.c -lm -o src/main/libcalql8r.so
+gcc -pthread src/main/main.c src/main/batch.c src/main/batch_pool.c src/main/server.c src/main/shm.c src/main/sweep.c src/main/libcalql8r.a -lm -o src/main/main
 
 echo Main-Class: src.main.Main> src/main/MANIFEST.MF
 javac src/main/Main.java
@@ -0,0 +1,121 @@
+// Checks that calculating expressions doesn't go to the heap once the context has warmed up. Every malloc, calloc
+// and realloc of the program is counted (src/bench/malloc_count.c) over a round of a generated corpus after a first
+// warm up round, next to what calql8r_heap_allocations says for the context.
+// Exits with a failure when calql8r_eval used the heap in the second round, compile, run and columns are only shown.
+// bench_allocations [--count expressions] [--rows n] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calql8r.h"
+#include "corpus.h"
+#include "malloc_count.h"
+
+#define DEFAULT_COUNT 1000
+#define DEFAULT_ROWS 1000
+
+// keeps the answers alive so the calculations can't be optimized away
+volatile double sink;
+
+void print_stage(const char* stage, long long operations, size_t mallocs, size_t context){
+    printf("%s,%lld,%zu,%.3f,%zu\n", stage, operations, mallocs, operations > 0 ? (double) mallocs / operations : 0, context);
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    int count = DEFAULT_COUNT;
+    size_t rows = DEFAULT_ROWS;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = (size_t) atol(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(rows < 1) rows = 1;
+    // the columns are for programs without variables
+    corpus.variables = "";
+
+    const size_t buffer_size = corpus_buffer_size(&corpus);
+    char* texts = (char *) malloc(buffer_size * count);
+    size_t* lengths = (size_t *) malloc(sizeof (size_t) * count);
+    struct CalQl8rProgram** programs = (struct CalQl8rProgram**) calloc(count, sizeof (struct CalQl8rProgram*));
+    double* results = (double *) malloc(sizeof (double) * rows);
+    struct CalQl8r* ctx = calql8r_create();
+    if(texts == NULL || lengths == NULL || programs == NULL || results == NULL || ctx == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+    if(!malloc_counted()) fprintf(stderr, "malloc can't be counted without glibc, only the context is checked\n");
+
+    // warm up round, the context grows to the biggest expression and every program is compiled once
+    for(int i = 0; i < count; i++){
+        char* text = texts + buffer_size * i;
+        lengths[i] = corpus_expression(&corpus, text);
+        double answer;
+        calql8r_eval(ctx, text, lengths[i], &answer);
+        if(calql8r_compile(ctx, text, lengths[i], &programs[i]) != CAL_OK) programs[i] = NULL;
+        if(programs[i] != NULL) calql8r_run(programs[i], &answer);
+    }
+
+    printf("stage,expressions,mallocs,mallocs_per_op,context_allocations\n");
+
+    size_t mallocs = malloc_count();
+    size_t context = calql8r_heap_allocations(ctx);
+    for(int i = 0; i < count; i++){
+        double answer = 0;
+        calql8r_eval(ctx, texts + buffer_size * i, lengths[i], &answer);
+        sink = answer;
+    }
+    const size_t eval_mallocs = malloc_count() - mallocs;
+    const size_t eval_context = calql8r_heap_allocations(ctx) - context;
+    print_stage("eval", count, eval_mallocs, eval_context);
+
+    mallocs = malloc_count();
+    context = calql8r_heap_allocations(ctx);
+    long long operations = 0;
+    for(int i = 0; i < count; i++){
+        struct CalQl8rProgram* program;
+        if(calql8r_compile(ctx, texts + buffer_size * i, lengths[i], &program) == CAL_OK) calql8r_program_free(program);
+        operations++;
+    }
+    print_stage("compile", operations, malloc_count() - mallocs, calql8r_heap_allocations(ctx) - context);
+
+    mallocs = malloc_count();
+    operations = 0;
+    for(int i = 0; i < count; i++){
+        if(programs[i] == NULL) continue;
+        double answer = 0;
+        calql8r_run(programs[i], &answer);
+        sink = answer;
+        operations++;
+    }
+    print_stage("run", operations, malloc_count() - mallocs, 0);
+
+    mallocs = malloc_count();
+    operations = 0;
+    for(int i = 0; i < count; i++){
+        if(programs[i] == NULL) continue;
+        calql8r_run_columns(programs[i], NULL, rows, results);
+        sink = results[0];
+        operations++;
+    }
+    print_stage("columns", operations, malloc_count() - mallocs, 0);
+
+    for(int i = 0; i < count; i++) if(programs[i] != NULL) calql8r_program_free(programs[i]);
+    free(texts);
+    free(lengths);
+    free(programs);
+    free(results);
+    calql8r_destroy(ctx);
+
+    if(eval_mallocs > 0 || eval_context > 0){
+        fprintf(stderr, "calql8r_eval used the heap after warming up\n");
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
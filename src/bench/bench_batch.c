@@ -0,0 +1,77 @@
+// Batch mode scaling from 1 to N threads.
+// bench_batch [max threads] [lines]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "calql8r.h"
+#include "batch.h"
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#define DEFAULT_LINES 200000
+#define EXPENSIVE_EVERY 200
+
+double seconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// short formulas with now and then a long one so the threads don't get equal work
+void write_corpus(FILE* file, int lines){
+    static const char* formulas[] = {
+        "1465+225+55.7*36/8", "S(p/2)*2r4+6!", "(1+2)*(3+4)-5^2", "2l8+L100-E(3)",
+        "C(p/3)^2+S(p/3)^2", "10Z3+5Y2-4!", "-3.5*(2-7.25)/0.5", "3r27+2^10/1024"
+    };
+    const int count = sizeof formulas / sizeof formulas[0];
+    srand(1);
+
+    for(int i = 0; i < lines; i++){
+        if(i % EXPENSIVE_EVERY == 0){
+            int terms = 500 + rand() % 1500;
+            for(int t = 0; t < terms; t++) fprintf(file, t == 0 ? "(%d*1.5)" : "+(%d*1.5)", rand() % 100);
+            fputc('\n', file);
+        } else {
+            fprintf(file, "%s+%d\n", formulas[rand() % count], rand() % 1000);
+        }
+    }
+}
+
+int main(int argc, char *argv[]){
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int lines = argc > 2 ? atoi(argv[2]) : DEFAULT_LINES;
+    if(max_threads < 1) max_threads = 1;
+
+    FILE* corpus = tmpfile();
+    FILE* output = fopen(NULL_DEVICE, "wb");
+    if(corpus == NULL || output == NULL){
+        fprintf(stderr, "CAN NOT CREATE FILES\n");
+        return EXIT_FAILURE;
+    }
+    write_corpus(corpus, lines);
+
+    printf("threads,seconds,lines_per_second,speedup\n");
+    double single = 0;
+    for(int threads = 1; threads <= max_threads; threads++){
+        rewind(corpus);
+        double start = seconds_now();
+        int status = run_batch(corpus, output, threads);
+        double elapsed = seconds_now() - start;
+        if(status != CAL_OK){
+            fprintf(stderr, "BATCH FAILED WITH %d THREADS\n", threads);
+            return EXIT_FAILURE;
+        }
+
+        if(threads == 1) single = elapsed;
+        printf("%d,%.3f,%.0f,%.2f\n", threads, elapsed, lines / elapsed, single / elapsed);
+    }
+
+    fclose(corpus);
+    fclose(output);
+    return 0;
+}
@@ -0,0 +1,96 @@
+// calql8r_eval on expressions with thousands of bracket groups, nested e.g ((((1+1)+1)+1)+1)
+// and side by side e.g (1+1)+(1+1)+(1+1). The time per group should stay the same as the groups go up.
+// bench_brackets [most groups]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "calql8r.h"
+
+#define DEFAULT_GROUPS 16000
+#define FIRST_GROUPS 1000
+#define MIN_NANOSECONDS 200000000LL
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// "(((1+1)+1)+1)" with 'groups' brackets, gives the length
+size_t write_nested(char* text, int groups){
+    size_t length = 0;
+    for(int i = 0; i < groups; i++) text[length++] = '(';
+    text[length++] = '1';
+    for(int i = 0; i < groups; i++){
+        memcpy(text + length, "+1)", 3);
+        length += 3;
+    }
+    return length;
+}
+
+// "(1+1)+(1+1)+(1+1)" with 'groups' brackets
+size_t write_siblings(char* text, int groups){
+    size_t length = 0;
+    for(int i = 0; i < groups; i++){
+        if(i > 0) text[length++] = '+';
+        memcpy(text + length, "(1+1)", 5);
+        length += 5;
+    }
+    return length;
+}
+
+// "((1+1)+(1+1))+((1+1)+(1+1))", pairs of siblings inside brackets
+size_t write_mixed(char* text, int groups){
+    size_t length = 0;
+    for(int i = 0; i + 3 <= groups; i += 3){
+        if(i > 0) text[length++] = '+';
+        memcpy(text + length, "((1+1)+(1+1))", 13);
+        length += 13;
+    }
+    return length;
+}
+
+void bench_shape(struct CalQl8r* ctx, const char* shape, size_t (*write_text)(char*, int), char* text, int groups){
+    const size_t length = write_text(text, groups);
+
+    // run it at least a few times and for long enough to time
+    double answer = 0;
+    int status = CAL_OK;
+    long long runs = 0;
+    const long long start = nanoseconds_now();
+    long long elapsed = 0;
+    do{
+        status = calql8r_eval(ctx, text, length, &answer);
+        runs++;
+        elapsed = nanoseconds_now() - start;
+    } while(elapsed < MIN_NANOSECONDS && runs < 1000000);
+
+    const double ns_per_expression = (double) elapsed / runs;
+    printf("%s,%d,%zu,%.0f,%.1f,%s\n", shape, groups, length, ns_per_expression, ns_per_expression / groups,
+        status == CAL_OK ? "ok" : calql8r_error_message(status));
+}
+
+int main(int argc, char *argv[]){
+    int most_groups = argc > 1 ? atoi(argv[1]) : DEFAULT_GROUPS;
+    if(most_groups < FIRST_GROUPS) most_groups = FIRST_GROUPS;
+
+    // siblings are the longest, 6 characters per group
+    char* text = (char *) malloc((size_t) most_groups * 6 + 16);
+    struct CalQl8r* ctx = calql8r_create();
+    if(text == NULL || ctx == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    printf("shape,groups,characters,ns_per_expression,ns_per_group,status\n");
+    for(int groups = FIRST_GROUPS; groups <= most_groups; groups *= 2){
+        bench_shape(ctx, "nested", write_nested, text, groups);
+        bench_shape(ctx, "siblings", write_siblings, text, groups);
+        bench_shape(ctx, "mixed", write_mixed, text, groups);
+    }
+
+    free(text);
+    calql8r_destroy(ctx);
+    return 0;
+}
@@ -0,0 +1,185 @@
+// calql8r_constexpr.hpp against the library. The static_asserts and the table of formulas are calculated
+// while this file compiles, at run time they have to be exactly what calql8r_eval_exact gives (same status,
+// same bits). Then the corpus goes through both at run time, also timed.
+// bench_constexpr [--count expressions] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"] [--show n]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <string>
+#include <vector>
+#include "calql8r.h"
+#include "calql8r_constexpr.hpp"
+#include "corpus.h"
+
+#define DEFAULT_COUNT 10000
+#define MIN_NANOSECONDS 200000000LL
+
+using calql8r::evaluate;
+using namespace calql8r::literals;
+
+// whole numbers go through 64 bits
+static_assert(evaluate("3^39+1").exact && evaluate("3^39+1").integer == 4052555153018976268LL);
+static_assert(evaluate("5Z2").integer == 10 && evaluate("5Y2").integer == 20 && evaluate("20!").integer == 2432902008176640000LL);
+static_assert(evaluate("2*(3+4)-1").integer == 13 && evaluate("-(2+3)*-2").integer == 10);
+static_assert(!evaluate("1-1").exact && evaluate("1-1").value == 0);
+
+// decimals are rounded to the closest double once
+static_assert(evaluate("0.1+0.2").value == 0.30000000000000004);
+static_assert(evaluate("10/4").value == 2.5 && evaluate("1 000.5").value == 1000.5);
+static_assert(evaluate("123456789012345678901234567890").value == 1.2345678901234568e29);
+static_assert(evaluate("2.2250738585072011e-308").value == 2.2250738585072011e-308);
+static_assert(evaluate("1.7976931348623157e308").value == std::numeric_limits<double>::max());
+static_assert(evaluate("1.7976931348623159e308").value == std::numeric_limits<double>::infinity());
+static_assert(evaluate("5e-324").value == std::numeric_limits<double>::denorm_min());
+static_assert(evaluate("2e-324").value == 0);
+static_assert(evaluate("170!").value == 7.257415615307999e+306 && evaluate("171!").value == std::numeric_limits<double>::infinity());
+static_assert("p"_calql8r == std::numbers::pi && "S0"_calql8r == 0);
+
+// the same errors
+static_assert(evaluate("1/0").status == CAL_ERROR_SYNTAX);
+static_assert(evaluate("(1+2").status == CAL_ERROR_SYNTAX && evaluate("1+2)").status == CAL_ERROR_SYNTAX);
+static_assert(evaluate("(1 p)").status == CAL_ERROR_MATH);
+static_assert(evaluate("1.2.3").status == CAL_ERROR_SYNTAX && evaluate(".5").status == CAL_ERROR_SYNTAX);
+static_assert(evaluate("x+1").status == CAL_ERROR_SYNTAX && evaluate("").status == CAL_ERROR_SYNTAX);
+static_assert(evaluate("2Y3").status == CAL_ERROR_SYNTAX && evaluate("-1!").status == CAL_ERROR_SYNTAX);
+
+#if CALQL8R_CONSTANT_MATH
+static_assert("2r9"_calql8r == 3 && "2l8"_calql8r == 3 && "2^-1"_calql8r == 0.5);
+static_assert(evaluate("L0").status == CAL_ERROR_SYNTAX && evaluate("0r4").status == CAL_ERROR_SYNTAX);
+#endif
+
+// every operator, calculated while compiling
+constexpr const char* FORMULAS[] = {
+    "1465+225+55.7 + 2r4 + p",
+    "1-2-3-4", "2*3/4*5/6", "1.5 - -2.25", "-(1+2)*3", "2*-p", "4!-3!", "4.7!", "21!", "23!/21!",
+    "25Y3", "100Y2", "171Y1", "30Z15", "68Z34", "200Z100", "2000Z3", "0.1*3-0.3",
+    "(((1+2)*3)-4)/5", "3^39+1", "3^40", "-2^63", "9223372036854775807+1", "2^62*2", "0-9223372036854775807-1",
+    "0.30000000000000004441", "9007199254740993", "1.00000000000000011102230246251565404236316680908203125",
+    "1e-320", "4.9406564584124654e-324", "1e23", "1.5e", "1e400",
+#if CALQL8R_CONSTANT_MATH
+    "S(p/6)", "s1.5", "C(p/3)", "c2", "T1", "t0.5", "L1000", "E10", "2l1024", "3r27", "2^0.5", "2^-1074",
+    "S(C(T1))", "-S(p/2)+E(L100)", "2^3^2", "1.5^2.5r7", "(p/4)^2*S(1.2)/C(0.7)",
+#endif
+    "1/0", "(1", "1)", "(1 p)", "1.2.3", "x", "2Y3", "-1!", "3!!", "+", "(1+)",
+};
+
+constexpr int FORMULA_COUNT = sizeof FORMULAS / sizeof FORMULAS[0];
+
+constexpr std::array<calql8r::Answer, FORMULA_COUNT> compile_answers(){
+    std::array<calql8r::Answer, FORMULA_COUNT> answers{};
+    for(int i = 0; i < FORMULA_COUNT; i++) answers[i] = evaluate(FORMULAS[i]);
+    return answers;
+}
+
+constexpr std::array<calql8r::Answer, FORMULA_COUNT> COMPILED_ANSWERS = compile_answers();
+
+// keeps the answers alive so the calculations can't be optimized away
+volatile double sink;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// same status, same bits and the same integer when it is exact
+bool same_answer(calql8r::Answer answer, int status, double value, long long integer, int exact){
+    if(answer.status != status) return false;
+    if(status != CAL_OK) return true;
+    if(answer.exact != (exact != 0) || (exact && answer.integer != integer)) return false;
+    return std::memcmp(&answer.value, &value, sizeof value) == 0;
+}
+
+void print_mismatch(const char* text, calql8r::Answer answer, int status, double value){
+    std::fprintf(stderr, "%s\n  constexpr %d %.17g\n  library   %d %.17g\n", text, answer.status, answer.value, status, value);
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    corpus.functions = "SsCcTtLE";
+    corpus.operators = "++--**//^rlYZ";
+    int count = DEFAULT_COUNT;
+    int show = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = std::atoi(argv[++i]);
+        else if(std::strcmp(argv[i], "--show") == 0 && i + 1 < argc) show = std::atoi(argv[++i]);
+        else {
+            std::fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+
+    struct CalQl8r* ctx = calql8r_create();
+    std::vector<char> buffer(corpus_buffer_size(&corpus));
+    std::vector<std::vector<char>> texts;
+    if(ctx == NULL){
+        std::fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    // answers from while compiling
+    int mismatches = 0;
+    for(int i = 0; i < FORMULA_COUNT; i++){
+        double value = 0;
+        long long integer = 0;
+        int exact = 0;
+        const int status = calql8r_eval_exact(ctx, FORMULAS[i], std::strlen(FORMULAS[i]), &value, &integer, &exact);
+        if(same_answer(COMPILED_ANSWERS[i], status, value, integer, exact)) continue;
+        if(mismatches++ < show) print_mismatch(FORMULAS[i], COMPILED_ANSWERS[i], status, value);
+    }
+    std::printf("check,expressions,mismatches,constexpr_ns,library_ns\n");
+    std::printf("compile_time,%d,%d,0.0,0.0\n", FORMULA_COUNT, mismatches);
+
+    for(int i = 0; i < count; i++){
+        const size_t length = corpus_expression(&corpus, buffer.data());
+        texts.emplace_back(buffer.data(), buffer.data() + length);
+    }
+
+    // the same corpus at run time
+    const int shown = mismatches;
+    mismatches = 0;
+    for(const std::vector<char>& text : texts){
+        double value = 0;
+        long long integer = 0;
+        int exact = 0;
+        const int status = calql8r_eval_exact(ctx, text.data(), text.size(), &value, &integer, &exact);
+        const calql8r::Answer answer = evaluate(std::string_view(text.data(), text.size()));
+        if(same_answer(answer, status, value, integer, exact)) continue;
+        if(shown + mismatches++ < show) print_mismatch(std::string(text.begin(), text.end()).c_str(), answer, status, value);
+    }
+
+    long long runs = 0;
+    long long start = nanoseconds_now();
+    long long constexpr_elapsed = 0;
+    do{
+        for(const std::vector<char>& text : texts) sink = evaluate(std::string_view(text.data(), text.size())).value;
+        runs++;
+        constexpr_elapsed = nanoseconds_now() - start;
+    } while(constexpr_elapsed < MIN_NANOSECONDS);
+    const double constexpr_ns = (double) constexpr_elapsed / ((double) runs * count);
+
+    runs = 0;
+    start = nanoseconds_now();
+    long long library_elapsed = 0;
+    do{
+        for(const std::vector<char>& text : texts){
+            double value = 0;
+            calql8r_eval(ctx, text.data(), text.size(), &value);
+            sink = value;
+        }
+        runs++;
+        library_elapsed = nanoseconds_now() - start;
+    } while(library_elapsed < MIN_NANOSECONDS);
+    const double library_ns = (double) library_elapsed / ((double) runs * count);
+
+    std::printf("run_time,%d,%d,%.1f,%.1f\n", count, mismatches, constexpr_ns, library_ns);
+
+    calql8r_destroy(ctx);
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Gradients of generated formulas with variables from calql8r_run_gradient_columns (one pass of dual numbers) against
+// central finite differences, which need 2 calql8r_run_columns per variable and one for the answers.
+// The answers have to be exactly what calql8r_run_columns gives and calql8r_run_gradient row by row has to give
+// exactly the same as the columns, formulas that don't are printed on stderr.
+// Derivatives more than 1e-4 away from the finite differences are only counted, at steps of nPr, nCr, ! and
+// near poles (tan, 1/x) finite differences don't give the derivative.
+// bench_gradient [--count formulas] [--rows n] [--iterations n] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"] [--variables "xyz"]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "calql8r.h"
+#include "corpus.h"
+
+#define DEFAULT_COUNT 200
+#define DEFAULT_ROWS 10000
+#define DEFAULT_ITERATIONS 3
+#define DEFAULT_OPERATORS "++--**/^rl"
+#define DEFAULT_FUNCTIONS "SsCcTtLE"
+#define DEFAULT_VARIABLES "xyz"
+#define MAX_VARIABLES 26
+#define TOLERANCE 1e-4
+
+// keeps the answers alive so the calculations can't be optimized away
+volatile double sink;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int same_answer(double a, double b){
+    return memcmp(&a, &b, sizeof a) == 0 || (isnan(a) && isnan(b));
+}
+
+// step of the finite differences for a value
+double step_for(double value){
+    return 1e-6 * (fabs(value) > 1 ? fabs(value) : 1);
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    corpus.operators = DEFAULT_OPERATORS;
+    corpus.functions = DEFAULT_FUNCTIONS;
+    corpus.variables = DEFAULT_VARIABLES;
+    int count = DEFAULT_COUNT;
+    size_t rows = DEFAULT_ROWS;
+    int iterations = DEFAULT_ITERATIONS;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = (size_t) atol(argv[++i]);
+        else if(strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(rows < 1) rows = 1;
+    if(iterations < 1) iterations = 1;
+
+    // every variable gets a column of values from 0.1 to 3, the shifted copy is for the finite differences
+    const int variables = (int) strlen(corpus.variables) < MAX_VARIABLES ? (int) strlen(corpus.variables) : MAX_VARIABLES;
+    const size_t columns_size = rows * (variables > 0 ? variables : 1);
+    double* values = (double *) malloc(sizeof (double) * columns_size);
+    double* shifted = (double *) malloc(sizeof (double) * rows);
+    double* gradients = (double *) malloc(sizeof (double) * columns_size);
+    double* answers = (double *) malloc(sizeof (double) * rows);
+    double* plain = (double *) malloc(sizeof (double) * rows);
+    double* above = (double *) malloc(sizeof (double) * rows);
+    double* below = (double *) malloc(sizeof (double) * rows);
+    double* row_values = (double *) malloc(sizeof (double) * MAX_VARIABLES);
+    double* row_gradient = (double *) malloc(sizeof (double) * MAX_VARIABLES);
+    char* buffer = (char *) malloc(corpus_buffer_size(&corpus));
+    struct CalQl8r* ctx = calql8r_create();
+    if(values == NULL || shifted == NULL || gradients == NULL || answers == NULL || plain == NULL || above == NULL
+        || below == NULL || row_values == NULL || row_gradient == NULL || buffer == NULL || ctx == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    for(size_t i = 0; i < columns_size; i++) values[i] = 0.1 + rand() / (double) RAND_MAX * 2.9;
+
+    printf("formulas,rows,variables,gradient_ns_per_row,row_ns_per_row,finite_ns_per_row,speedup,mismatches,finite_disagreements\n");
+
+    int formulas = 0;
+    int total_variables = 0;
+    long long mismatches = 0;
+    long long disagreements = 0;
+    long long gradient_ns = 0;
+    long long row_ns = 0;
+    long long finite_ns = 0;
+    for(int f = 0; f < count; f++){
+        const size_t length = corpus_expression(&corpus, buffer);
+        struct CalQl8rProgram* program;
+        if(calql8r_compile(ctx, buffer, length, &program) != CAL_OK) continue;
+        formulas++;
+        const int used = calql8r_program_variables(program);
+        total_variables += used;
+
+        // the columns in the order of the program's variables
+        const double* columns[MAX_VARIABLES];
+        double* gradient_columns[MAX_VARIABLES];
+        for(int i = 0; i < used; i++){
+            const char* name = calql8r_program_variable(program, i);
+            columns[i] = values + (strchr(corpus.variables, name[0]) - corpus.variables) * rows;
+            gradient_columns[i] = gradients + i * rows;
+        }
+
+        long long start = nanoseconds_now();
+        for(int iteration = 0; iteration < iterations; iteration++){
+            calql8r_run_gradient_columns(program, columns, rows, answers, gradient_columns);
+            sink = answers[0];
+        }
+        gradient_ns += nanoseconds_now() - start;
+
+        long long wrong = 0;
+        start = nanoseconds_now();
+        for(int iteration = 0; iteration < iterations; iteration++){
+            for(size_t r = 0; r < rows; r++){
+                for(int i = 0; i < used; i++) row_values[i] = columns[i][r];
+                double answer;
+                const int status = calql8r_run_gradient(program, row_values, &answer, row_gradient);
+                if(iteration > 0) continue;
+                if(status != CAL_OK){
+                    wrong += !isnan(answers[r]);
+                    continue;
+                }
+                wrong += !same_answer(answer, answers[r]);
+                for(int i = 0; i < used; i++) wrong += !same_answer(row_gradient[i], gradient_columns[i][r]);
+            }
+        }
+        row_ns += nanoseconds_now() - start;
+
+        // finite differences, the answers once and each variable a step above and below
+        start = nanoseconds_now();
+        for(int iteration = 0; iteration < iterations; iteration++){
+            calql8r_run_columns(program, columns, rows, plain);
+            for(int i = 0; i < used; i++){
+                const double* column = columns[i];
+                for(size_t r = 0; r < rows; r++) shifted[r] = column[r] + step_for(column[r]);
+                columns[i] = shifted;
+                calql8r_run_columns(program, columns, rows, above);
+                for(size_t r = 0; r < rows; r++) shifted[r] = column[r] - step_for(column[r]);
+                calql8r_run_columns(program, columns, rows, below);
+                columns[i] = column;
+
+                if(iteration > 0) continue;
+                for(size_t r = 0; r < rows; r++){
+                    const double finite = (above[r] - below[r]) / (2 * step_for(column[r]));
+                    const double derivative = gradient_columns[i][r];
+                    if(!isfinite(finite) || !isfinite(derivative)) continue;
+                    disagreements += fabs(finite - derivative) > TOLERANCE * (fabs(finite) > 1 ? fabs(finite) : 1);
+                }
+            }
+            sink = plain[0];
+        }
+        finite_ns += nanoseconds_now() - start;
+
+        for(size_t r = 0; r < rows; r++) wrong += !same_answer(plain[r], answers[r]);
+        if(wrong > 0) fprintf(stderr, "%lld DIFFERENT %s\n", wrong, buffer);
+        mismatches += wrong;
+        calql8r_program_free(program);
+    }
+
+    const double operations = (double) rows * iterations * (formulas > 0 ? formulas : 1);
+    const double gradient_per_row = gradient_ns / operations;
+    const double finite_per_row = finite_ns / operations;
+    printf("%d,%zu,%.2f,%.2f,%.2f,%.2f,%.2f,%lld,%lld\n", formulas, rows, formulas > 0 ? total_variables / (double) formulas : 0,
+        gradient_per_row, row_ns / operations, finite_per_row, gradient_per_row > 0 ? finite_per_row / gradient_per_row : 0,
+        mismatches, disagreements);
+
+    free(values);
+    free(shifted);
+    free(gradients);
+    free(answers);
+    free(plain);
+    free(above);
+    free(below);
+    free(row_values);
+    free(row_gradient);
+    free(buffer);
+    calql8r_destroy(ctx);
+    return mismatches == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,127 @@
+// Short random expressions that put every operator, function, sign and bracket next to every other one, something
+// the corpus of the other benchmarks never does. Checks that the ways of calculating an expression agree on which
+// ones are errors: expressions the 64 bit integers calculate (calculate_integer_expression) have to be calculated
+// by calculate_math too, and calql8r_compile (or calql8r_run when it compiles) has to give the same status as
+// calql8r_eval and the same answer (past 2^53 calql8r_eval can be exact where the program isn't, those are skipped).
+// calql8r_eval stops at the first error so a value it can't calculate in a bracket e.g (5E0)T is a syntax error
+// before the bracket is found to have two values in it, there the program can give the math error.
+// Expressions that don't agree are printed on stderr and the exit status is a failure.
+// bench_grammar [--count expressions] [--seed n] [--pieces n] [--show n]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+#define DEFAULT_COUNT 1000000
+#define DEFAULT_PIECES 8
+#define DEFAULT_SHOW 10
+
+// numbers come up more often than the rest so some of the expressions are right
+const char* PIECES[] = {
+    "2", "5", "3", "12", "0", "1", "2.5", "p",
+    "2", "5", "3", "12", "0", "1", "2.5", "p",
+    "+", "-", "*", "/", "^", "r", "l", "Y", "Z", "!",
+    "S", "s", "C", "c", "T", "t", "L", "E",
+    "-", "--", "(", "(", ")", ")", " "
+};
+#define PIECES_LENGTH (sizeof PIECES / sizeof PIECES[0])
+
+unsigned long long next_random(unsigned long long* state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// calql8r_eval without the 64 bit integers, the tokens are calculated in place
+int calculate_doubles(struct Expression* expr){
+    int status = calculate_all_brackets(expr, NULL);
+    if(status == CAL_OK) status = calculate_math(expr);
+    if(status == CAL_OK && (expr->array_length != 1 || expr->types[0] != NUMBER)) status = CAL_ERROR_SYNTAX;
+    return status;
+}
+
+int main(int argc, char *argv[]){
+    int count = DEFAULT_COUNT;
+    int pieces = DEFAULT_PIECES;
+    int show = DEFAULT_SHOW;
+    unsigned long long state = 88172645463325252ULL;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) state += strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--pieces") == 0 && i + 1 < argc) pieces = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--show") == 0 && i + 1 < argc) show = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(pieces < 1) pieces = 1;
+
+    char* text = (char *) malloc((size_t) pieces * 2 + 1);
+    struct CalQl8r* ctx = calql8r_create();
+    if(text == NULL || ctx == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    printf("expressions,answers,integer_answers,integer_mismatches,programs,program_mismatches\n");
+
+    long long answers = 0;
+    long long integer_answers = 0;
+    long long integer_mismatches = 0;
+    long long programs = 0;
+    long long program_mismatches = 0;
+    for(int e = 0; e < count; e++){
+        const int used = 1 + (int) (next_random(&state) % pieces);
+        size_t length = 0;
+        for(int p = 0; p < used; p++){
+            const char* piece = PIECES[next_random(&state) % PIECES_LENGTH];
+            memcpy(text + length, piece, strlen(piece));
+            length += strlen(piece);
+        }
+        text[length] = '\0';
+
+        double result = 0;
+        long long exact_integer = 0;
+        int exact = 0;
+        const int eval_status = calql8r_eval_exact(ctx, text, length, &result, &exact_integer, &exact);
+        struct CalQl8rProgram* program;
+        const int compile_status = calql8r_compile(ctx, text, length, &program);
+        const int compiled = compile_status == CAL_OK;
+        double run_result = 0;
+        const int run_status = compiled ? calql8r_run(program, &run_result) : compile_status;
+        if(compiled){
+            programs++;
+            calql8r_program_free(program);
+        }
+        int same = eval_status == run_status || (eval_status == CAL_ERROR_SYNTAX && run_status == CAL_ERROR_MATH);
+        if(same && eval_status == CAL_OK && !(exact && fabs(result) >= EXACT_INTEGER_LIMIT)){
+            same = memcmp(&result, &run_result, sizeof result) == 0 || (isnan(result) && isnan(run_result));
+        }
+        if(!same && program_mismatches++ < show){
+            fprintf(stderr, "EVAL %s %.17g %s %s %.17g: %s\n", calql8r_error_message(eval_status), result,
+                compiled ? "RUN" : "COMPILE", calql8r_error_message(run_status), run_result, text);
+        }
+
+        if(tokenize_expression(ctx, text, length) != CAL_OK) continue;
+        long long integer;
+        const int whole = calculate_integer_expression(ctx, &ctx->tokens, &integer);
+        const int status = calculate_doubles(&ctx->tokens);
+        answers += status == CAL_OK;
+        integer_answers += whole;
+
+        if(whole && status != CAL_OK){
+            if(integer_mismatches++ < show) fprintf(stderr, "INTEGER %lld DOUBLES %s: %s\n", integer, calql8r_error_message(status), text);
+        }
+    }
+
+    printf("%d,%lld,%lld,%lld,%lld,%lld\n", count, answers, integer_answers, integer_mismatches, programs, program_mismatches);
+    free(text);
+    calql8r_destroy(ctx);
+    return integer_mismatches == 0 && program_mismatches == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,272 @@
+// One expression at a time from another process over every way there is to get an answer: starting main,
+// the Unix socket server, shared memory that sleeps on a futex and shared memory with busy polling,
+// next to calql8r_eval in the same process. The servers run in a child process so every answer crosses
+// a process boundary. Prints CSV with the time per answer and the p50/p99/p999 latency, every answer
+// is also checked against calql8r_eval (mismatches).
+// bench_ipc [--main path] [--requests n] [--cli-requests n] [--expressions n] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "calql8r.h"
+#include "batch.h"
+#include "server.h"
+#include "shm.h"
+#include "corpus.h"
+
+#define DEFAULT_MAIN "./src/main/main"
+#define DEFAULT_REQUESTS 200000
+#define DEFAULT_CLI_REQUESTS 300
+#define DEFAULT_EXPRESSIONS 1000
+#define DEFAULT_LENGTH 24
+#define ANSWER_ROOM 512
+
+struct Sample{
+    char* text;
+    size_t length;
+    double answer;
+    // the line main, batch mode and the socket server give
+    char line[ANSWER_ROOM];
+    size_t line_length;
+};
+
+// one round trip of 'sample', 1 when the answer that came back is the right one
+typedef int (*Transport)(void* state, const struct Sample* sample);
+
+extern char** environ;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int compare_latencies(const void* a, const void* b){
+    const long long x = *(const long long *) a;
+    const long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+void bench_transport(const char* name, Transport transport, void* state, const struct Sample* samples, int count,
+    long long requests, long long* latencies){
+    long long mismatches = 0;
+    const long long start = nanoseconds_now();
+    for(long long i = 0; i < requests; i++){
+        const long long sent = nanoseconds_now();
+        mismatches += !transport(state, &samples[i % count]);
+        latencies[i] = nanoseconds_now() - sent;
+    }
+    const double total = (double) (nanoseconds_now() - start);
+
+    qsort(latencies, requests, sizeof (long long), compare_latencies);
+    printf("%s,%lld,%.0f,%lld,%lld,%lld,%lld\n", name, requests, total / requests, latencies[requests / 2],
+        latencies[requests * 99 / 100], latencies[requests * 999 / 1000], mismatches);
+}
+
+int in_process(void* state, const struct Sample* sample){
+    double answer = 0;
+    calql8r_eval((struct CalQl8r*) state, sample->text, sample->length, &answer);
+    return memcmp(&answer, &sample->answer, sizeof answer) == 0;
+}
+
+// a new main for every expression, its stdout is a pipe
+int command_line(void* state, const struct Sample* sample){
+    const char* main_path = (const char *) state;
+    int output[2];
+    if(pipe(output) != 0) return 0;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, output[0]);
+    char* arguments[] = {(char *) main_path, sample->text, NULL};
+    pid_t child;
+    const int spawned = posix_spawn(&child, main_path, &actions, NULL, arguments, environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+    close(output[1]);
+
+    char line[ANSWER_ROOM];
+    size_t length = 0;
+    ssize_t count;
+    while(spawned && length < sizeof line && (count = read(output[0], line + length, sizeof line - length)) > 0) length += count;
+    close(output[0]);
+    if(!spawned) return 0;
+    waitpid(child, NULL, 0);
+
+    // main doesn't put a newline after an error
+    return length >= sample->line_length - 1 && memcmp(line, sample->line, sample->line_length - 1) == 0;
+}
+
+int unix_socket(void* state, const struct Sample* sample){
+    const int fd = *(int *) state;
+    char line[ANSWER_ROOM + 1];
+    memcpy(line, sample->text, sample->length);
+    line[sample->length] = '\n';
+    if(send(fd, line, sample->length + 1, MSG_NOSIGNAL) != (ssize_t) sample->length + 1) return 0;
+
+    size_t length = 0;
+    while(length == 0 || line[length - 1] != '\n'){
+        const ssize_t count = recv(fd, line + length, sizeof line - length, 0);
+        if(count <= 0) return 0;
+        length += count;
+    }
+    return length == sample->line_length && memcmp(line, sample->line, length) == 0;
+}
+
+int shared_memory(void* state, const struct Sample* sample){
+    double answer = 0;
+    shm_client_eval((struct ShmClient*) state, sample->text, sample->length, &answer);
+    return memcmp(&answer, &sample->answer, sizeof answer) == 0;
+}
+
+// the servers live in a child so the answers come from another process, it writes a byte once they are up
+pid_t start_servers(const char* socket_path, const char* segment){
+    int ready[2];
+    if(pipe(ready) != 0) return -1;
+    const pid_t child = fork();
+    if(child != 0){
+        close(ready[1]);
+        char byte = 0;
+        const int up = read(ready[0], &byte, 1) == 1 && byte == 1;
+        close(ready[0]);
+        if(child > 0 && !up) waitpid(child, NULL, 0);
+        return up ? child : -1;
+    }
+
+    close(ready[0]);
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct Server* server = server_create(socket_path, 1);
+    struct ShmServer* shm = shm_server_create(segment, 2);
+    const char byte = server != NULL && shm != NULL;
+    if(write(ready[1], &byte, 1) == 1 && byte){
+        int received;
+        sigwait(&signals, &received);
+    }
+    server_destroy(server);
+    shm_server_destroy(shm);
+    _exit(0);
+}
+
+int connect_socket(const char* path){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof address.sun_path - 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd >= 0 && connect(fd, (const struct sockaddr*) &address, sizeof address) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    corpus.length = DEFAULT_LENGTH;
+    const char* main_path = DEFAULT_MAIN;
+    long long requests = DEFAULT_REQUESTS;
+    long long cli_requests = DEFAULT_CLI_REQUESTS;
+    int count = DEFAULT_EXPRESSIONS;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--main") == 0 && i + 1 < argc) main_path = argv[++i];
+        else if(strcmp(argv[i], "--requests") == 0 && i + 1 < argc) requests = atoll(argv[++i]);
+        else if(strcmp(argv[i], "--cli-requests") == 0 && i + 1 < argc) cli_requests = atoll(argv[++i]);
+        else if(strcmp(argv[i], "--expressions") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(requests < 1) requests = 1;
+    if(cli_requests < 0) cli_requests = 0;
+    if(count < 1) count = 1;
+
+    struct Sample* samples = (struct Sample *) calloc(count, sizeof (struct Sample));
+    char* buffer = (char *) malloc(corpus_buffer_size(&corpus));
+    long long* latencies = (long long *) malloc(sizeof (long long) * (requests > cli_requests ? requests : cli_requests));
+    struct CalQl8r* ctx = calql8r_create();
+    struct OutputBuffer out;
+    if(samples == NULL || buffer == NULL || latencies == NULL || ctx == NULL || output_init(&out, ANSWER_ROOM) != CAL_OK){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    // what every way should give back, written the same way batch mode does
+    for(int i = 0; i < count; i++){
+        struct Sample* sample = &samples[i];
+        sample->length = corpus_expression(&corpus, buffer);
+        sample->text = strdup(buffer);
+        if(sample->text == NULL || sample->length >= ANSWER_ROOM){
+            fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+            return EXIT_FAILURE;
+        }
+        long long integer = 0;
+        int exact = 0;
+        const int status = calql8r_eval_exact(ctx, sample->text, sample->length, &sample->answer, &integer, &exact);
+        out.length = 0;
+        output_answer(&out, status, sample->answer, integer, exact);
+        memcpy(sample->line, out.data, out.length);
+        sample->line_length = out.length;
+    }
+
+    char socket_path[64];
+    char segment[64];
+    snprintf(socket_path, sizeof socket_path, "/tmp/calql8r_ipc_%d.sock", (int) getpid());
+    snprintf(segment, sizeof segment, "calql8r_ipc_%d", (int) getpid());
+    const pid_t servers = start_servers(socket_path, segment);
+    if(servers < 0){
+        fprintf(stderr, "CAN NOT START THE SERVERS\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("transport,requests,ns_per_request,p50_ns,p99_ns,p999_ns,mismatches\n");
+    bench_transport("in_process", in_process, ctx, samples, count, requests, latencies);
+
+    if(cli_requests > 0 && access(main_path, X_OK) == 0){
+        bench_transport("cli", command_line, (void *) main_path, samples, count, cli_requests, latencies);
+    } else if(cli_requests > 0){
+        fprintf(stderr, "NO %s TO START, BUILD IT OR USE --main\n", main_path);
+    }
+
+    int fd = connect_socket(socket_path);
+    if(fd >= 0){
+        bench_transport("unix_socket", unix_socket, &fd, samples, count, requests, latencies);
+        close(fd);
+    }
+
+    struct ShmClient* client = shm_client_open(segment, 0);
+    if(client != NULL){
+        bench_transport("shm_futex", shared_memory, client, samples, count, requests, latencies);
+        shm_client_close(client);
+    }
+    client = shm_client_open(segment, 1);
+    if(client != NULL){
+        bench_transport("shm_busy_poll", shared_memory, client, samples, count, requests, latencies);
+        shm_client_close(client);
+    }
+
+    kill(servers, SIGTERM);
+    waitpid(servers, NULL, 0);
+    for(int i = 0; i < count; i++) free(samples[i].text);
+    free(samples);
+    free(buffer);
+    free(latencies);
+    output_free(&out);
+    calql8r_destroy(ctx);
+    return 0;
+}
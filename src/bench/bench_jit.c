@@ -0,0 +1,129 @@
+// calql8r_run_columns interpreted against the native code of the JIT on the same generated formulas.
+// Every row has to give exactly the same answer (NAN for errors) so this is also the check that the JIT is right,
+// formulas that don't are printed on stderr.
+// bench_jit [--count formulas] [--rows n] [--iterations n] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"] [--variables "xyz"]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+#include "corpus.h"
+
+#define DEFAULT_COUNT 200
+#define DEFAULT_ROWS 100000
+#define DEFAULT_ITERATIONS 3
+#define DEFAULT_OPERATORS "++--**/^rlYZ"
+#define DEFAULT_FUNCTIONS "SsCcTtLE"
+#define DEFAULT_VARIABLES "xyz"
+#define MAX_VARIABLES 26
+
+// keeps the answers alive so the calculations can't be optimized away
+volatile double sink;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int same_answer(double a, double b){
+    return memcmp(&a, &b, sizeof a) == 0 || (isnan(a) && isnan(b));
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    corpus.operators = DEFAULT_OPERATORS;
+    corpus.functions = DEFAULT_FUNCTIONS;
+    corpus.variables = DEFAULT_VARIABLES;
+    int count = DEFAULT_COUNT;
+    size_t rows = DEFAULT_ROWS;
+    int iterations = DEFAULT_ITERATIONS;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = (size_t) atol(argv[++i]);
+        else if(strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(rows < 1) rows = 1;
+    if(iterations < 1) iterations = 1;
+
+    // every variable gets a column of values from -3 to 3 with some zeros for the errors
+    const int variables = (int) strlen(corpus.variables) < MAX_VARIABLES ? (int) strlen(corpus.variables) : MAX_VARIABLES;
+    double* values = (double *) malloc(sizeof (double) * rows * (variables > 0 ? variables : 1));
+    double* interpreted = (double *) malloc(sizeof (double) * rows);
+    double* native = (double *) malloc(sizeof (double) * rows);
+    char* buffer = (char *) malloc(corpus_buffer_size(&corpus));
+    struct CalQl8r* ctx = calql8r_create();
+    if(values == NULL || interpreted == NULL || native == NULL || buffer == NULL || ctx == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    for(size_t i = 0; i < rows * variables; i++) values[i] = rand() % 16 == 0 ? 0 : (rand() / (double) RAND_MAX - 0.5) * 6;
+
+    printf("formulas,rows,native,interpreted_ns_per_row,jit_ns_per_row,speedup,mismatches\n");
+
+    int formulas = 0;
+    int compiled = 0;
+    long long mismatches = 0;
+    long long interpreted_ns = 0;
+    long long native_ns = 0;
+    for(int f = 0; f < count; f++){
+        const size_t length = corpus_expression(&corpus, buffer);
+        struct CalQl8rProgram* program;
+        if(calql8r_compile(ctx, buffer, length, &program) != CAL_OK) continue;
+        formulas++;
+
+        // the columns in the order of the program's variables
+        const double* columns[MAX_VARIABLES];
+        for(int i = 0; i < calql8r_program_variables(program); i++){
+            const char* name = calql8r_program_variable(program, i);
+            columns[i] = values + (strchr(corpus.variables, name[0]) - corpus.variables) * rows;
+        }
+
+        long long start = nanoseconds_now();
+        for(int iteration = 0; iteration < iterations; iteration++){
+            run_columns_interpreted(program, columns, rows, interpreted);
+            sink = interpreted[0];
+        }
+        interpreted_ns += nanoseconds_now() - start;
+
+        if(calql8r_program_jit(program)){
+            compiled++;
+            start = nanoseconds_now();
+            for(int iteration = 0; iteration < iterations; iteration++){
+                calql8r_run_columns(program, columns, rows, native);
+                sink = native[0];
+            }
+            native_ns += nanoseconds_now() - start;
+
+            long long wrong = 0;
+            for(size_t i = 0; i < rows; i++) wrong += !same_answer(interpreted[i], native[i]);
+            if(wrong > 0) fprintf(stderr, "%lld ROWS DIFFERENT %s\n", wrong, buffer);
+            mismatches += wrong;
+        }
+        calql8r_program_free(program);
+    }
+
+    const double operations = (double) rows * iterations;
+    const double interpreted_per_row = formulas > 0 ? interpreted_ns / (operations * formulas) : 0;
+    const double native_per_row = compiled > 0 ? native_ns / (operations * compiled) : 0;
+    printf("%d,%zu,%d,%.2f,%.2f,%.2f,%lld\n", formulas, rows, compiled, interpreted_per_row, native_per_row,
+        native_per_row > 0 ? interpreted_per_row / native_per_row : 0, mismatches);
+
+    free(values);
+    free(interpreted);
+    free(native);
+    free(buffer);
+    calql8r_destroy(ctx);
+    return mismatches == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,367 @@
+// The same seeded corpus through every implementation of the calculator (C, Go, JavaScript, Python,
+// Java, Kotlin, C# and Dart) whose toolchain is installed. Each one runs with --batch: the startup is
+// the time of a run with no expressions, the rest of a run over the corpus is the steady state.
+// Every answer is checked against calql8r_eval within --tolerance (relative, at least 1 when the
+// answer is small), an error, infinity or NaN is agreed with when the language also gives no number.
+// The corpus has no ^ unless --ops asks for it, powers that overflow make some of them loop forever.
+// Prints CSV, run it from the top of the repo.
+// bench_languages [--main path] [--languages "c,go,javascript,python,java,kotlin,csharp,dart"] [--count n]
+//                 [--runs n] [--tolerance t] [--timeout seconds] [--show n]
+//                 [--seed n] [--length n] [--depth n] [--ops "+-*/"] [--functions "SCL"]
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "calql8r.h"
+#include "corpus.h"
+
+#define DEFAULT_MAIN "./src/main/main"
+#define DEFAULT_COUNT 10000
+#define DEFAULT_RUNS 5
+#define DEFAULT_OPERATORS "+-*/"
+// main prints 6 decimals
+#define DEFAULT_TOLERANCE 1e-6
+#define DEFAULT_TIMEOUT 120
+#define MAX_ARGUMENTS 16
+#define PATH_ROOM 4096
+
+// "{dir}" in an argument is the temporary directory, "{src}" the absolute path of src/main
+struct Language{
+    const char* name;
+    // commands that have to be on the PATH, NULL for none
+    const char* tools[2];
+    // compiles into the temporary directory first, NULL when it runs from the source
+    const char* build[MAX_ARGUMENTS];
+    const char* run[MAX_ARGUMENTS];
+};
+
+const struct Language LANGUAGES[] = {
+    {"c", {NULL, NULL}, {NULL}, {"{main}", "--batch", NULL}},
+    {"go", {"go", NULL}, {"go", "build", "-o", "{dir}/calql8r_go", "{src}/main.go", NULL}, {"{dir}/calql8r_go", "--batch", NULL}},
+    {"javascript", {"node", NULL}, {NULL}, {"node", "{src}/main.js", "--batch", NULL}},
+    {"python", {"python3", NULL}, {NULL}, {"python3", "{src}/main.py", "--batch", NULL}},
+    {"java", {"javac", "java"}, {"javac", "-d", "{dir}/java", "{src}/Main.java", NULL}, {"java", "-cp", "{dir}/java", "main.Main", "--batch", NULL}},
+    {"kotlin", {"kotlinc", "java"}, {"kotlinc", "{src}/Main.kt", "-include-runtime", "-d", "{dir}/calql8r_kotlin.jar", NULL}, {"java", "-jar", "{dir}/calql8r_kotlin.jar", "--batch", NULL}},
+    // a project next to the source so any dotnet can build it, not only the ones that run a .cs file
+    {"csharp", {"dotnet", NULL}, {"dotnet", "build", "{dir}/csharp/calql8r.csproj", "-c", "Release", "-o", "{dir}/csharp/out", NULL}, {"{dir}/csharp/out/calql8r", "--batch", NULL}},
+    {"dart", {"dart", NULL}, {"dart", "compile", "exe", "{src}/main.dart", "-o", "{dir}/calql8r_dart", NULL}, {"{dir}/calql8r_dart", "--batch", NULL}},
+};
+#define LANGUAGE_COUNT (int) (sizeof LANGUAGES / sizeof LANGUAGES[0])
+
+struct Expected{
+    int status;
+    double answer;
+};
+
+struct Paths{
+    const char* main;
+    char dir[64];
+    char src[PATH_ROOM];
+};
+
+extern char** environ;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int on_path(const char* tool){
+    const char* path = getenv("PATH");
+    char candidate[PATH_ROOM];
+    while(path != NULL && *path != '\0'){
+        const char* colon = strchr(path, ':');
+        const size_t length = colon == NULL ? strlen(path) : (size_t) (colon - path);
+        snprintf(candidate, sizeof candidate, "%.*s/%s", (int) length, length == 0 ? "." : path, tool);
+        if(access(candidate, X_OK) == 0) return 1;
+        path = colon == NULL ? NULL : colon + 1;
+    }
+    return 0;
+}
+
+// puts the paths into a template argument, every argument gets its own room in 'room'
+void expand_arguments(const char* const* template, const struct Paths* paths, char room[][PATH_ROOM], char** arguments){
+    int i = 0;
+    for(; template[i] != NULL && i < MAX_ARGUMENTS - 1; i++){
+        const char* from = template[i];
+        char* to = room[i];
+        size_t used = 0;
+        while(*from != '\0' && used < PATH_ROOM - 1){
+            const char* value = NULL;
+            size_t skip = 0;
+            if(strncmp(from, "{dir}", 5) == 0) value = paths->dir, skip = 5;
+            else if(strncmp(from, "{src}", 5) == 0) value = paths->src, skip = 5;
+            else if(strncmp(from, "{main}", 6) == 0) value = paths->main, skip = 6;
+            if(value != NULL){
+                used += snprintf(to + used, PATH_ROOM - used, "%s", value);
+                if(used > PATH_ROOM - 1) used = PATH_ROOM - 1;
+                from += skip;
+            } else {
+                to[used++] = *from++;
+            }
+        }
+        to[used] = '\0';
+        arguments[i] = to;
+    }
+    arguments[i] = NULL;
+}
+
+// Runs 'arguments' with stdin from 'input' and stdout into 'output' (both can be NULL for /dev/null).
+// Gives the exit status, -1 when it couldn't start and -2 when it took longer than 'timeout' seconds and was killed
+int run_command(char** arguments, const char* input, const char* output, int timeout, long long* nanoseconds){
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, input != NULL ? input : "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output != NULL ? output : "/dev/null", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // SIGCHLD is blocked here so sigtimedwait can catch the exit, the child shouldn't inherit that
+    posix_spawnattr_t attributes;
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigmask(&attributes, &none);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+
+    const long long start = nanoseconds_now();
+    pid_t child;
+    const int spawned = posix_spawnp(&child, arguments[0], &actions, &attributes, arguments, environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if(!spawned) return -1;
+
+    sigset_t exited;
+    sigemptyset(&exited);
+    sigaddset(&exited, SIGCHLD);
+    const long long deadline = start + timeout * 1000000000LL;
+    int status = 0;
+    pid_t done = 0;
+    while((done = waitpid(child, &status, WNOHANG)) == 0){
+        const long long left = deadline - nanoseconds_now();
+        if(left <= 0) break;
+        const struct timespec wait = {left / 1000000000LL, left % 1000000000LL};
+        sigtimedwait(&exited, NULL, &wait);
+    }
+    *nanoseconds = nanoseconds_now() - start;
+    if(done == 0){
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+        return -2;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int is_number(const char* text, double* value){
+    char* end;
+    errno = 0;
+    *value = strtod(text, &end);
+    while(*end == ' ' || *end == '\r') end++;
+    return end != text && *end == '\0';
+}
+
+int answers_agree(const struct Expected* expected, const char* line, double tolerance){
+    double value;
+    const int number = is_number(line, &value);
+    if(expected->status != CAL_OK) return !number;
+    // some languages give an error for what isn't a number any more
+    if(isnan(expected->answer)) return !number || isnan(value);
+    if(isinf(expected->answer)) return !number || value == expected->answer;
+    if(!number) return 0;
+    const double scale = fabs(expected->answer) > 1 ? fabs(expected->answer) : 1;
+    return fabs(value - expected->answer) <= tolerance * scale;
+}
+
+// compares the answers a language wrote into 'path' with the expected ones, lines that are missing disagree
+long long count_agreeing(const char* path, char** expressions, const struct Expected* expected, int count,
+    double tolerance, const char* name, int show){
+    FILE* file = fopen(path, "r");
+    if(file == NULL) return 0;
+    char* line = NULL;
+    size_t room = 0;
+    long long agreeing = 0;
+    int shown = 0;
+    for(int i = 0; i < count; i++){
+        const ssize_t length = getline(&line, &room, file);
+        if(length < 0) break;
+        if(length > 0 && line[length - 1] == '\n') line[length - 1] = '\0';
+        if(answers_agree(&expected[i], line, tolerance)){
+            agreeing++;
+        } else if(shown++ < show){
+            if(expected[i].status == CAL_OK) fprintf(stderr, "%s: %s = %.17g, got %s\n", name, expressions[i], expected[i].answer, line);
+            else fprintf(stderr, "%s: %s = %s, got %s\n", name, expressions[i], calql8r_error_message(expected[i].status), line);
+        }
+    }
+    free(line);
+    fclose(file);
+    return agreeing;
+}
+
+int compare_times(const void* a, const void* b){
+    const long long x = *(const long long *) a;
+    const long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+int remove_entry(const char* path, const struct stat* info, int type, struct FTW* walk){
+    (void) info;
+    (void) type;
+    (void) walk;
+    remove(path);
+    return 0;
+}
+
+int write_csharp_project(const struct Paths* paths){
+    char path[PATH_ROOM];
+    snprintf(path, sizeof path, "%s/csharp", paths->dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof path, "%s/csharp/calql8r.csproj", paths->dir);
+    FILE* file = fopen(path, "w");
+    if(file == NULL) return 0;
+    fprintf(file, "<Project Sdk=\"Microsoft.NET.Sdk\">\n"
+        "  <PropertyGroup><OutputType>Exe</OutputType><TargetFramework>net$(NETCoreAppMaximumVersion)</TargetFramework>"
+        "<Nullable>enable</Nullable><EnableDefaultCompileItems>false</EnableDefaultCompileItems></PropertyGroup>\n"
+        "  <ItemGroup><Compile Include=\"%s/Main.cs\" /></ItemGroup>\n</Project>\n", paths->src);
+    return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    corpus.operators = DEFAULT_OPERATORS;
+    struct Paths paths;
+    paths.main = DEFAULT_MAIN;
+    const char* only = NULL;
+    int count = DEFAULT_COUNT;
+    int runs = DEFAULT_RUNS;
+    double tolerance = DEFAULT_TOLERANCE;
+    int timeout = DEFAULT_TIMEOUT;
+    int show = 0;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--main") == 0 && i + 1 < argc) paths.main = argv[++i];
+        else if(strcmp(argv[i], "--languages") == 0 && i + 1 < argc) only = argv[++i];
+        else if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+        else if(strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) timeout = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--show") == 0 && i + 1 < argc) show = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(runs < 1) runs = 1;
+    if(timeout < 1) timeout = 1;
+
+    strcpy(paths.dir, "/tmp/calql8r_languages_XXXXXX");
+    if(realpath("src/main", paths.src) == NULL || mkdtemp(paths.dir) == NULL){
+        fprintf(stderr, "RUN IT FROM THE TOP OF THE REPO\n");
+        return EXIT_FAILURE;
+    }
+
+    // the corpus file every language reads and the answers calql8r_eval gives for it
+    char** expressions = (char **) calloc(count, sizeof (char *));
+    struct Expected* expected = (struct Expected*) malloc(sizeof (struct Expected) * count);
+    char* buffer = (char *) malloc(corpus_buffer_size(&corpus));
+    long long* times = (long long *) malloc(sizeof (long long) * runs);
+    struct CalQl8r* ctx = calql8r_create();
+    char corpus_path[PATH_ROOM];
+    snprintf(corpus_path, sizeof corpus_path, "%s/corpus.txt", paths.dir);
+    FILE* corpus_file = fopen(corpus_path, "w");
+    if(expressions == NULL || expected == NULL || buffer == NULL || times == NULL || ctx == NULL || corpus_file == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+    for(int i = 0; i < count; i++){
+        const size_t length = corpus_expression(&corpus, buffer);
+        expressions[i] = strdup(buffer);
+        expected[i].answer = 0;
+        expected[i].status = calql8r_eval(ctx, buffer, length, &expected[i].answer);
+        fprintf(corpus_file, "%s\n", buffer);
+    }
+    fclose(corpus_file);
+
+    sigset_t exited;
+    sigemptyset(&exited);
+    sigaddset(&exited, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &exited, NULL);
+
+    char answers_path[PATH_ROOM];
+    snprintf(answers_path, sizeof answers_path, "%s/answers.txt", paths.dir);
+    char room[MAX_ARGUMENTS][PATH_ROOM];
+    char* arguments[MAX_ARGUMENTS];
+    double c_rate = 0;
+
+    printf("language,expressions,startup_ms,seconds,expressions_per_second,relative_to_c,agreeing,disagreeing\n");
+    for(int l = 0; l < LANGUAGE_COUNT; l++){
+        const struct Language* language = &LANGUAGES[l];
+        if(only != NULL && strstr(only, language->name) == NULL) continue;
+
+        int installed = 1;
+        for(int t = 0; t < 2; t++) installed &= language->tools[t] == NULL || on_path(language->tools[t]);
+        if(!installed){
+            fprintf(stderr, "SKIPPING %s, %s IS NOT INSTALLED\n", language->name, language->tools[0]);
+            continue;
+        }
+
+        long long nanoseconds = 0;
+        if(language->build[0] != NULL){
+            if(strcmp(language->name, "csharp") == 0) write_csharp_project(&paths);
+            expand_arguments(language->build, &paths, room, arguments);
+            const int built = run_command(arguments, NULL, NULL, timeout * 10, &nanoseconds);
+            if(built != 0){
+                fprintf(stderr, "SKIPPING %s, %s FAILED\n", language->name, arguments[0]);
+                continue;
+            }
+        }
+
+        // the startup is the median of runs with nothing to calculate
+        expand_arguments(language->run, &paths, room, arguments);
+        int status = 0;
+        for(int r = 0; r < runs && status == 0; r++) status = run_command(arguments, NULL, NULL, timeout, &times[r]);
+        if(status != 0){
+            fprintf(stderr, "SKIPPING %s, %s DOES NOT RUN\n", language->name, arguments[0]);
+            continue;
+        }
+        qsort(times, runs, sizeof (long long), compare_times);
+        const double startup = times[runs / 2] / 1e9;
+
+        status = run_command(arguments, corpus_path, answers_path, timeout, &nanoseconds);
+        if(status == -2) fprintf(stderr, "%s TOOK LONGER THAN %d SECONDS\n", language->name, timeout);
+        else if(status != 0) fprintf(stderr, "%s EXITED WITH %d\n", language->name, status);
+        const double seconds = nanoseconds / 1e9;
+        const double steady = seconds - startup > 0 ? seconds - startup : seconds;
+        const double rate = count / steady;
+        if(strcmp(language->name, "c") == 0) c_rate = rate;
+
+        // relative_to_c stays empty when there is no C to compare with
+        char relative[32] = "";
+        if(c_rate > 0) snprintf(relative, sizeof relative, "%.2f", rate / c_rate);
+        const long long agreeing = count_agreeing(answers_path, expressions, expected, count, tolerance, language->name, show);
+        printf("%s,%d,%.2f,%.3f,%.0f,%s,%lld,%lld\n", language->name, count, startup * 1000, seconds, rate,
+            relative, agreeing, count - agreeing);
+        fflush(stdout);
+    }
+
+    nftw(paths.dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    for(int i = 0; i < count; i++) free(expressions[i]);
+    free(expressions);
+    free(expected);
+    free(buffer);
+    free(times);
+    calql8r_destroy(ctx);
+    return 0;
+}
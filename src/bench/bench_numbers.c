@@ -0,0 +1,141 @@
+// parse_number against strtod on generated literals of different shapes, both give the closest double
+// so every literal is also checked to give exactly the same bits.
+// bench_numbers [literals per shape]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+#define DEFAULT_LITERALS 100000
+#define LITERAL_ROOM 64
+#define MIN_NANOSECONDS 200000000LL
+
+// keeps the answers alive so the parsing can't be optimized away
+volatile double sink;
+
+unsigned long long random_state = 88172645463325252ULL;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+unsigned int random_below(unsigned int below){
+    // xorshift64
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (unsigned int) (random_state >> 32) % below;
+}
+
+size_t write_digits(char* text, int count){
+    // no leading zero
+    text[0] = (char) ('1' + random_below(9));
+    for(int i = 1; i < count; i++) text[i] = (char) ('0' + random_below(10));
+    return (size_t) count;
+}
+
+// e.g 7, 4096
+size_t write_whole(char* text){
+    return write_digits(text, 1 + random_below(6));
+}
+
+// e.g 12.25, 3.5
+size_t write_decimal(char* text){
+    size_t length = write_digits(text, 1 + random_below(3));
+    text[length++] = '.';
+    return length + write_digits(text + length, 1 + random_below(4));
+}
+
+// all 17 digits of a double e.g 0.30000000000000004
+size_t write_long(char* text){
+    size_t length = write_digits(text, 1 + random_below(3));
+    text[length++] = '.';
+    return length + write_digits(text + length, 17 - (int) length + 1);
+}
+
+// e.g 1.5e-9, 6.02214076e23
+size_t write_exponent(char* text){
+    size_t length = write_digits(text, 1);
+    text[length++] = '.';
+    length += write_digits(text + length, 1 + random_below(16));
+    return length + sprintf(text + length, "e%s%u", random_below(2) ? "-" : "", random_below(300));
+}
+
+// more digits than fit in 64 bits e.g 123456789012345678901234567890.5
+size_t write_very_long(char* text){
+    size_t length = write_digits(text, 20 + random_below(20));
+    text[length++] = '.';
+    return length + write_digits(text + length, 1 + random_below(8));
+}
+
+void bench_shape(const char* shape, size_t (*write_literal)(char*), char* texts, size_t* lengths, int literals){
+    for(int i = 0; i < literals; i++){
+        lengths[i] = write_literal(texts + (size_t) i * LITERAL_ROOM);
+        texts[(size_t) i * LITERAL_ROOM + lengths[i]] = '\0';
+    }
+
+    // both have to read every character and give the same double
+    int mismatches = 0;
+    for(int i = 0; i < literals; i++){
+        const char* text = texts + (size_t) i * LITERAL_ROOM;
+        size_t used = 0;
+        double value = 0;
+        const double expected = strtod(text, NULL);
+        if(parse_number(text, lengths[i], &used, &value) != CAL_OK || used != lengths[i]
+            || memcmp(&value, &expected, sizeof value) != 0) mismatches++;
+    }
+
+    long long runs = 0;
+    long long start = nanoseconds_now();
+    long long parse_elapsed = 0;
+    do{
+        for(int i = 0; i < literals; i++){
+            size_t used = 0;
+            double value = 0;
+            parse_number(texts + (size_t) i * LITERAL_ROOM, lengths[i], &used, &value);
+            sink = value;
+        }
+        runs++;
+        parse_elapsed = nanoseconds_now() - start;
+    } while(parse_elapsed < MIN_NANOSECONDS);
+    const double parse_ns = (double) parse_elapsed / ((double) runs * literals);
+
+    runs = 0;
+    start = nanoseconds_now();
+    long long strtod_elapsed = 0;
+    do{
+        for(int i = 0; i < literals; i++) sink = strtod(texts + (size_t) i * LITERAL_ROOM, NULL);
+        runs++;
+        strtod_elapsed = nanoseconds_now() - start;
+    } while(strtod_elapsed < MIN_NANOSECONDS);
+    const double strtod_ns = (double) strtod_elapsed / ((double) runs * literals);
+
+    printf("%s,%d,%.1f,%.1f,%.2f,%d\n", shape, literals, parse_ns, strtod_ns, strtod_ns / parse_ns, mismatches);
+}
+
+int main(int argc, char *argv[]){
+    int literals = argc > 1 ? atoi(argv[1]) : DEFAULT_LITERALS;
+    if(literals < 1) literals = 1;
+
+    char* texts = (char *) malloc((size_t) literals * LITERAL_ROOM);
+    size_t* lengths = (size_t *) malloc(sizeof (size_t) * literals);
+    if(texts == NULL || lengths == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    printf("shape,literals,parse_number_ns,strtod_ns,speedup,mismatches\n");
+    bench_shape("whole", write_whole, texts, lengths, literals);
+    bench_shape("decimal", write_decimal, texts, lengths, literals);
+    bench_shape("long", write_long, texts, lengths, literals);
+    bench_shape("exponent", write_exponent, texts, lengths, literals);
+    bench_shape("very_long", write_very_long, texts, lengths, literals);
+
+    free(texts);
+    free(lengths);
+    return 0;
+}
@@ -0,0 +1,262 @@
+// Load on the Unix socket server: every connection is a thread that keeps up to --pipeline lines
+// on the way and times each answer from when its line was sent. Prints CSV with the throughput
+// and the p50/p99/p999 latency. Without --socket a server with --workers threads is started in this process.
+// bench_server [--socket path] [--workers n] [--connections n] [--pipeline n] [--requests n] [--expressions n]
+//              [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "calql8r.h"
+#include "server.h"
+#include "corpus.h"
+
+#define DEFAULT_CONNECTIONS 4
+#define DEFAULT_PIPELINE 16
+#define DEFAULT_REQUESTS 100000
+#define DEFAULT_EXPRESSIONS 1000
+#define MAX_PIPELINE 4096
+#define RECEIVE_SIZE (64 * 1024)
+
+struct Requests{
+    char* text;
+    // where every expression starts in 'text', each one ends with a newline
+    size_t* starts;
+    int count;
+    size_t longest;
+};
+
+struct Client{
+    const char* path;
+    const struct Requests* requests;
+    int pipeline;
+    long long total;
+    // nanoseconds from sending a line until its answer, one per request
+    long long* latencies;
+    long long answered;
+    int failed;
+    pthread_t thread;
+};
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int connect_socket(const char* path){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof address.sun_path - 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    if(connect(fd, (const struct sockaddr*) &address, sizeof address) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int send_all(int fd, const char* data, size_t length){
+    while(length > 0){
+        const ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR) continue;
+        if(sent <= 0) return 0;
+        data += sent;
+        length -= sent;
+    }
+    return 1;
+}
+
+void* client_main(void* arg){
+    struct Client* client = (struct Client*) arg;
+    const struct Requests* requests = client->requests;
+    const int fd = connect_socket(client->path);
+    char* sending = (char *) malloc((size_t) client->pipeline * requests->longest);
+    char* received = (char *) malloc(RECEIVE_SIZE);
+    long long* sent_at = (long long *) malloc(sizeof (long long) * client->pipeline);
+    if(fd < 0 || sending == NULL || received == NULL || sent_at == NULL){
+        client->failed = 1;
+        if(fd >= 0) close(fd);
+        free(sending);
+        free(received);
+        free(sent_at);
+        return NULL;
+    }
+
+    // the send times are a ring of the lines on the way, answers come back in the same order
+    long long sent = 0;
+    int next = 0;
+    while(client->answered < client->total){
+        // tops the lines on the way back up to the pipeline in one send
+        const long long first = sent;
+        size_t length = 0;
+        while(sent - client->answered < client->pipeline && sent < client->total){
+            const size_t size = requests->starts[next + 1] - requests->starts[next];
+            memcpy(sending + length, requests->text + requests->starts[next], size);
+            length += size;
+            sent++;
+            next = (next + 1) % requests->count;
+        }
+        if(length > 0){
+            const long long now = nanoseconds_now();
+            for(long long i = first; i < sent; i++) sent_at[i % client->pipeline] = now;
+            if(!send_all(fd, sending, length)){
+                client->failed = 1;
+                break;
+            }
+        }
+
+        const ssize_t count = recv(fd, received, RECEIVE_SIZE, 0);
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0){
+            client->failed = 1;
+            break;
+        }
+        const long long now = nanoseconds_now();
+        for(ssize_t i = 0; i < count; i++){
+            if(received[i] != '\n') continue;
+            client->latencies[client->answered] = now - sent_at[client->answered % client->pipeline];
+            client->answered++;
+        }
+    }
+
+    close(fd);
+    free(sending);
+    free(received);
+    free(sent_at);
+    return NULL;
+}
+
+int compare_latencies(const void* a, const void* b){
+    const long long x = *(const long long *) a;
+    const long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+double percentile_us(const long long* sorted, long long count, double percent){
+    if(count == 0) return 0;
+    long long index = (long long) (percent / 100 * count);
+    if(index >= count) index = count - 1;
+    return sorted[index] / 1000.0;
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    const char* path = NULL;
+    int workers = 1;
+    int connections = DEFAULT_CONNECTIONS;
+    int pipeline = DEFAULT_PIPELINE;
+    long long total = DEFAULT_REQUESTS;
+    int expressions = DEFAULT_EXPRESSIONS;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc) path = argv[++i];
+        else if(strcmp(argv[i], "--workers") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--connections") == 0 && i + 1 < argc) connections = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) pipeline = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--requests") == 0 && i + 1 < argc) total = atoll(argv[++i]);
+        else if(strcmp(argv[i], "--expressions") == 0 && i + 1 < argc) expressions = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(workers < 1) workers = 1;
+    if(connections < 1) connections = 1;
+    if(pipeline < 1) pipeline = 1;
+    if(pipeline > MAX_PIPELINE) pipeline = MAX_PIPELINE;
+    if(total < connections) total = connections;
+    if(expressions < 1) expressions = 1;
+
+    // the same corpus as the other benchmarks, one expression per line
+    struct Requests requests;
+    char* buffer = (char *) malloc(corpus_buffer_size(&corpus));
+    requests.text = (char *) malloc((corpus_buffer_size(&corpus) + 1) * expressions);
+    requests.starts = (size_t *) malloc(sizeof (size_t) * (expressions + 1));
+    requests.count = expressions;
+    requests.longest = 0;
+    struct Client* clients = (struct Client*) calloc(connections, sizeof (struct Client));
+    long long* latencies = (long long *) malloc(sizeof (long long) * total);
+    if(buffer == NULL || requests.text == NULL || requests.starts == NULL || clients == NULL || latencies == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+    size_t used = 0;
+    for(int i = 0; i < expressions; i++){
+        requests.starts[i] = used;
+        const size_t length = corpus_expression(&corpus, buffer);
+        memcpy(requests.text + used, buffer, length);
+        used += length;
+        requests.text[used++] = '\n';
+        if(length + 1 > requests.longest) requests.longest = length + 1;
+    }
+    requests.starts[expressions] = used;
+
+    struct Server* server = NULL;
+    char own_path[64];
+    if(path == NULL){
+        snprintf(own_path, sizeof own_path, "/tmp/calql8r_bench_%d.sock", (int) getpid());
+        path = own_path;
+        server = server_create(path, workers);
+        if(server == NULL){
+            fprintf(stderr, "CAN NOT LISTEN ON %s\n", path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the requests are shared out over the connections
+    long long offset = 0;
+    for(int i = 0; i < connections; i++){
+        struct Client* client = &clients[i];
+        client->path = path;
+        client->requests = &requests;
+        client->pipeline = pipeline;
+        client->total = total * (i + 1) / connections - total * i / connections;
+        client->latencies = latencies + offset;
+        offset += client->total;
+    }
+
+    const long long start = nanoseconds_now();
+    int started = 0;
+    for(; started < connections; started++){
+        if(pthread_create(&clients[started].thread, NULL, client_main, &clients[started]) != 0) break;
+    }
+    for(int i = 0; i < started; i++) pthread_join(clients[i].thread, NULL);
+    const double seconds = (nanoseconds_now() - start) / 1e9;
+
+    // latencies of the answers that came back, packed together
+    long long answered = 0;
+    int failed = started < connections;
+    offset = 0;
+    for(int i = 0; i < connections; i++){
+        memmove(latencies + answered, latencies + offset, sizeof (long long) * clients[i].answered);
+        answered += clients[i].answered;
+        offset += clients[i].total;
+        failed |= clients[i].failed;
+    }
+    qsort(latencies, answered, sizeof (long long), compare_latencies);
+
+    printf("workers,connections,pipeline,requests,seconds,requests_per_second,p50_us,p99_us,p999_us\n");
+    printf("%d,%d,%d,%lld,%.3f,%.0f,%.1f,%.1f,%.1f\n", server != NULL ? workers : 0, connections, pipeline, answered,
+        seconds, answered / seconds, percentile_us(latencies, answered, 50), percentile_us(latencies, answered, 99),
+        percentile_us(latencies, answered, 99.9));
+    if(failed) fprintf(stderr, "%lld OF %lld REQUESTS WERE NOT ANSWERED\n", total - answered, total);
+
+    server_destroy(server);
+    free(buffer);
+    free(requests.text);
+    free(requests.starts);
+    free(clients);
+    free(latencies);
+    return failed ? EXIT_FAILURE : 0;
+}
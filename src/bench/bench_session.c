@@ -0,0 +1,231 @@
+// Latency of one keystroke on long expressions, the session (edit and calculate what changed) against
+// calql8r_eval_exact on the whole text after the same keystroke. Every answer of the session is checked
+// against calql8r_eval_exact (same status, same bits). The keystrokes are:
+// type   the expression typed from the start one character at a time
+// fix    a character taken away and typed again
+// digit  a digit changed into another one
+// insert a character typed somewhere and taken away again
+// exponent an exponent e.g e-3 typed after a number one character at a time and taken away again
+// bench_session [--count expressions] [--keystrokes n] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"] [--show n]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "calql8r.h"
+#include "corpus.h"
+
+#define DEFAULT_COUNT 10
+#define DEFAULT_LENGTH 2000
+#define DEFAULT_DEPTH 6
+#define DEFAULT_KEYSTROKES 2000
+#define INSERTED "0123456789+-*/^()"
+// typed after a number, every one ends up as part of the number once its last digit is there
+const char* EXPONENTS[] = {"e12", "e-3", "e+5", "e 7"};
+#define EXPONENTS_LENGTH (sizeof EXPONENTS / sizeof EXPONENTS[0])
+
+enum Scenario{ TYPE, FIX, DIGIT, INSERT, EXPONENT_KEYS, SCENARIOS };
+const char* SCENARIO_NAMES[SCENARIOS] = {"type", "fix", "digit", "insert", "exponent"};
+
+struct Latencies{
+    long long* session;
+    long long* full;
+    long long count;
+    long long mismatches;
+};
+
+struct Bench{
+    struct CalQl8r* ctx;
+    struct CalQl8rSession* session;
+    unsigned long long state;
+    int show;
+    int shown;
+};
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+unsigned long long next_random(struct Bench* bench){
+    bench->state ^= bench->state << 13;
+    bench->state ^= bench->state >> 7;
+    bench->state ^= bench->state << 17;
+    return bench->state;
+}
+
+// the session is already edited, 'started' is when the keystroke began
+void keystroke_done(struct Bench* bench, struct Latencies* latencies, long long started){
+    double value = 0;
+    long long integer = 0;
+    int exact = 0;
+    const int status = calql8r_session_eval(bench->session, &value, &integer, &exact);
+    const long long calculated = nanoseconds_now();
+
+    size_t length;
+    const char* text = calql8r_session_text(bench->session, &length);
+    double full_value = 0;
+    long long full_integer = 0;
+    int full_exact = 0;
+    const int full_status = calql8r_eval_exact(bench->ctx, text, length, &full_value, &full_integer, &full_exact);
+    const long long finished = nanoseconds_now();
+
+    latencies->session[latencies->count] = calculated - started;
+    latencies->full[latencies->count++] = finished - calculated;
+
+    int same = status == full_status;
+    if(same && status == CAL_OK) same = exact == full_exact && (!exact || integer == full_integer) && memcmp(&value, &full_value, sizeof value) == 0;
+    if(same) return;
+    latencies->mismatches++;
+    if(bench->shown++ < bench->show){
+        fprintf(stderr, "%.*s\n  session %d %.17g\n  full    %d %.17g\n", (int) length, text, status, value, full_status, full_value);
+    }
+}
+
+void run_scenario(struct Bench* bench, int scenario, const char* text, size_t length, int keystrokes, struct Latencies* latencies){
+    struct CalQl8rSession* session = bench->session;
+    calql8r_session_delete(session, 0, (size_t) -1);
+
+    if(scenario == TYPE){
+        for(size_t i = 0; i < length; i++){
+            const long long started = nanoseconds_now();
+            calql8r_session_insert(session, i, text + i, 1);
+            keystroke_done(bench, latencies, started);
+        }
+        return;
+    }
+
+    // the whole expression is there before the keystrokes start
+    double value;
+    long long integer;
+    int exact;
+    calql8r_session_insert(session, 0, text, length);
+    calql8r_session_eval(session, &value, &integer, &exact);
+
+    for(int k = 0; k < keystrokes; k++){
+        const size_t offset = next_random(bench) % length;
+        const char c = text[offset];
+        long long started = nanoseconds_now();
+
+        if(scenario == FIX){
+            calql8r_session_delete(session, offset, 1);
+            keystroke_done(bench, latencies, started);
+            started = nanoseconds_now();
+            calql8r_session_insert(session, offset, &c, 1);
+            keystroke_done(bench, latencies, started);
+        } else if(scenario == DIGIT){
+            if(c < '0' || c > '9') continue;
+            const char digit = (char) ('0' + next_random(bench) % 10);
+            calql8r_session_delete(session, offset, 1);
+            calql8r_session_insert(session, offset, &digit, 1);
+            keystroke_done(bench, latencies, started);
+        } else if(scenario == EXPONENT_KEYS){
+            // only after the last digit of a number
+            if(c < '0' || c > '9' || (offset + 1 < length && ((text[offset + 1] >= '0' && text[offset + 1] <= '9') || text[offset + 1] == '.'))) continue;
+            const char* exponent = EXPONENTS[next_random(bench) % EXPONENTS_LENGTH];
+            const size_t exponent_length = strlen(exponent);
+            for(size_t j = 0; j < exponent_length; j++){
+                if(j > 0) started = nanoseconds_now();
+                calql8r_session_insert(session, offset + 1 + j, exponent + j, 1);
+                keystroke_done(bench, latencies, started);
+            }
+            for(size_t j = exponent_length; j > 0; j--){
+                started = nanoseconds_now();
+                calql8r_session_delete(session, offset + j, 1);
+                keystroke_done(bench, latencies, started);
+            }
+        } else {
+            const char inserted = INSERTED[next_random(bench) % (sizeof INSERTED - 1)];
+            calql8r_session_insert(session, offset, &inserted, 1);
+            keystroke_done(bench, latencies, started);
+            started = nanoseconds_now();
+            calql8r_session_delete(session, offset, 1);
+            keystroke_done(bench, latencies, started);
+        }
+    }
+}
+
+int compare_latencies(const void* a, const void* b){
+    const long long x = *(const long long *) a;
+    const long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+long long percentile(const long long* sorted, long long count, double percent){
+    if(count == 0) return 0;
+    long long index = (long long) (percent / 100 * count);
+    if(index >= count) index = count - 1;
+    return sorted[index];
+}
+
+double mean(const long long* values, long long count){
+    double total = 0;
+    for(long long i = 0; i < count; i++) total += values[i];
+    return count > 0 ? total / count : 0;
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    corpus.length = DEFAULT_LENGTH;
+    corpus.depth = DEFAULT_DEPTH;
+    int count = DEFAULT_COUNT;
+    int keystrokes = DEFAULT_KEYSTROKES;
+    struct Bench bench = {NULL, NULL, 88172645463325252ULL, 0, 0};
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--keystrokes") == 0 && i + 1 < argc) keystrokes = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--show") == 0 && i + 1 < argc) bench.show = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(keystrokes < 1) keystrokes = 1;
+
+    bench.ctx = calql8r_create();
+    bench.session = calql8r_session_create();
+    char* text = (char *) malloc(corpus_buffer_size(&corpus));
+    // type has one keystroke per character, fix and insert two per keystroke and exponent up to 6
+    const long long most = (long long) count * ((long long) corpus_buffer_size(&corpus) + 6LL * keystrokes);
+    struct Latencies latencies;
+    latencies.session = (long long *) malloc(most * sizeof (long long));
+    latencies.full = (long long *) malloc(most * sizeof (long long));
+    if(bench.ctx == NULL || bench.session == NULL || text == NULL || latencies.session == NULL || latencies.full == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    printf("scenario,expression_length,keystrokes,mismatches,session_p50_ns,session_p99_ns,full_p50_ns,full_p99_ns,session_mean_ns,full_mean_ns\n");
+    for(int scenario = 0; scenario < SCENARIOS; scenario++){
+        // the same expressions for every scenario
+        struct Corpus expressions = corpus;
+        size_t characters = 0;
+        latencies.count = 0;
+        latencies.mismatches = 0;
+        for(int i = 0; i < count; i++){
+            const size_t length = corpus_expression(&expressions, text);
+            characters += length;
+            run_scenario(&bench, scenario, text, length, keystrokes, &latencies);
+        }
+
+        const double session_mean = mean(latencies.session, latencies.count);
+        const double full_mean = mean(latencies.full, latencies.count);
+        qsort(latencies.session, latencies.count, sizeof (long long), compare_latencies);
+        qsort(latencies.full, latencies.count, sizeof (long long), compare_latencies);
+        printf("%s,%zu,%lld,%lld,%lld,%lld,%lld,%lld,%.0f,%.0f\n", SCENARIO_NAMES[scenario], characters / count,
+            latencies.count, latencies.mismatches, percentile(latencies.session, latencies.count, 50),
+            percentile(latencies.session, latencies.count, 99), percentile(latencies.full, latencies.count, 50),
+            percentile(latencies.full, latencies.count, 99), session_mean, full_mean);
+    }
+
+    calql8r_session_destroy(bench.session);
+    calql8r_destroy(bench.ctx);
+    free(text);
+    free(latencies.session);
+    free(latencies.full);
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Times every stage of calculating an expression on its own over a generated corpus.
+// bench_stages [--count expressions] [--iterations n] [--seed n] [--length n] [--depth n] [--ops "+-*/^"] [--functions "SCL"] [--variables "xy"] [--corpus]
+// --corpus only prints the expressions, one per line, so other programs can use the same corpus.
+// Prints CSV, allocations are the mallocs, callocs and reallocs per expression after a first warm up round
+// counted by src/bench/malloc_count.c (the library's and the bench's own, 0 without glibc).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+#include "corpus.h"
+#include "malloc_count.h"
+
+#define DEFAULT_COUNT 1000
+#define DEFAULT_ITERATIONS 10
+
+struct Sample{
+    char* text;
+    size_t length;
+    struct Expression tokens;
+    // tokens once the brackets are calculated, no values when that fails
+    struct Expression resolved;
+    struct CalQl8rProgram* program;
+};
+
+// keeps the answers alive so the calculations can't be optimized away
+volatile double sink;
+
+long long nanoseconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// room for 'length' elements
+int expression_init(struct Expression* expr, size_t length){
+    expr->values = (double *) malloc(sizeof (double) * (length + 1));
+    expr->types = (char *) malloc(length + 1);
+    expr->array_length = 0;
+    return expr->values != NULL && expr->types != NULL;
+}
+
+void expression_copy(struct Expression* to, const struct Expression* from){
+    memcpy(to->values, from->values, sizeof (double) * from->array_length);
+    memcpy(to->types, from->types, from->array_length);
+    to->array_length = from->array_length;
+}
+
+void expression_free(struct Expression* expr){
+    free(expr->values);
+    free(expr->types);
+    expr->values = NULL;
+    expr->types = NULL;
+}
+
+void print_stage(const char* stage, long long operations, long long nanoseconds, size_t allocations){
+    const double ns_per_op = operations > 0 ? (double) nanoseconds / operations : 0;
+    printf("%s,%lld,%.1f,%.0f,%.3f\n", stage, operations, ns_per_op,
+        ns_per_op > 0 ? 1e9 / ns_per_op : 0, operations > 0 ? (double) allocations / operations : 0);
+}
+
+int main(int argc, char *argv[]){
+    struct Corpus corpus;
+    corpus_init(&corpus, 1);
+    int count = DEFAULT_COUNT;
+    int iterations = DEFAULT_ITERATIONS;
+    int print_corpus = FALSE;
+
+    for(int i = 1; i < argc; i++){
+        if(corpus_option(&corpus, argc, argv, &i)) continue;
+        if(strcmp(argv[i], "--count") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--corpus") == 0) print_corpus = TRUE;
+        else {
+            fprintf(stderr, "UNKNOWN OPTION %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(count < 1) count = 1;
+    if(iterations < 1) iterations = 1;
+
+    struct Sample* samples = (struct Sample *) calloc(count, sizeof (struct Sample));
+    char* buffer = (char *) malloc(corpus_buffer_size(&corpus));
+    struct CalQl8r* ctx = calql8r_create();
+    if(samples == NULL || buffer == NULL || ctx == NULL){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    // every stage gets the input the stage before it would give it
+    size_t longest = 0;
+    int failed = 0;
+    for(int i = 0; i < count; i++){
+        struct Sample* sample = &samples[i];
+        sample->length = corpus_expression(&corpus, buffer);
+        sample->text = strdup(buffer);
+        const int tokens_ok = expression_init(&sample->tokens, sample->length);
+        const int resolved_ok = expression_init(&sample->resolved, sample->length);
+        if(sample->text == NULL || !tokens_ok || !resolved_ok){
+            fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+            return EXIT_FAILURE;
+        }
+        if(print_corpus){
+            printf("%s\n", sample->text);
+            continue;
+        }
+
+        lex_expression(sample->text, sample->length, &sample->tokens, (int) sample->length);
+        if(sample->length > longest) longest = sample->length;
+
+        expression_copy(&sample->resolved, &sample->tokens);
+        if(calculate_all_brackets(&sample->resolved, NULL) != CAL_OK) expression_free(&sample->resolved);
+
+        double answer;
+        if(calql8r_eval(ctx, sample->text, sample->length, &answer) != CAL_OK) failed++;
+        if(calql8r_compile(ctx, sample->text, sample->length, &sample->program) != CAL_OK) sample->program = NULL;
+    }
+    if(print_corpus) return 0;
+    if(failed > 0) fprintf(stderr, "%d OF %d EXPRESSIONS GIVE AN ERROR\n", failed, count);
+
+    struct Expression work;
+    if(!expression_init(&work, longest)){
+        fprintf(stderr, "%s\n", calql8r_error_message(CAL_ERROR_MEMORY));
+        return EXIT_FAILURE;
+    }
+
+    printf("stage,expressions,ns_per_op,expressions_per_second,allocations_per_op\n");
+
+    // lexing the text into NUMBER and operator elements
+    size_t allocations = malloc_count();
+    long long start = nanoseconds_now();
+    long long operations = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int i = 0; i < count; i++){
+            lex_expression(samples[i].text, samples[i].length, &work, (int) samples[i].length);
+            sink = work.values[0];
+            operations++;
+        }
+    }
+    print_stage("lex", operations, nanoseconds_now() - start, malloc_count() - allocations);
+
+    // calculate_all_brackets, copying the tokens back in is part of the time
+    allocations = malloc_count();
+    start = nanoseconds_now();
+    operations = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int i = 0; i < count; i++){
+            expression_copy(&work, &samples[i].tokens);
+            calculate_all_brackets(&work, NULL);
+            sink = work.values[0];
+            operations++;
+        }
+    }
+    print_stage("brackets", operations, nanoseconds_now() - start, malloc_count() - allocations);
+
+    // calculate_math on what is left after the brackets, also with copying the elements back in
+    allocations = malloc_count();
+    start = nanoseconds_now();
+    operations = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int i = 0; i < count; i++){
+            if(samples[i].resolved.values == NULL) continue;
+            expression_copy(&work, &samples[i].resolved);
+            calculate_math(&work);
+            sink = work.values[0];
+            operations++;
+        }
+    }
+    print_stage("math", operations, nanoseconds_now() - start, malloc_count() - allocations);
+
+    // all of calql8r_eval
+    allocations = malloc_count();
+    start = nanoseconds_now();
+    operations = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int i = 0; i < count; i++){
+            double answer = 0;
+            calql8r_eval(ctx, samples[i].text, samples[i].length, &answer);
+            sink = answer;
+            operations++;
+        }
+    }
+    print_stage("eval", operations, nanoseconds_now() - start, malloc_count() - allocations);
+
+    // calql8r_compile, every program is one malloc
+    allocations = malloc_count();
+    start = nanoseconds_now();
+    operations = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int i = 0; i < count; i++){
+            struct CalQl8rProgram* program;
+            if(calql8r_compile(ctx, samples[i].text, samples[i].length, &program) == CAL_OK) calql8r_program_free(program);
+            operations++;
+        }
+    }
+    print_stage("compile", operations, nanoseconds_now() - start, malloc_count() - allocations);
+
+    // calql8r_run of the compiled programs
+    allocations = malloc_count();
+    start = nanoseconds_now();
+    operations = 0;
+    for(int iteration = 0; iteration < iterations; iteration++){
+        for(int i = 0; i < count; i++){
+            if(samples[i].program == NULL) continue;
+            double answer = 0;
+            calql8r_run(samples[i].program, &answer);
+            sink = answer;
+            operations++;
+        }
+    }
+    print_stage("run", operations, nanoseconds_now() - start, malloc_count() - allocations);
+
+    for(int i = 0; i < count; i++){
+        free(samples[i].text);
+        expression_free(&samples[i].tokens);
+        expression_free(&samples[i].resolved);
+        if(samples[i].program != NULL) calql8r_program_free(samples[i].program);
+    }
+    free(samples);
+    free(buffer);
+    expression_free(&work);
+    calql8r_destroy(ctx);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+#include "corpus.h"
+
+#define DEFAULT_LENGTH 64
+#define DEFAULT_DEPTH 3
+#define DEFAULT_OPERATORS "+-*/^"
+#define DEFAULT_FUNCTIONS ""
+#define DEFAULT_VARIABLES ""
+
+// longest value is a function, a bracket and 3 values of "99.25+" before the close bracket
+#define VALUE_ROOM 32
+
+void corpus_init(struct Corpus* corpus, unsigned long long seed){
+    // xorshift can't start from 0
+    corpus->state = seed != 0 ? seed : 1;
+    corpus->length = DEFAULT_LENGTH;
+    corpus->depth = DEFAULT_DEPTH;
+    corpus->operators = DEFAULT_OPERATORS;
+    corpus->functions = DEFAULT_FUNCTIONS;
+    corpus->variables = DEFAULT_VARIABLES;
+}
+
+int corpus_option(struct Corpus* corpus, int argc, char* argv[], int* i){
+    if(*i + 1 >= argc) return 0;
+    const char* name = argv[*i];
+    const char* value = argv[*i + 1];
+
+    if(strcmp(name, "--seed") == 0) corpus->state = strtoull(value, NULL, 10) != 0 ? strtoull(value, NULL, 10) : 1;
+    else if(strcmp(name, "--length") == 0) corpus->length = atoi(value);
+    else if(strcmp(name, "--depth") == 0) corpus->depth = atoi(value);
+    else if(strcmp(name, "--ops") == 0) corpus->operators = value;
+    else if(strcmp(name, "--functions") == 0) corpus->functions = value;
+    else if(strcmp(name, "--variables") == 0) corpus->variables = value;
+    else return 0;
+
+    *i += 1;
+    return 1;
+}
+
+size_t corpus_buffer_size(const struct Corpus* corpus){
+    // once the length is reached every open bracket closes after a few values
+    const int length = corpus->length > 0 ? corpus->length : 1;
+    const int depth = corpus->depth > 0 ? corpus->depth : 0;
+    return (size_t) length + (size_t) (depth + 1) * VALUE_ROOM * 3 + 1;
+}
+
+unsigned int corpus_random(struct Corpus* corpus, unsigned int below){
+    // xorshift64*
+    corpus->state ^= corpus->state >> 12;
+    corpus->state ^= corpus->state << 25;
+    corpus->state ^= corpus->state >> 27;
+    return (unsigned int) ((corpus->state * 2685821657736338717ULL) >> 33) % below;
+}
+
+size_t append_group(struct Corpus* corpus, char* buffer, size_t used, int depth, size_t end);
+
+size_t append_value(struct Corpus* corpus, char* buffer, size_t used, int depth){
+    const size_t functions_length = strlen(corpus->functions);
+
+    // only nest while the expression is still short so it ends close to the length
+    if(depth > 0 && used < (size_t) corpus->length && corpus_random(corpus, 2) == 0){
+        if(functions_length > 0 && corpus_random(corpus, 3) == 0) buffer[used++] = corpus->functions[corpus_random(corpus, functions_length)];
+        buffer[used++] = '(';
+        used = append_group(corpus, buffer, used, depth - 1, used + 8 + corpus_random(corpus, 16));
+        buffer[used++] = ')';
+        return used;
+    }
+
+    // without variables nothing is drawn so the same seed still gives the same expressions
+    const size_t variables_length = strlen(corpus->variables);
+    if(variables_length > 0 && corpus_random(corpus, 3) == 0){
+        buffer[used++] = corpus->variables[corpus_random(corpus, variables_length)];
+        return used;
+    }
+
+    // 2 to 99 so roots and logs of single values are fine, sometimes with decimals
+    static const char* decimals[] = { "", "", ".5", ".25" };
+    const char* decimal = decimals[corpus_random(corpus, 4)];
+    const unsigned int number = 2 + corpus_random(corpus, 98);
+    if(number >= 10) buffer[used++] = (char) ('0' + number / 10);
+    buffer[used++] = (char) ('0' + number % 10);
+    while(*decimal) buffer[used++] = *decimal++;
+    return used;
+}
+
+// values with operators between them until 'end' or, inside brackets, at most 3 values once the length is reached
+size_t append_group(struct Corpus* corpus, char* buffer, size_t used, int depth, size_t end){
+    const size_t operators_length = strlen(corpus->operators);
+    int values = 0;
+    do{
+        if(values > 0) buffer[used++] = corpus->operators[corpus_random(corpus, operators_length)];
+        used = append_value(corpus, buffer, used, depth);
+        values++;
+    } while(used < end && (used < (size_t) corpus->length || values < 3) && operators_length > 0);
+    return used;
+}
+
+size_t corpus_expression(struct Corpus* corpus, char* buffer){
+    size_t used = append_group(corpus, buffer, 0, corpus->depth, (size_t) (corpus->length > 0 ? corpus->length : 1));
+    buffer[used] = '\0';
+    return used;
+}
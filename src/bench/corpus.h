@@ -0,0 +1,43 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seeded generator of expressions for the benchmarks.
+// The same seed and options give the same expressions on every platform.
+struct Corpus{
+    unsigned long long state;
+    // about how many characters an expression has
+    int length;
+    // how many brackets can be inside each other, 0 for none
+    int depth;
+    // operators between values, repeat one to make it more common e.g "+++-*/"
+    const char* operators;
+    // functions that can be put in front of brackets e.g "SCL", "" for none
+    const char* functions;
+    // one letter variables that can be used instead of numbers e.g "xy", "" for none
+    const char* variables;
+};
+
+// defaults are 64 characters, depth 3, "+-*/^", no functions and no variables
+void corpus_init(struct Corpus* corpus, unsigned long long seed);
+
+// reads --seed, --length, --depth, --ops, --functions and --variables at argv[*i], moves *i past the value.
+// Gives 0 when argv[*i] isn't a corpus option
+int corpus_option(struct Corpus* corpus, int argc, char* argv[], int* i);
+
+// room corpus_expression needs for one expression
+size_t corpus_buffer_size(const struct Corpus* corpus);
+
+// writes the next expression into 'buffer' with a '\0' and gives its length
+size_t corpus_expression(struct Corpus* corpus, char* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
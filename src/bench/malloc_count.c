@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include "malloc_count.h"
+
+#ifdef __GLIBC__
+
+// glibc's own functions, malloc is still glibc's malloc underneath so free doesn't need a counter
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* memory, size_t size);
+
+size_t heap_calls = 0;
+
+void* malloc(size_t size){
+    heap_calls++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size){
+    heap_calls++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* memory, size_t size){
+    heap_calls++;
+    return __libc_realloc(memory, size);
+}
+
+int malloc_counted(void){
+    return 1;
+}
+
+size_t malloc_count(void){
+    return heap_calls;
+}
+
+#else
+
+int malloc_counted(void){
+    return 0;
+}
+
+size_t malloc_count(void){
+    return 0;
+}
+
+#endif
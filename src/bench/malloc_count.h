@@ -0,0 +1,14 @@
+#ifndef MALLOC_COUNT_H
+#define MALLOC_COUNT_H
+
+#include <stddef.h>
+
+// Counts the times the whole program (the library too) asks the heap for memory with malloc, calloc or realloc.
+// Linking src/bench/malloc_count.c puts the counter in front of glibc's malloc, it isn't thread safe.
+
+// 1 when the heap is counted, without glibc it can't be and malloc_count is always 0
+int malloc_counted(void);
+
+size_t malloc_count(void);
+
+#endif
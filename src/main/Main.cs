@@ -388,33 +388,29 @@ class CalQl8r
 
 
 
-    static void Main(string[] args)
+    // calculates one expression, gives back the answer or the error message Main prints
+    static string Calculate(string text)
     {
 
         var expression = new ArrayList();
 
-        // construct expression for arguments e.g 1+1 +2 /4 *4
-        // white spaces are automatically handled by joining each argument
-        for (int i = 0; i < args.Length; i++) {
-            for (int j = 0; j < args[i].Length; j++) {
-                if (args[i][j] != ' '){
-                    expression.Add(args[i][j].ToString());
-                }                
-            }
+        // white spaces are skipped
+        for (int j = 0; j < text.Length; j++) {
+            if (text[j] != ' '){
+                expression.Add(text[j].ToString());
+            }                
         }
 
         // create the number from string
         expression = ConstructNumbersFromStringOfIntegers(expression);
         if (expression == null) {
-            Console.WriteLine("INVALID NUMBER FORMAT");
-            return;
+            return "INVALID NUMBER FORMAT";
         }
 
         // calculate decimal numbers
         expression = ConstructDecimalNumbers(expression!);
         if (expression == null) {
-            Console.WriteLine("INVALID DECIMAL NUMBER FORMAT");
-            return;
+            return "INVALID DECIMAL NUMBER FORMAT";
         }
 
         // replace all PI symbols with value
@@ -427,25 +423,45 @@ class CalQl8r
         // convert negative numbers
         expression = ConvertNegativeNumbers(expression!);
         if (expression == null){
-            Console.WriteLine("INVALID NEGATIVE NUMBER FORMAT");
-            return;
+            return "INVALID NEGATIVE NUMBER FORMAT";
         }
 
         // Calculate inner bracket expressions
         do {
             expression = CalculateInnermostBrackets(expression, (list) => CalculateMath(list));
             if (expression == null) {
-                Console.WriteLine("MATH ERROR");
-                return;
+                return "MATH ERROR";
             }
         } while (expression!.Contains("("));
 
         var value = CalculateMath(expression);
         if (value == null)  {
-            Console.WriteLine("MATH ERROR");
+            return "MATH ERROR";
+        }
+
+        return value.ToString()!;
+    }
+
+    static void Main(string[] args)
+    {
+
+        // one expression per line from stdin and one answer (or error) per line back
+        if (args.Length == 1 && args[0] == "--batch") {
+            var output = new System.IO.StreamWriter(Console.OpenStandardOutput());
+            string? line;
+            while ((line = Console.In.ReadLine()) != null) {
+                try {
+                    output.WriteLine(Calculate(line));
+                } catch (Exception) {
+                    output.WriteLine("MATH ERROR");
+                }
+            }
+            output.Flush();
             return;
         }
 
-        Console.WriteLine(value);
+        // construct expression for arguments e.g 1+1 +2 /4 *4
+        // white spaces are automatically handled by joining each argument
+        Console.WriteLine(Calculate(String.Join("", args)));
     }
 }
\ No newline at end of file
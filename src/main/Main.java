@@ -324,22 +324,15 @@ public class Main {
     }
 
 
-    public static void main(String[] args) {
-
-        if (args.length <= 1) {
-            System.out.println("PLEASE ADD AN EXPRESSION TO CALCULATE");
-            return;
-        }
+    // calculates one expression, gives back the answer or the error message main prints
+    private static String calculate(String text) {
 
         var expression = new ArrayList();
 
-        // construct expression for arguments e.g 1+1 +2 /4 *4
-        // white spaces are automatically handled by joining each argument
-        for (int i = 1; i < args.length; i++) {
-            for (int j = 0; j < args[i].length(); j++) {
-                if (args[i].charAt(j) != ' '){ //skip white space
-                    expression.add(Character.toString(args[i].charAt(j)));
-                }
+        // white spaces are skipped
+        for (int j = 0; j < text.length(); j++) {
+            if (text.charAt(j) != ' '){ //skip white space
+                expression.add(Character.toString(text.charAt(j)));
             }
         }
 
@@ -349,8 +342,7 @@ public class Main {
         // calculate decimal numbers
         expression = construct_decimal_numbers(expression);
         if (expression == ERROR) {
-            System.out.println("INVALID DECIMAL NUMBER FORMAT");
-            return;
+            return "INVALID DECIMAL NUMBER FORMAT";
         }
 
         // replace all PI symbols with value
@@ -362,25 +354,50 @@ public class Main {
         // convert negative numbers
         expression = convert_negative_numbers(expression);
         if (expression == ERROR){
-            System.out.println("INVALID NEGATIVE NUMBER FORMAT");
-            return;
+            return "INVALID NEGATIVE NUMBER FORMAT";
         }
 
         // Calculate inner bracket expressions
         do {
             expression = calculate_innermost_brackets(expression, Main::calculate_math);
             if (expression == ERROR) {
-                System.out.println("MATH ERROR");
-                return;
+                return "MATH ERROR";
             }
         } while (expression.contains("("));
 
         var value = calculate_math(expression);
         if (value == Double.MIN_VALUE)  {
-            System.out.println("MATH ERROR");
+            return "MATH ERROR";
+        }
+
+        return String.valueOf(value);
+    }
+
+    public static void main(String[] args) throws java.io.IOException {
+
+        // one expression per line from stdin and one answer (or error) per line back
+        if (args.length == 1 && args[0].equals("--batch")) {
+            var input = new java.io.BufferedReader(new java.io.InputStreamReader(System.in));
+            var output = new java.io.PrintWriter(new java.io.BufferedWriter(new java.io.OutputStreamWriter(System.out)));
+            String line;
+            while ((line = input.readLine()) != null) {
+                try {
+                    output.println(calculate(line));
+                } catch (RuntimeException e) {
+                    output.println("MATH ERROR");
+                }
+            }
+            output.flush();
+            return;
+        }
+
+        if (args.length <= 1) {
+            System.out.println("PLEASE ADD AN EXPRESSION TO CALCULATE");
             return;
         }
 
-        System.out.println(value);
+        // construct expression for arguments e.g 1+1 +2 /4 *4
+        // white spaces are automatically handled by joining each argument
+        System.out.println(calculate(String.join("", Arrays.copyOfRange(args, 1, args.length))));
     }
 } 
\ No newline at end of file
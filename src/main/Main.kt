@@ -300,36 +300,27 @@ private fun calculate_innermost_brackets(expression: ArrayList<Any>?, calculate_
     return expression
 }
 
-fun main(args: Array<String>) {
-
-    if (args.size < 1) {
-        println("PLEASE ADD AN EXPRESSION TO CALCULATE")
-        return
-    }
+// calculates one expression, gives back the answer or the error message main prints
+private fun calculate(text: String): String {
     var expression:ArrayList<Any>? = ArrayList<Any>()
 
-    // construct expression for arguments e.g 1+1 +2 /4 *4
-    // white spaces are automatically handled by joining each argument
-    for (i in 1 until args.size) {
-        for (j in 0 until args[i].length) {
-            if(args[i][j].toString() != " "){
-                expression?.add(args[i][j].toString())
-            }
+    // white spaces are skipped
+    for (j in 0 until text.length) {
+        if(text[j].toString() != " "){
+            expression?.add(text[j].toString())
         }
     }
 
     // create the number from string
     expression = construct_numbers_from_string_of_integers(expression)
     if (expression === null) {
-        println("INVALID NUMBER FORMAT")
-        return
+        return "INVALID NUMBER FORMAT"
     }
 
     // calculate decimal numbers
     expression = construct_decimal_numbers(expression)
     if (expression === null) {
-        println("INVALID DECIMAL NUMBER FORMAT")
-        return
+        return "INVALID DECIMAL NUMBER FORMAT"
     }
 
     // replace all PI symbols with value
@@ -341,23 +332,44 @@ fun main(args: Array<String>) {
     // convert negative numbers
     expression = convert_negative_numbers(expression)
     if (expression === null) {
-        println("INVALID NEGATIVE NUMBER FORMAT")
-        return
+        return "INVALID NEGATIVE NUMBER FORMAT"
     }
 
     // Calculate inner bracket expressions
     do {
         expression = calculate_innermost_brackets(expression) {expr -> calculate_math(expr) }
         if (expression === null) {
-            println("MATH ERROR")
-            return
+            return "MATH ERROR"
         }
     } while (expression!!.contains("("))
     val value = calculate_math(expression)
     if (value == null) {
-        println("MATH ERROR")
+        return "MATH ERROR"
+    }
+    return value.toString()
+}
+
+fun main(args: Array<String>) {
+
+    // one expression per line from stdin and one answer (or error) per line back
+    if (args.size == 1 && args[0] == "--batch") {
+        val output = System.out.bufferedWriter()
+        System.`in`.bufferedReader().forEachLine { line ->
+            val answer = try { calculate(line) } catch (e: RuntimeException) { "MATH ERROR" }
+            output.write(answer)
+            output.newLine()
+        }
+        output.flush()
         return
     }
-    println(value)
+
+    if (args.size < 1) {
+        println("PLEASE ADD AN EXPRESSION TO CALCULATE")
+        return
+    }
+
+    // construct expression for arguments e.g 1+1 +2 /4 *4
+    // white spaces are automatically handled by joining each argument
+    println(calculate(args.drop(1).joinToString("")))
 }
 
@@ -0,0 +1,215 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calql8r.h"
+#include "batch.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define BATCH_READ_SIZE (1 << 20)
+#define BATCH_FLUSH_SIZE (1 << 20)
+#define ANSWER_MAX_LENGTH 512
+
+int output_init(struct OutputBuffer* out, size_t capacity){
+    out->data = (char *) malloc(capacity);
+    out->length = 0;
+    out->capacity = out->data == NULL ? 0 : capacity;
+    return out->data == NULL ? CAL_ERROR_MEMORY : CAL_OK;
+}
+
+int output_write(struct OutputBuffer* out, const char* text, size_t length){
+    if(out->capacity - out->length < length){
+        size_t capacity = out->capacity * 2;
+        if(capacity < out->length + length) capacity = out->length + length;
+
+        char* data = (char *) realloc(out->data, capacity);
+        if(data == NULL) return CAL_ERROR_MEMORY;
+        out->data = data;
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+    return CAL_OK;
+}
+
+// same format as the answer of main
+int output_answer(struct OutputBuffer* out, int status, double answer, long long integer, int exact){
+    char text[ANSWER_MAX_LENGTH];
+    int length;
+    if(status == CAL_OK && exact) length = snprintf(text, sizeof text, "%lld.000000\n", integer);
+    else if(status == CAL_OK) length = snprintf(text, sizeof text, "%lf\n", answer);
+    else length = snprintf(text, sizeof text, "%s\n", calql8r_error_message(status));
+    if(length < 0) return CAL_ERROR_MEMORY;
+    if(length >= (int) sizeof text) length = sizeof text - 1;
+    return output_write(out, text, length);
+}
+
+int output_flush(struct OutputBuffer* out, FILE* file){
+    if(out->length > 0 && fwrite(out->data, 1, out->length, file) != out->length) return EOF;
+    out->length = 0;
+    return 0;
+}
+
+void output_free(struct OutputBuffer* out){
+    free(out->data);
+    out->data = NULL;
+    out->length = 0;
+    out->capacity = 0;
+}
+
+int batch_calculate_lines(struct CalQl8r* ctx, const char* data, size_t length, struct OutputBuffer* out){
+    const char* end = data + length;
+    while(data < end){
+        const char* newline = (const char *) memchr(data, '\n', end - data);
+        const char* line_end = newline == NULL ? end : newline;
+
+        double answer = 0;
+        long long integer = 0;
+        int exact = 0;
+        int status = calql8r_eval_exact(ctx, data, line_end - data, &answer, &integer, &exact);
+        if(output_answer(out, status, answer, integer, exact) != CAL_OK) return CAL_ERROR_MEMORY;
+
+        if(newline == NULL) break;
+        data = newline + 1;
+    }
+    return CAL_OK;
+}
+
+// lines are calculated on this thread or spread over the pool
+int calculate_lines(struct CalQl8r* ctx, struct BatchPool* pool, const char* data, size_t length, struct OutputBuffer* out){
+    if(pool != NULL) return batch_pool_calculate(pool, data, length, out);
+    return batch_calculate_lines(ctx, data, length, out);
+}
+
+int run_batch(FILE* input, FILE* output, int threads){
+    struct CalQl8r* ctx = calql8r_create();
+    struct BatchPool* pool = threads > 1 ? batch_pool_create(threads) : NULL;
+
+    // every thread gets a full read worth of lines
+    size_t capacity = BATCH_READ_SIZE * (threads > 1 ? threads : 1);
+    char* buffer = (char *) malloc(capacity);
+    struct OutputBuffer out;
+    int status = output_init(&out, BATCH_FLUSH_SIZE + ANSWER_MAX_LENGTH);
+
+    if(ctx == NULL || buffer == NULL || status != CAL_OK || (threads > 1 && pool == NULL)){
+        calql8r_destroy(ctx);
+        batch_pool_destroy(pool);
+        free(buffer);
+        output_free(&out);
+        return CAL_ERROR_MEMORY;
+    }
+
+    // 'kept' is the start of a line that hasn't ended yet
+    size_t kept = 0;
+    while(status == CAL_OK){
+        size_t read = fread(buffer + kept, 1, capacity - kept, input);
+        if(read == 0){
+            // the last line doesn't need a newline
+            if(kept > 0) status = calculate_lines(ctx, pool, buffer, kept, &out);
+            break;
+        }
+
+        size_t total = kept + read;
+        size_t last_newline = total;
+        while(last_newline > 0 && buffer[last_newline - 1] != '\n') last_newline--;
+
+        if(last_newline == 0){
+            // one line is longer than the buffer, make room for it
+            kept = total;
+            if(kept == capacity){
+                char* bigger = (char *) realloc(buffer, capacity * 2);
+                if(bigger == NULL){
+                    status = CAL_ERROR_MEMORY;
+                    break;
+                }
+                buffer = bigger;
+                capacity *= 2;
+            }
+            continue;
+        }
+
+        status = calculate_lines(ctx, pool, buffer, last_newline, &out);
+        kept = total - last_newline;
+        memmove(buffer, buffer + last_newline, kept);
+
+        if(status == CAL_OK && out.length >= BATCH_FLUSH_SIZE) status = output_flush(&out, output);
+    }
+
+    if(status == CAL_OK) status = output_flush(&out, output);
+    if(status == CAL_OK && ferror(input)) status = EOF;
+
+    calql8r_destroy(ctx);
+    batch_pool_destroy(pool);
+    free(buffer);
+    output_free(&out);
+    return status;
+}
+
+int run_batch_mapped(int fd, FILE* output, int threads){
+#ifdef _WIN32
+    (void) fd;
+    (void) output;
+    (void) threads;
+    return BATCH_NOT_MAPPED;
+#else
+    // pipes, terminals and files someone already read from go through run_batch
+    struct stat file;
+    if(fstat(fd, &file) != 0 || !S_ISREG(file.st_mode) || file.st_size == 0 || lseek(fd, 0, SEEK_CUR) != 0) return BATCH_NOT_MAPPED;
+    const size_t length = (size_t) file.st_size;
+    char* data = (char *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) return BATCH_NOT_MAPPED;
+    madvise(data, length, MADV_SEQUENTIAL);
+
+    struct CalQl8r* ctx = calql8r_create();
+    struct BatchPool* pool = threads > 1 ? batch_pool_create(threads) : NULL;
+    struct OutputBuffer out;
+    int status = output_init(&out, BATCH_FLUSH_SIZE + ANSWER_MAX_LENGTH);
+    if(ctx == NULL || status != CAL_OK || (threads > 1 && pool == NULL)){
+        calql8r_destroy(ctx);
+        batch_pool_destroy(pool);
+        output_free(&out);
+        munmap(data, length);
+        return CAL_ERROR_MEMORY;
+    }
+
+    // the same pieces run_batch reads, ending on a newline, but calculated where they are in the mapping
+    const size_t window = BATCH_READ_SIZE * (threads > 1 ? threads : 1);
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start = 0;
+    size_t released = 0;
+    while(status == CAL_OK && start < length){
+        size_t end = start + window;
+        if(end >= length){
+            end = length;
+        } else {
+            const char* newline = (const char *) memchr(data + end - 1, '\n', length - end + 1);
+            end = newline == NULL ? length : (size_t) (newline - data) + 1;
+        }
+
+        status = calculate_lines(ctx, pool, data + start, end - start, &out);
+        start = end;
+        if(status == CAL_OK && out.length >= BATCH_FLUSH_SIZE) status = output_flush(&out, output);
+
+        // pages that are done with don't have to stay, a file bigger than the memory still fits
+        const size_t done = start / page * page;
+        if(done > released){
+            madvise(data + released, done - released, MADV_DONTNEED);
+            released = done;
+        }
+    }
+    if(status == CAL_OK) status = output_flush(&out, output);
+
+    calql8r_destroy(ctx);
+    batch_pool_destroy(pool);
+    output_free(&out);
+    munmap(data, length);
+    return status;
+#endif
+}
@@ -0,0 +1,48 @@
+#ifndef CALQL8R_BATCH_H
+#define CALQL8R_BATCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "calql8r.h"
+
+// Answers are collected here and written out in big pieces instead of a printf per answer
+struct OutputBuffer{
+    char* data;
+    size_t length;
+    size_t capacity;
+};
+
+int output_init(struct OutputBuffer* out, size_t capacity);
+int output_write(struct OutputBuffer* out, const char* text, size_t length);
+int output_answer(struct OutputBuffer* out, int status, double answer, long long integer, int exact);
+int output_flush(struct OutputBuffer* out, FILE* file);
+void output_free(struct OutputBuffer* out);
+
+// Calculates every line in 'data' and writes one answer or error per line.
+// Every line ends with a newline except maybe the last one. A bad line only gives an error for that line.
+int batch_calculate_lines(struct CalQl8r* ctx, const char* data, size_t length, struct OutputBuffer* out);
+
+// Threads that calculate chunks of lines together. Each thread has its own context
+// and steals chunks from the others when it runs out.
+struct BatchPool;
+
+struct BatchPool* batch_pool_create(int threads);
+void batch_pool_destroy(struct BatchPool* pool);
+
+// Same as batch_calculate_lines but the lines are spread over all the threads.
+// The answers are still written in the same order as the lines.
+int batch_pool_calculate(struct BatchPool* pool, const char* data, size_t length, struct OutputBuffer* out);
+
+// Reads expressions line by line from 'input' until the end and writes the answers to 'output'
+// using 'threads' threads. Returns CAL_OK, CAL_ERROR_MEMORY or EOF when reading or writing failed.
+int run_batch(FILE* input, FILE* output, int threads);
+
+// run_batch_mapped gives this when the input isn't a file it can map, run_batch has to read it instead
+#define BATCH_NOT_MAPPED 1
+
+// Same as run_batch for a file on disk ('fd' at its start), the lines are calculated straight from a
+// read only mapping of the file instead of being copied into a buffer first. Each piece of the
+// mapping is cut into newline aligned chunks for the threads like run_batch does with what it reads
+int run_batch_mapped(int fd, FILE* output, int threads);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "calql8r.h"
+#include "batch.h"
+
+#define BATCH_CHUNK_SIZE (64 * 1024)
+#define NO_CHUNK -1
+
+// newline aligned piece of the input and its answers
+struct BatchChunk{
+    const char* data;
+    size_t length;
+    struct OutputBuffer out;
+    int status;
+};
+
+// chunks given to one thread. the owner takes from the back and
+// threads that run out of work steal from the front
+struct WorkQueue{
+    pthread_mutex_t lock;
+    int* chunks;
+    int front;
+    int back;
+};
+
+struct BatchWorker{
+    struct BatchPool* pool;
+    struct CalQl8r* ctx;
+    struct WorkQueue queue;
+    pthread_t thread;
+    int id;
+};
+
+struct BatchPool{
+    struct BatchWorker* workers;
+    int threads;
+
+    struct BatchChunk* chunks;
+    int chunks_length;
+    int chunks_capacity;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    unsigned long generation;
+    int busy_workers;
+    int stop;
+};
+
+int take_chunk(struct BatchWorker* worker){
+    struct WorkQueue* queue = &worker->queue;
+    int chunk = NO_CHUNK;
+
+    pthread_mutex_lock(&queue->lock);
+    if(queue->back > queue->front) chunk = queue->chunks[--queue->back];
+    pthread_mutex_unlock(&queue->lock);
+    if(chunk != NO_CHUNK) return chunk;
+
+    // steal the oldest chunk of another thread so an expensive piece doesn't hold everyone up
+    struct BatchPool* pool = worker->pool;
+    for(int i = 1; i < pool->threads; i++){
+        struct WorkQueue* victim = &pool->workers[(worker->id + i) % pool->threads].queue;
+        pthread_mutex_lock(&victim->lock);
+        if(victim->back > victim->front) chunk = victim->chunks[victim->front++];
+        pthread_mutex_unlock(&victim->lock);
+        if(chunk != NO_CHUNK) return chunk;
+    }
+    return NO_CHUNK;
+}
+
+void* batch_worker_main(void* arg){
+    struct BatchWorker* worker = (struct BatchWorker*) arg;
+    struct BatchPool* pool = worker->pool;
+    unsigned long seen = 0;
+
+    for(;;){
+        pthread_mutex_lock(&pool->lock);
+        while(!pool->stop && pool->generation == seen) pthread_cond_wait(&pool->work_ready, &pool->lock);
+        if(pool->stop){
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        int chunk;
+        while((chunk = take_chunk(worker)) != NO_CHUNK){
+            struct BatchChunk* c = &pool->chunks[chunk];
+            c->out.length = 0;
+            c->status = batch_calculate_lines(worker->ctx, c->data, c->length, &c->out);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->busy_workers == 0) pthread_cond_signal(&pool->work_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+struct BatchPool* batch_pool_create(int threads){
+    struct BatchPool* pool = (struct BatchPool*) calloc(1, sizeof (struct BatchPool));
+    if(pool == NULL) return NULL;
+    pool->workers = (struct BatchWorker*) calloc(threads, sizeof (struct BatchWorker));
+    if(pool->workers == NULL){
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    for(int i = 0; i < threads; i++){
+        struct BatchWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->id = i;
+        pthread_mutex_init(&worker->queue.lock, NULL);
+        worker->ctx = calql8r_create();
+        if(worker->ctx == NULL || pthread_create(&worker->thread, NULL, batch_worker_main, worker) != 0){
+            calql8r_destroy(worker->ctx);
+            pthread_mutex_destroy(&worker->queue.lock);
+            batch_pool_destroy(pool);
+            return NULL;
+        }
+        pool->threads++;
+    }
+    return pool;
+}
+
+void batch_pool_destroy(struct BatchPool* pool){
+    if(pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(int i = 0; i < pool->threads; i++){
+        struct BatchWorker* worker = &pool->workers[i];
+        pthread_join(worker->thread, NULL);
+        calql8r_destroy(worker->ctx);
+        pthread_mutex_destroy(&worker->queue.lock);
+        free(worker->queue.chunks);
+    }
+    for(int i = 0; i < pool->chunks_capacity; i++) output_free(&pool->chunks[i].out);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->chunks);
+    free(pool->workers);
+    free(pool);
+}
+
+// makes room for 'count' chunks, only called while the workers are waiting.
+// The room at least doubles so a big input doesn't realloc once per chunk, and the capacity only
+// changes once the chunks and every queue have grown so a failed realloc leaves the pool as it was
+int reserve_chunks(struct BatchPool* pool, int count){
+    if(count <= pool->chunks_capacity) return CAL_OK;
+    int capacity = pool->chunks_capacity * 2;
+    if(capacity < count) capacity = count;
+
+    struct BatchChunk* chunks = (struct BatchChunk*) realloc(pool->chunks, capacity * sizeof (struct BatchChunk));
+    if(chunks == NULL) return CAL_ERROR_MEMORY;
+    pool->chunks = chunks;
+    for(int i = pool->chunks_capacity; i < capacity; i++){
+        chunks[i].out.data = NULL;
+        chunks[i].out.length = 0;
+        chunks[i].out.capacity = 0;
+    }
+
+    for(int i = 0; i < pool->threads; i++){
+        int* queue = (int *) realloc(pool->workers[i].queue.chunks, capacity * sizeof (int));
+        if(queue == NULL) return CAL_ERROR_MEMORY;
+        pool->workers[i].queue.chunks = queue;
+    }
+    pool->chunks_capacity = capacity;
+    return CAL_OK;
+}
+
+int batch_pool_calculate(struct BatchPool* pool, const char* data, size_t length, struct OutputBuffer* out){
+
+    // cut the lines into chunks that end on a newline
+    pool->chunks_length = 0;
+    size_t start = 0;
+    while(start < length){
+        size_t end = start + BATCH_CHUNK_SIZE;
+        if(end >= length){
+            end = length;
+        } else {
+            const char* newline = (const char *) memchr(data + end, '\n', length - end);
+            end = newline == NULL ? length : (size_t) (newline - data) + 1;
+        }
+
+        if(reserve_chunks(pool, pool->chunks_length + 1) != CAL_OK) return CAL_ERROR_MEMORY;
+        struct BatchChunk* chunk = &pool->chunks[pool->chunks_length++];
+        chunk->data = data + start;
+        chunk->length = end - start;
+        chunk->status = CAL_OK;
+        start = end;
+    }
+    if(pool->chunks_length == 0) return CAL_OK;
+
+    // every thread starts with its own run of neighbouring chunks
+    for(int i = 0; i < pool->threads; i++){
+        struct WorkQueue* queue = &pool->workers[i].queue;
+        const int first = (int) ((long long) pool->chunks_length * i / pool->threads);
+        const int last = (int) ((long long) pool->chunks_length * (i + 1) / pool->threads);
+        for(int j = first; j < last; j++) queue->chunks[j - first] = j;
+        queue->front = 0;
+        queue->back = last - first;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy_workers = pool->threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    while(pool->busy_workers > 0) pthread_cond_wait(&pool->work_done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    // answers go out in the same order as the input
+    for(int i = 0; i < pool->chunks_length; i++){
+        struct BatchChunk* chunk = &pool->chunks[i];
+        if(chunk->status != CAL_OK) return chunk->status;
+        if(output_write(out, chunk->out.data, chunk->out.length) != CAL_OK) return CAL_ERROR_MEMORY;
+    }
+    return CAL_OK;
+}
@@ -0,0 +1,912 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h> 
+#include <limits.h>
+#include <time.h>
+#include "calql8r.h"
+
+#include "calql8r_internal.h"
+
+int is_whitespace(char c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+int is_digit(char c){
+    return c >= '0' && c <= '9';
+}
+
+// variable names are letters, digits and '_' that don't start with a digit e.g x, rate_2
+int is_variable_character(char c, int first){
+    if(c == '_') return TRUE;
+    if(!first && is_digit(c)) return TRUE;
+    if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) return FALSE;
+    return strchr(RESERVED_LETTERS, c) == NULL;
+}
+
+// Reads one element that starts at text[*i] (not whitespace) and moves *i past it.
+// 'prev' is the type of the element before it (BRACKET_OPEN at the start), it decides what a minus sign is.
+// Whitespace is skipped everywhere (even between digits, "55.7 36" is 55.736 like before),
+// decimals (also with an exponent e.g 1.5e-9) and 'p' become NUMBER elements and a minus sign in front of a number
+// at the start, after a bracket or after an operator makes the number negative e.g -1+2, 2*(-3), 2*-3.
+// In front of anything else that minus sign is an OPERATOR_NEGATE e.g -x, -(1+2).
+// Names that aren't operators become VARIABLE elements.
+// Always inlined into lex_expression, the call per element was about 10% of lexing.
+static inline __attribute__((always_inline)) int read_token(const char* text, size_t length, size_t* index, char prev, double* value, char* type){
+    size_t i = *index;
+    const char c = text[i];
+
+    // a minus is a negative sign when there isn't a value on its left
+    int negative = FALSE;
+    if(c == OPERATOR_SUBSTRACT && prev != NUMBER && prev != VARIABLE && prev != BRACKET_CLOSE && prev != OPERATOR_FACTORIAL){
+        size_t next = i + 1;
+        while(next < length && is_whitespace(text[next])) next++;
+        if(next < length && (is_digit(text[next]) || text[next] == PI)){
+            negative = TRUE;
+            i = next;
+        } else {
+            *value = 0.0;
+            *type = OPERATOR_NEGATE;
+            *index = i + 1;
+            return CAL_OK;
+        }
+    }
+
+    const char d = text[i];
+
+    if(!negative && is_variable_character(d, TRUE)){
+        size_t start = i;
+        while(i < length && is_variable_character(text[i], FALSE)) i++;
+        *index = i;
+        if(i - start > USHRT_MAX) return CAL_ERROR_SYNTAX;
+
+        *value = (double) start;
+        *type = VARIABLE;
+        return CAL_OK;
+    }
+
+    if(!negative && !is_digit(d) && d != PI && d != DECIMAL_POINT){
+        //add non-numeric elements
+        *value = 0.0;
+        *type = d;
+        *index = i + 1;
+        return CAL_OK;
+    }
+
+    double number;
+    if(d == PI){
+        number = M_PI; // M_PI is from <math.h> e.g 4.0 * atan(1.0);
+        i++;
+    } else {
+        const int status = parse_number(text, length, &i, &number);
+        *index = i;
+        if(status != CAL_OK) return CAL_ERROR_SYNTAX;
+
+        // only one decimal point per number e.g 1.2.3
+        if(i < length && text[i] == DECIMAL_POINT) return CAL_ERROR_SYNTAX;
+    }
+
+    *value = negative ? -number : number;
+    *type = NUMBER;
+    *index = i;
+    return CAL_OK;
+}
+
+// read_token for the session, it reads the elements around an edit one at a time
+int lex_token(const char* text, size_t length, size_t* index, char prev, double* value, char* type){
+    return read_token(text, length, index, prev, value, type);
+}
+
+// Reads the text once from left to right and writes the numbers and operators into 'expr'.
+int lex_expression(const char* text, size_t length, struct Expression* expr, int capacity){
+    double* values = expr->values;
+    char* types = expr->types;
+    int expr_index = 0;
+    size_t i = 0;
+    expr->array_length = 0;
+
+    while(i < length){
+        if(is_whitespace(text[i])){
+            i++;
+            continue;
+        }
+
+        if(expr_index == capacity) return CAL_ERROR_TOO_MANY_VALUES;
+
+        //add element to expression array
+        const char prev = expr_index == 0 ? BRACKET_OPEN : types[expr_index - 1];
+        if(read_token(text, length, &i, prev, &values[expr_index], &types[expr_index]) != CAL_OK) return CAL_ERROR_SYNTAX;
+        expr_index++;
+    }
+
+    expr->array_length = expr_index;
+    return CAL_OK;
+}
+
+// moves the elements that aren't NUMBER_REMOVE to the front from 'first_removed' on
+static inline int compact_elements(double* values, char* types, int length, int first_removed){
+    int write = first_removed;
+    for(int i = first_removed + 1; i < length; i++){
+        if(types[i] == NUMBER_REMOVE) continue;
+        values[write] = values[i];
+        types[write++] = types[i];
+    }
+    return write;
+}
+
+// Calculates every FUNCTION_SYMBOL with the values on both sides of it e.g 2*3*4. The answers are compacted
+// into the same elements and 'expr' is left with what is still there.
+int calculate_2_value_expressions(struct Expression* expr, char FUNCTION_SYMBOL, struct Element (*callbackFunction) (double, double)){
+    double* values = expr->values;
+    char* types = expr->types;
+    const int length = expr->array_length;
+
+    // a pass that doesn't find its operator leaves everything where it is
+    int first_removed = -1;
+    int prev_number_index = -1;
+    for(int i = 0; i < length; i++){
+        char c = types[i];
+
+        if(c == FUNCTION_SYMBOL){
+            // if the decimal is on the first or last position
+            if((i == 0) || (i == length-1)) return CAL_ERROR_SYNTAX;
+            
+            // Check if both side of the decimal are number values
+            if (types[i-1] == NUMBER && types[i+1] == NUMBER && prev_number_index==-1){ 
+                struct Element ele = callbackFunction(values[i-1], values[i+1]);
+                if(ele.type == CAL_ELEMENT_ERROR) return CAL_ERROR_SYNTAX;
+                values[i-1] = ele.value;
+                prev_number_index = i-1;
+                types[i] = NUMBER_REMOVE;
+                types[i+1] = NUMBER_REMOVE;
+            }else if(types[i+1] == NUMBER && prev_number_index > -1){  // There is a trailing NUMBER_REMOVE values
+                struct Element ele = callbackFunction(values[prev_number_index], values[i+1]);
+                if(ele.type == CAL_ELEMENT_ERROR) return CAL_ERROR_SYNTAX;
+                values[prev_number_index] = ele.value;
+                types[i] = NUMBER_REMOVE;
+                types[i+1] = NUMBER_REMOVE;
+            } else {
+                return CAL_ERROR_SYNTAX;
+            }
+            if(first_removed == -1) first_removed = i;
+        }
+        else if(c != NUMBER_REMOVE) prev_number_index =-1; // There isn't any trailing NUMBER_REMOVE values
+    }
+
+    if(first_removed != -1) expr->array_length = compact_elements(values, types, length, first_removed);
+    return CAL_OK;
+}
+
+
+// Same as calculate_2_value_expressions for functions (the value on their right) and factorials (on their left)
+int calculate_1_value_expression(struct Expression* expr, char FUNCTION_SYMBOL, int function_value_direction, struct Element (*callbackFunction) (double)){
+    double* values = expr->values;
+    char* types = expr->types;
+    const int length = expr->array_length;
+
+    int first_removed = -1;
+    for(int i = 0; i < length; i++){
+        char c = types[i];
+        if(c == FUNCTION_SYMBOL){
+            // if the decimal is on the first or last position
+            if((i == 0 && function_value_direction == FUNCTION_VALUE_DIRECTION_LEFT) || ((i == (length-1)) && function_value_direction == FUNCTION_VALUE_DIRECTION_RIGHT)){
+                return CAL_ERROR_SYNTAX;
+            }            
+
+            const int value_index = function_value_direction == FUNCTION_VALUE_DIRECTION_LEFT ? i - 1 : i + 1;
+            if (types[value_index] != NUMBER) return CAL_ERROR_SYNTAX;
+
+            // calculate the value
+            struct Element ele = callbackFunction(values[value_index]);
+            if(ele.type == CAL_ELEMENT_ERROR) return CAL_ERROR_SYNTAX;
+            values[value_index] = ele.value;
+            types[i] = NUMBER_REMOVE;
+            if(first_removed == -1) first_removed = i;
+        }
+    }
+
+    if(first_removed != -1) expr->array_length = compact_elements(values, types, length, first_removed);
+    return CAL_OK;
+}
+
+
+struct Element calculate_sin(double num){
+    struct Element e;
+    e.value = sin(num);
+    e.type = NUMBER;
+    return e;
+}
+
+struct Element calculate_sinh(double num){
+    struct Element e;
+    e.value = sinh(num);
+    e.type = NUMBER;
+    return e;
+}
+
+struct Element calculate_cos(double num){
+    struct Element e;
+    e.value = cos(num);
+    e.type = NUMBER;
+    return e;
+}
+
+struct Element calculate_cosh(double num){
+    struct Element e;
+    e.value = cosh(num);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_tan(double num){
+    struct Element e;
+    e.value = tan(num);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_tanh(double num){
+    struct Element e;
+    e.value = tanh(num);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_log10(double num){
+    struct Element e;
+    if(num <= 0) {
+        e.type = CAL_ELEMENT_ERROR;
+        e.value =0;
+        return e;
+    }
+    e.value = log10(num);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_ln(double num){
+    struct Element e;
+    if(num <= 0) {
+        e.type = CAL_ELEMENT_ERROR;
+        e.value =0;
+        return e;
+    }
+    e.value = log(num)/log(exp(1));
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_e(double num){
+    struct Element e;
+    e.value = exp(num);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_add(double num1, double num2){
+    struct Element e;
+    e.value = num1 + num2;
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_substract(double num1, double num2){
+    struct Element e;
+    e.value = num1 - num2;
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_multiply(double num1, double num2){
+    struct Element e;
+    e.value = num1 * num2;
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_divide(double num1, double num2){
+    struct Element e;
+    if(num2 ==0) {
+        e.type = CAL_ELEMENT_ERROR;
+        e.value =0;
+        return e;
+    }
+    e.value = num1 / num2;
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_pow(double base, double exp){
+    struct Element e;
+    e.value = pow(base, exp);
+    e.type = NUMBER;
+    return e;
+}
+
+struct Element calculate_root(double num1, double num2){
+    struct Element e;
+    if(num1 <= 0) {
+        e.type = CAL_ELEMENT_ERROR;
+        e.value =0;
+        return e;
+    }
+    e.value = pow(num2 , 1 / num1);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+struct Element calculate_log(double base, double raised){
+    struct Element e;
+    if(base <= 0 || raised <=0 ) {
+        e.type = CAL_ELEMENT_ERROR;
+        e.value =0;
+        return e;
+    }
+    e.value = log(raised)/log(base);
+    e.type = NUMBER;
+    return e;
+    
+}
+
+// n! for every n up to EXACT_FACTORIAL_LIMIT, the biggest that fits in 64 bits
+static const unsigned long long EXACT_FACTORIALS[EXACT_FACTORIAL_LIMIT + 1] = {
+    1ULL, 1ULL, 2ULL, 6ULL,
+    24ULL, 120ULL, 720ULL, 5040ULL,
+    40320ULL, 362880ULL, 3628800ULL, 39916800ULL,
+    479001600ULL, 6227020800ULL, 87178291200ULL, 1307674368000ULL,
+    20922789888000ULL, 355687428096000ULL, 6402373705728000ULL, 121645100408832000ULL,
+    2432902008176640000ULL
+};
+
+// n! rounded to the nearest double for every n up to FACTORIAL_LIMIT, the biggest that isn't infinity
+static const double FACTORIALS[FACTORIAL_LIMIT + 1] = {
+    1.0, 1.0, 2.0, 6.0,
+    24.0, 120.0, 720.0, 5040.0,
+    40320.0, 362880.0, 3628800.0, 39916800.0,
+    479001600.0, 6227020800.0, 87178291200.0, 1307674368000.0,
+    20922789888000.0, 355687428096000.0, 6402373705728000.0, 1.21645100408832e+17,
+    2.43290200817664e+18, 5.109094217170944e+19, 1.1240007277776077e+21, 2.585201673888498e+22,
+    6.204484017332394e+23, 1.5511210043330986e+25, 4.0329146112660565e+26, 1.0888869450418352e+28,
+    3.0488834461171387e+29, 8.841761993739702e+30, 2.6525285981219107e+32, 8.222838654177922e+33,
+    2.631308369336935e+35, 8.683317618811886e+36, 2.9523279903960416e+38, 1.0333147966386145e+40,
+    3.7199332678990125e+41, 1.3763753091226346e+43, 5.230226174666011e+44, 2.0397882081197444e+46,
+    8.159152832478977e+47, 3.345252661316381e+49, 1.40500611775288e+51, 6.041526306337383e+52,
+    2.658271574788449e+54, 1.1962222086548019e+56, 5.502622159812089e+57, 2.5862324151116818e+59,
+    1.2413915592536073e+61, 6.082818640342675e+62, 3.0414093201713376e+64, 1.5511187532873822e+66,
+    8.065817517094388e+67, 4.2748832840600255e+69, 2.308436973392414e+71, 1.2696403353658276e+73,
+    7.109985878048635e+74, 4.0526919504877214e+76, 2.3505613312828785e+78, 1.3868311854568984e+80,
+    8.32098711274139e+81, 5.075802138772248e+83, 3.146997326038794e+85, 1.98260831540444e+87,
+    1.2688693218588417e+89, 8.247650592082472e+90, 5.443449390774431e+92, 3.647111091818868e+94,
+    2.4800355424368305e+96, 1.711224524281413e+98, 1.1978571669969892e+100, 8.504785885678623e+101,
+    6.1234458376886085e+103, 4.4701154615126844e+105, 3.307885441519386e+107, 2.48091408113954e+109,
+    1.8854947016660504e+111, 1.4518309202828587e+113, 1.1324281178206297e+115, 8.946182130782976e+116,
+    7.156945704626381e+118, 5.797126020747368e+120, 4.753643337012842e+122, 3.945523969720659e+124,
+    3.314240134565353e+126, 2.81710411438055e+128, 2.4227095383672734e+130, 2.107757298379528e+132,
+    1.8548264225739844e+134, 1.650795516090846e+136, 1.4857159644817615e+138, 1.352001527678403e+140,
+    1.2438414054641308e+142, 1.1567725070816416e+144, 1.087366156656743e+146, 1.032997848823906e+148,
+    9.916779348709496e+149, 9.619275968248212e+151, 9.426890448883248e+153, 9.332621544394415e+155,
+    9.332621544394415e+157, 9.42594775983836e+159, 9.614466715035127e+161, 9.90290071648618e+163,
+    1.0299016745145628e+166, 1.081396758240291e+168, 1.1462805637347084e+170, 1.226520203196138e+172,
+    1.324641819451829e+174, 1.4438595832024937e+176, 1.588245541522743e+178, 1.7629525510902446e+180,
+    1.974506857221074e+182, 2.2311927486598138e+184, 2.5435597334721877e+186, 2.925093693493016e+188,
+    3.393108684451898e+190, 3.969937160808721e+192, 4.684525849754291e+194, 5.574585761207606e+196,
+    6.689502913449127e+198, 8.094298525273444e+200, 9.875044200833601e+202, 1.214630436702533e+205,
+    1.506141741511141e+207, 1.882677176888926e+209, 2.372173242880047e+211, 3.0126600184576594e+213,
+    3.856204823625804e+215, 4.974504222477287e+217, 6.466855489220474e+219, 8.47158069087882e+221,
+    1.1182486511960043e+224, 1.4872707060906857e+226, 1.9929427461615188e+228, 2.6904727073180504e+230,
+    3.659042881952549e+232, 5.012888748274992e+234, 6.917786472619489e+236, 9.615723196941089e+238,
+    1.3462012475717526e+241, 1.898143759076171e+243, 2.695364137888163e+245, 3.854370717180073e+247,
+    5.5502938327393044e+249, 8.047926057471992e+251, 1.1749972043909107e+254, 1.727245890454639e+256,
+    2.5563239178728654e+258, 3.80892263763057e+260, 5.713383956445855e+262, 8.62720977423324e+264,
+    1.3113358856834524e+267, 2.0063439050956823e+269, 3.0897696138473508e+271, 4.789142901463394e+273,
+    7.471062926282894e+275, 1.1729568794264145e+278, 1.853271869493735e+280, 2.9467022724950384e+282,
+    4.7147236359920616e+284, 7.590705053947219e+286, 1.2296942187394494e+289, 2.0044015765453026e+291,
+    3.287218585534296e+293, 5.423910666131589e+295, 9.003691705778438e+297, 1.503616514864999e+300,
+    2.5260757449731984e+302, 4.269068009004705e+304, 7.257415615307999e+306
+};
+
+// error element for nPr, nCr and ! that can't be calculated
+struct Element factorial_error(void){
+    struct Element e;
+    e.type = CAL_ELEMENT_ERROR;
+    e.value =0;
+    return e;
+}
+
+struct Element factorial_answer(double value){
+    struct Element e;
+    e.value = value;
+    e.type = NUMBER;
+    return e;
+}
+
+double resolve_factorial(double num){
+    if(num > FACTORIAL_LIMIT) return INFINITY;
+    return FACTORIALS[(int) num];
+}
+
+// n (n-1) ... (n-r+1) one factor at a time while it fits in 64 bits, FALSE when it doesn't
+int exact_permutation(double n, double r, unsigned long long* answer){
+    if(n > EXACT_INTEGER_LIMIT) return FALSE;
+    const unsigned long long top = (unsigned long long) n;
+    unsigned long long value = 1;
+
+    // every factor is at least 2 until the last one so this is at most 64 steps before it overflows
+    for(unsigned long long i = 0; i < (unsigned long long) r; i++){
+        const unsigned long long factor = top - i;
+        if(factor > 1 && value > ULLONG_MAX / factor) return FALSE;
+        value *= factor;
+    }
+    *answer = value;
+    return TRUE;
+}
+
+unsigned long long greatest_common_divisor(unsigned long long a, unsigned long long b){
+    while(b != 0){
+        const unsigned long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// nCr as nC1, nC2 ... one step at a time while it fits in 64 bits, FALSE when it doesn't.
+// Every step is a whole number no bigger than the answer so nothing overflows when the answer fits
+int exact_combinations(double n, double r, unsigned long long* answer){
+    if(n > EXACT_INTEGER_LIMIT) return FALSE;
+    const unsigned long long bottom = (unsigned long long) (n - r);
+    unsigned long long value = 1;
+
+    for(unsigned long long i = 1; i <= (unsigned long long) r; i++){
+        // value * (bottom + i) / i without the multiplication overflowing
+        const unsigned long long divisor = greatest_common_divisor(value, i);
+        const unsigned long long factor = (bottom + i) / (i / divisor);
+        value /= divisor;
+        if(value > ULLONG_MAX / factor) return FALSE;
+        value *= factor;
+    }
+    *answer = value;
+    return TRUE;
+}
+
+// Whole numbers of nPr and nCr. Answers that fit in 64 bits are exact (then rounded to a double),
+// bigger ones come from the tables of factorials, a product of doubles or lgamma for very big n
+int factorial_values(double n1, double r1, double* n, double* r){
+    if(isnan(n1) || isnan(r1)) return FALSE;
+    *n = trunc(n1);
+    *r = trunc(r1);
+    return *n >= 0 && *r >= 0 && *r <= *n && !isinf(*n);
+}
+
+struct Element calculate_permutation(double n1, double r1){
+    double n, r;
+    if(!factorial_values(n1, r1, &n, &r)) return factorial_error();
+
+    unsigned long long exact;
+    if(n <= EXACT_FACTORIAL_LIMIT) return factorial_answer(EXACT_FACTORIALS[(int) n] / EXACT_FACTORIALS[(int) (n - r)]);
+    if(exact_permutation(n, r, &exact)) return factorial_answer((double) exact);
+    if(n <= FACTORIAL_LIMIT) return factorial_answer(FACTORIALS[(int) n] / FACTORIALS[(int) (n - r)]);
+
+    // r! <= nPr so past FACTORIAL_LIMIT it is infinity anyway
+    if(r <= FACTORIAL_LIMIT){
+        double value = 1;
+        for(int i = 0; i < (int) r; i++) value *= n - i;
+        return factorial_answer(value);
+    }
+    return factorial_answer(exp(lgamma(n + 1) - lgamma(n - r + 1)));
+}
+
+struct Element calculate_combinations(double n1, double r1){
+    double n, r;
+    if(!factorial_values(n1, r1, &n, &r)) return factorial_error();
+
+    // nCr is the same as nC(n-r), the smaller one takes less steps
+    if(n - r < r) r = n - r;
+
+    unsigned long long exact;
+    if(n <= EXACT_FACTORIAL_LIMIT){
+        return factorial_answer(EXACT_FACTORIALS[(int) n] / (EXACT_FACTORIALS[(int) r] * EXACT_FACTORIALS[(int) (n - r)]));
+    }
+    if(exact_combinations(n, r, &exact)) return factorial_answer((double) exact);
+    if(n <= FACTORIAL_LIMIT) return factorial_answer(FACTORIALS[(int) n] / (FACTORIALS[(int) r] * FACTORIALS[(int) (n - r)]));
+
+    // nCr >= (n/r)^r >= 2^r so past 1024 steps it is infinity anyway.
+    // Every ratio is at least 1 so the steps only go up and don't overflow before the answer does
+    if(r <= COMBINATIONS_STEP_LIMIT){
+        double value = 1;
+        for(int i = 1; i <= (int) r; i++) value *= (n - r + i) / i;
+        return factorial_answer(value);
+    }
+    return factorial_answer(exp(lgamma(n + 1) - lgamma(r + 1) - lgamma(n - r + 1)));
+}
+
+struct Element calculate_factorial(double num){
+    if(isnan(num) || num < 0) return factorial_error();
+    if(num <= EXACT_FACTORIAL_LIMIT) return factorial_answer((double) EXACT_FACTORIALS[(int) num]);
+    return factorial_answer(resolve_factorial(num));
+}
+
+
+struct Element calculate_negate(double num){
+    struct Element e;
+    e.value = -num;
+    e.type = NUMBER;
+    return e;
+}
+
+
+// counts a pass of calculate_math, does nothing without stats
+static inline void stats_math_pass(struct CalQl8rStats* stats, const struct Expression* expr){
+    if(stats == NULL) return;
+    stats->math_passes++;
+    stats->elements_scanned += expr->array_length;
+}
+
+static inline int stats_math_error(struct CalQl8rStats* stats, int status, char symbol){
+    if(stats != NULL) stats->error_operator = symbol;
+    return status;
+}
+
+// calculate_math is this with 'stats' NULL so after inlining it has no counting left in it
+static inline int calculate_math_passes(struct Expression* expr, struct CalQl8rStats* stats){
+    int status;
+    if(stats != NULL) stats->math_calls++;
+
+    // factorial and nPr and nCr
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_FACTORIAL, FUNCTION_VALUE_DIRECTION_LEFT, calculate_factorial);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_FACTORIAL);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, PERMUTATIONS, calculate_permutation);
+    if(status != CAL_OK) return stats_math_error(stats, status, PERMUTATIONS);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, COMBINATIONS, calculate_combinations);
+    if(status != CAL_OK) return stats_math_error(stats, status, COMBINATIONS);
+
+    // calculate trigonometry
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_SIN, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_sin);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_SIN);
+
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_SINH, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_sinh);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_SINH);
+
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_COS, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_cos);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_COS);
+
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_COSH, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_cosh);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_COSH);
+
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_TAN, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_tan);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_TAN);
+
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_TANH, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_tanh);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_TANH);
+
+    // calculate logarithms
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_LOG10, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_log10);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_LOG10);
+
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_LN, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_ln);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_LN);
+
+    // negative sign in front of brackets and functions e.g -(1+2), -S1
+    stats_math_pass(stats, expr);
+    status = calculate_1_value_expression(expr, OPERATOR_NEGATE, FUNCTION_VALUE_DIRECTION_RIGHT, calculate_negate);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_NEGATE);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_LOGx, calculate_log);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_LOGx);
+
+    // calculate exponents and roots
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_POW, calculate_pow);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_POW);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_ROOT, calculate_root);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_ROOT);
+
+    // calculate basic arithmitic
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_DIVIDE, calculate_divide);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_DIVIDE);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_MULTPILY, calculate_multiply);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_MULTPILY);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_SUBSTRACT, calculate_substract);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_SUBSTRACT);
+
+    stats_math_pass(stats, expr);
+    status = calculate_2_value_expressions(expr, OPERATOR_ADD, calculate_add);
+    if(status != CAL_OK) return stats_math_error(stats, status, OPERATOR_ADD);
+
+    return CAL_OK;
+}
+
+// TRUE when a function or negative sign 'prefix' can come straight after 'before' (an operator, '(' or 0 at the start).
+// A pass only takes a value once it is a plain number so the pass of the prefix has to run first
+// e.g 2^S1 and cS1 work but 2YS1, 5Y--2 and Sc1 are syntax errors
+int can_take_prefix(char before, char prefix){
+    const char* operator = before == 0 ? NULL : strchr(MATH_PASS_ORDER, before);
+    if(operator == NULL) return TRUE;
+    return strchr(MATH_PASS_ORDER, prefix) < operator;
+}
+
+// runs every pass over 'expr' in place, gives CAL_OK or the error of the pass that failed
+int calculate_math(struct Expression* expr){
+    return calculate_math_passes(expr, NULL);
+}
+
+// calculate_math that also counts its passes into 'stats'.
+// Without stats it goes to the copy that has the counting taken out
+int calculate_math_stats(struct Expression* expr, struct CalQl8rStats* stats){
+    if(stats == NULL) return calculate_math_passes(expr, NULL);
+    return calculate_math_passes(expr, stats);
+}
+
+struct CalQl8r* calql8r_create(void){
+    struct CalQl8r* ctx = (struct CalQl8r*) malloc(sizeof (struct CalQl8r));
+    if(ctx == NULL) return NULL;
+    arena_init(&ctx->arena);
+    ctx->tokens.values = NULL;
+    ctx->tokens.types = NULL;
+    ctx->tokens.array_length = 0;
+    ctx->stats = NULL;
+    return ctx;
+}
+
+void calql8r_destroy(struct CalQl8r* ctx){
+    if(ctx == NULL) return;
+    arena_free(&ctx->arena);
+    free(ctx);
+}
+
+size_t calql8r_heap_allocations(const struct CalQl8r* ctx){
+    return ctx->arena.heap_allocations;
+}
+
+const char* calql8r_error_message(int status){
+    switch (status) {
+        case CAL_OK: return "OK";
+        case CAL_ERROR_SYNTAX: return "Syntax Error";
+        case CAL_ERROR_MATH: return "Math Error";
+        case CAL_ERROR_TOO_MANY_VALUES: return "TOO MANY VALUES";
+        case CAL_ERROR_MEMORY: return "Out Of Memory";
+        default: return "Unknown Error";
+    }
+}
+
+// turns the text into number and operator elements in ctx->tokens.
+// Everything from the previous expression in the arena is thrown away first.
+int tokenize_expression(struct CalQl8r* ctx, const char* text, size_t length){
+    ctx->tokens.array_length = 0;
+
+    if(length > INT_MAX) return CAL_ERROR_TOO_MANY_VALUES;
+    arena_reset(&ctx->arena);
+
+    // there can't be more elements than characters
+    ctx->tokens.values = (double *) arena_alloc(&ctx->arena, (length + 1) * sizeof (double));
+    ctx->tokens.types = (char *) arena_alloc(&ctx->arena, length + 1);
+    if(ctx->tokens.values == NULL || ctx->tokens.types == NULL) return CAL_ERROR_MEMORY;
+
+    int status = lex_expression(text, length, &ctx->tokens, (int) length);
+    if(status != CAL_OK) return status;
+    if(ctx->tokens.array_length == 0) return CAL_ERROR_SYNTAX;
+    return CAL_OK;
+}
+
+struct Element any_value(double num){
+    struct Element e;
+    e.value = num;
+    e.type = NUMBER;
+    return e;
+}
+
+struct Element any_values(double num1, double num2){
+    (void) num2;
+    return any_value(num1);
+}
+
+// The passes of calculate_math in the same order with every calculation giving a number, what is left are the
+// errors of elements in the wrong place. Gives the same status as calculate_math for any values
+int calculate_math_order(struct Expression* expr){
+    for(const char* pass = MATH_PASS_ORDER; *pass != '\0'; pass++){
+        int status;
+        if(*pass == OPERATOR_FACTORIAL){
+            status = calculate_1_value_expression(expr, *pass, FUNCTION_VALUE_DIRECTION_LEFT, any_value);
+        } else if(is_function_operator(*pass)){
+            status = calculate_1_value_expression(expr, *pass, FUNCTION_VALUE_DIRECTION_RIGHT, any_value);
+        } else {
+            status = calculate_2_value_expressions(expr, *pass, any_values);
+        }
+        if(status != CAL_OK) return status;
+    }
+    return CAL_OK;
+}
+
+// Calculates every bracket in one pass from left to right. The first closing bracket always belongs
+// to the last open bracket before it so the elements between them have no brackets left in them
+// and are calculated where they are. The elements are compacted as the pass goes and every open
+// bracket keeps where the open bracket before it is in its value so it needs no stack of its own.
+// With 'order_only' the brackets go through calculate_math_order instead of calculate_math.
+static inline int calculate_brackets(struct Expression* expression, struct CalQl8rStats* stats, int order_only){
+    double* values = expression->values;
+    char* types = expression->types;
+    int length = 0;
+    int last_open_bracket = -1;
+
+    for(int i = 0; i < expression->array_length; i++){
+        const char type = types[i];
+        double value = values[i];
+
+        if(type == BRACKET_OPEN){
+            value = last_open_bracket;
+            last_open_bracket = length;
+        } else if(type == BRACKET_CLOSE){
+            // if there are more close brackets than open ones mid-count error
+            if(last_open_bracket == -1) return CAL_ERROR_SYNTAX;
+            if(stats != NULL) stats->bracket_groups++;
+
+            // expression that is found in inner most brackets, calculated where it is
+            struct Expression bracket_expression;
+            bracket_expression.values = values + last_open_bracket + 1;
+            bracket_expression.types = types + last_open_bracket + 1;
+            bracket_expression.array_length = length - last_open_bracket - 1;
+            const int status = order_only ? calculate_math_order(&bracket_expression) : calculate_math_stats(&bracket_expression, stats);
+            if(status != CAL_OK) return status;
+
+            // calculation should only return an array of one element
+            if(bracket_expression.array_length != 1) return CAL_ERROR_MATH;
+
+            // the answer takes the place of the open bracket
+            const int previous_open_bracket = (int) values[last_open_bracket];
+            values[last_open_bracket] = bracket_expression.values[0];
+            types[last_open_bracket] = bracket_expression.types[0];
+            length = last_open_bracket + 1;
+            last_open_bracket = previous_open_bracket;
+            continue;
+        }
+
+        values[length] = value;
+        types[length++] = type;
+    }
+
+    // an open bracket was never closed
+    if(last_open_bracket != -1) return CAL_ERROR_SYNTAX;
+
+    expression->array_length = length;
+    return CAL_OK;
+}
+
+int calculate_all_brackets(struct Expression* expression, struct CalQl8rStats* stats){
+    return calculate_brackets(expression, stats, FALSE);
+}
+
+// The status calql8r_eval gives for the order of the elements, without calculating anything. Only errors of
+// values (e.g 2.5! or 1/0) are left for when it is calculated. The elements are changed in place like calql8r_eval
+int check_expression_order(struct Expression* expression){
+    int status = calculate_brackets(expression, NULL, TRUE);
+    if(status == CAL_OK) status = calculate_math_order(expression);
+    if(status == CAL_OK && (expression->array_length != 1 || expression->types[0] != NUMBER)) status = CAL_ERROR_SYNTAX;
+    return status;
+}
+
+void calql8r_set_stats(struct CalQl8r* ctx, struct CalQl8rStats* stats){
+    ctx->stats = stats;
+}
+
+unsigned long long monotonic_ns(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// ends the stage that started at '*start', the next one starts now
+void stats_stage_time(unsigned long long* stage_ns, unsigned long long* start){
+    const unsigned long long now = monotonic_ns();
+    *stage_ns += now - *start;
+    *start = now;
+}
+
+int stats_error(struct CalQl8rStats* stats, const char* stage, int status){
+    stats->errors++;
+    stats->error_stage = stage;
+    return status;
+}
+
+// calql8r_eval_exact with every stage counted and timed
+int calculate_with_stats(struct CalQl8r* ctx, const char* text, size_t length, double* result, long long* integer, int* exact){
+    struct CalQl8rStats* stats = ctx->stats;
+    stats->expressions++;
+    stats->error_operator = 0;
+    unsigned long long start = monotonic_ns();
+
+    int status = tokenize_expression(ctx, text, length);
+    stats->tokens += ctx->tokens.array_length;
+    stats_stage_time(&stats->lex_ns, &start);
+    if(status != CAL_OK) return stats_error(stats, "lex", status);
+    struct Expression expr = ctx->tokens;
+
+    // the same answers as without stats, whole numbers go through 64 bit integers first
+    const int whole = calculate_integer_expression(ctx, &expr, integer);
+    stats_stage_time(&stats->integer_ns, &start);
+    if(whole){
+        *exact = TRUE;
+        *result = (double) *integer;
+        return CAL_OK;
+    }
+
+    status = calculate_all_brackets(&expr, stats);
+    stats_stage_time(&stats->brackets_ns, &start);
+    if(status != CAL_OK) return stats_error(stats, "brackets", status);
+
+    status = calculate_math_stats(&expr, stats);
+    stats_stage_time(&stats->math_ns, &start);
+    if(status != CAL_OK) return stats_error(stats, "math", status);
+
+    if(expr.array_length != 1 || expr.types[0] != NUMBER) return stats_error(stats, "result", CAL_ERROR_SYNTAX);
+
+    *result = expr.values[0];
+    return CAL_OK;
+}
+
+int calql8r_eval_exact(struct CalQl8r* ctx, const char* text, size_t length, double* result, long long* integer, int* exact){
+    *exact = FALSE;
+    if(ctx->stats != NULL) return calculate_with_stats(ctx, text, length, result, integer, exact);
+
+    int status = tokenize_expression(ctx, text, length);
+    if(status != CAL_OK) return status;
+    struct Expression expr = ctx->tokens;
+
+    // whole numbers with + - * ^ ! Y Z are calculated in 64 bits and only rounded once at the end,
+    // everything else and the ones that overflow are calculated with doubles from the same tokens
+    if(calculate_integer_expression(ctx, &expr, integer)){
+        *exact = TRUE;
+        *result = (double) *integer;
+        return CAL_OK;
+    }
+
+    status = calculate_all_brackets(&expr, NULL);
+    if(status != CAL_OK) return status;
+
+    // final calculation
+    status = calculate_math(&expr);
+    if(status != CAL_OK) return status;
+
+    // the answer should be a single number
+    if(expr.array_length != 1 || expr.types[0] != NUMBER) return CAL_ERROR_SYNTAX;
+
+    *result = expr.values[0];
+    return CAL_OK;
+}
+
+int calql8r_eval(struct CalQl8r* ctx, const char* text, size_t length, double* result){
+    long long integer;
+    int exact;
+    return calql8r_eval_exact(ctx, text, length, result, &integer, &exact);
+}
@@ -0,0 +1,167 @@
+#ifndef CALQL8R_H
+#define CALQL8R_H
+
+#include <stddef.h>
+
+// status codes returned by the library
+#define CAL_OK 0
+#define CAL_ERROR_SYNTAX -1
+#define CAL_ERROR_MATH -2
+#define CAL_ERROR_TOO_MANY_VALUES -3
+#define CAL_ERROR_MEMORY -4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Context that holds the reusable buffers of the calculator.
+// Create one per thread and reuse it for every expression.
+struct CalQl8r;
+
+struct CalQl8r* calql8r_create(void);
+void calql8r_destroy(struct CalQl8r* ctx);
+
+// Calculates 'length' characters of 'text' e.g "1465+225+55.7 + 2r4 + p".
+// The text does not need to be null terminated.
+// Returns CAL_OK and writes the answer into 'result', otherwise one of the CAL_ERROR_* values.
+int calql8r_eval(struct CalQl8r* ctx, const char* text, size_t length, double* result);
+
+// Same as calql8r_eval but expressions of only whole numbers and + - * ^ ! Y Z are calculated in 64 bit
+// integers e.g "3^39+1" gives 4052555153018976268 which a double can't hold. Then 'exact' is 1 and
+// 'integer' has the answer, otherwise (other operators, decimals or a step that doesn't fit) 'exact' is 0
+// and only 'result' has it. 'result' always has the answer as a double.
+// Past 2^53 this can be a different answer than calql8r_compile and calql8r_run give for the same text,
+// programs always calculate with doubles e.g "2^53+1+1" is 9007199254740994 here and 9007199254740992 there.
+int calql8r_eval_exact(struct CalQl8r* ctx, const char* text, size_t length, double* result, long long* integer, int* exact);
+
+// How many times the context has asked the heap for memory in calql8r_eval, calql8r_eval_exact and calql8r_compile.
+// Once the context has seen its biggest expression this stops going up, calculations reuse the same memory.
+// Programs don't have a context so their memory isn't counted here: calql8r_compile mallocs every program,
+// calql8r_run and calql8r_run_gradient malloc a stack only for very deep programs (or a lot of variables)
+// and calql8r_run_columns (when it isn't native code) and calql8r_run_gradient_columns malloc one on every call.
+size_t calql8r_heap_allocations(const struct CalQl8r* ctx);
+
+// What calql8r_eval did, for finding out why an expression is slow or which stage gave an error.
+// Every count is added to what is already in the struct so it can add up over many expressions.
+struct CalQl8rStats{
+    size_t expressions;
+    size_t errors;
+    // elements the text was turned into
+    size_t tokens;
+    // brackets that were calculated
+    size_t bracket_groups;
+    // calculate_math runs, one per bracket and one for the rest, and the passes (one per operator) they made
+    size_t math_calls;
+    size_t math_passes;
+    // elements walked over by the passes, the elements are calculated in place and never copied
+    size_t elements_scanned;
+    // time spent in each stage from a monotonic clock
+    unsigned long long lex_ns;
+    // trying the expression in 64 bit integers (see calql8r_eval_exact), the brackets and math only run when that didn't work
+    unsigned long long integer_ns;
+    unsigned long long brackets_ns;
+    unsigned long long math_ns;
+    // stage of the last error ("lex", "brackets", "math" or "result") and the operator whose pass failed
+    const char* error_stage;
+    char error_operator;
+};
+
+// Counts into 'stats' until it is set back to NULL. Nothing is counted or timed while it is NULL.
+void calql8r_set_stats(struct CalQl8r* ctx, struct CalQl8rStats* stats);
+
+// Expression that has been compiled once into a list of stack instructions
+// so that it can be calculated again and again without reading the text.
+struct CalQl8rProgram;
+
+// Compiles 'length' characters of 'text' into 'program'. Free it with calql8r_program_free.
+int calql8r_compile(struct CalQl8r* ctx, const char* text, size_t length, struct CalQl8rProgram** program);
+
+// Calculates a compiled program. Safe to call from many threads on the same program.
+int calql8r_run(const struct CalQl8rProgram* program, double* result);
+
+void calql8r_program_free(struct CalQl8rProgram* program);
+
+// Programs are compiled from an expression tree where constants are already calculated (2r4, S(p/2), 6!),
+// parts that appear more than once are only calculated once and x*1, x/1, x^1, x-0 and x*-1 are simplified.
+// Writes the instructions that are left into 'buffer' in postfix order like snprintf and gives their length.
+// A value kept for later is shown as =t0 and used again as t0, ~ is a negative sign.
+// e.g "2r4 + S(p/2) * x + S(p/2) * y" is "2 x + y +" and "S(x*2) + S(x*2)" is "x 2 * S =t0 t0 +"
+int calql8r_program_dump(const struct CalQl8rProgram* program, char* buffer, size_t size);
+
+// Formulas can use variables e.g "S x * 2 + y". Names are letters, digits and '_'
+// (not starting with a digit) without the letters used for operators and constants.
+// Every variable of a program has an index starting from 0 in the order they first appear.
+int calql8r_program_variables(const struct CalQl8rProgram* program);
+const char* calql8r_program_variable(const struct CalQl8rProgram* program, int index);
+int calql8r_program_variable_index(const struct CalQl8rProgram* program, const char* name);
+
+// Calculates the program for every row of the variable columns, 'columns[i]' holds 'rows' values
+// of variable i. The operators work on blocks of rows at a time so the compiler can vectorize them.
+// Rows that can't be calculated (e.g divide by zero) get NAN in 'results'.
+int calql8r_run_columns(const struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results);
+
+// Calculates the program and its derivative for every variable in the same pass (forward mode with dual numbers).
+// 'variables[i]' is the value of variable i and 'gradient[i]' gets the derivative for it. The answer is exactly what
+// calql8r_run_columns gives for the same row. nPr, nCr and ! only change at whole numbers so their derivative is 0.
+int calql8r_run_gradient(const struct CalQl8rProgram* program, const double* variables, double* result, double* gradient);
+
+// calql8r_run_gradient for every row of the columns, 'gradients[i]' gets 'rows' derivatives for variable i.
+// Like calql8r_run_columns it works through blocks of rows, rows that can't be calculated get NAN everywhere.
+int calql8r_run_gradient_columns(const struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results, double* const* gradients);
+
+// Once calql8r_run_columns has calculated 10000 rows of a program it is compiled into native x86-64 code
+// that goes over the rows without the interpreter, the answers stay exactly the same.
+// On other machines (or built with -DCALQL8R_NO_JIT) programs are always interpreted.
+// Compiles the program now instead of waiting, gives 1 when it runs as native code and 0 when it can't
+int calql8r_program_jit(struct CalQl8rProgram* program);
+
+// Cache of answers in front of calql8r_eval for traffic where the same expressions come again and again.
+// Expressions are looked up with their whitespace removed so "1 + 1" and "1+1" share an answer.
+// It holds at most 'max_entries' expressions using at most 'max_bytes' of text and makes room
+// by throwing out expressions that haven't been used since the last time it went around (CLOCK).
+// Like the context, use one per thread.
+struct CalQl8rCache;
+
+struct CalQl8rCacheStats{
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+struct CalQl8rCache* calql8r_cache_create(size_t max_entries, size_t max_bytes);
+void calql8r_cache_destroy(struct CalQl8rCache* cache);
+
+// Same as calql8r_eval but answers (and errors) of expressions seen before come from the cache
+int calql8r_cache_eval(struct CalQl8rCache* cache, struct CalQl8r* ctx, const char* text, size_t length, double* result);
+struct CalQl8rCacheStats calql8r_cache_stats(const struct CalQl8rCache* cache);
+
+// Expression that is edited a little at a time e.g in an editor that shows the answer on every keystroke.
+// Only the elements around an edit are read again and only the brackets (and the parts of them between
+// + - * / r ^ l) that have an edit in them are calculated again, the rest keep their answers from before.
+// The answers are exactly what calql8r_eval_exact gives for the same text. Like the context, use one per thread.
+struct CalQl8rSession;
+
+struct CalQl8rSession* calql8r_session_create(void);
+void calql8r_session_destroy(struct CalQl8rSession* session);
+
+// Puts 'length' characters of 'text' at 'offset' or takes 'length' characters away from 'offset',
+// an offset past the end of the text is the end
+int calql8r_session_insert(struct CalQl8rSession* session, size_t offset, const char* text, size_t length);
+int calql8r_session_delete(struct CalQl8rSession* session, size_t offset, size_t length);
+
+// the text after the edits, it is not null terminated
+const char* calql8r_session_text(const struct CalQl8rSession* session, size_t* length);
+
+// Same as calql8r_eval_exact on the text of the session
+int calql8r_session_eval(struct CalQl8rSession* session, double* result, long long* integer, int* exact);
+
+// Readable message for a status code e.g "Syntax Error"
+const char* calql8r_error_message(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include "calql8r_internal.h"
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_CAPACITY 4096
+
+// keep the memory after the block header aligned
+#define ARENA_HEADER_SIZE (((sizeof (struct ArenaBlock)) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct ArenaBlock* arena_new_block(struct Arena* arena, size_t capacity, struct ArenaBlock* previous){
+    struct ArenaBlock* block = (struct ArenaBlock*) malloc(ARENA_HEADER_SIZE + capacity);
+    if(block == NULL) return NULL;
+    arena->heap_allocations++;
+    block->previous = previous;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+void arena_init(struct Arena* arena){
+    arena->block = NULL;
+    arena->heap_allocations = 0;
+}
+
+void* arena_alloc(struct Arena* arena, size_t size){
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    struct ArenaBlock* block = arena->block;
+    if(block == NULL || block->capacity - block->used < size){
+        // add a block at least double the size of the last one
+        size_t capacity = block == NULL ? ARENA_MIN_CAPACITY : block->capacity * 2;
+        if(capacity < size) capacity = size;
+
+        block = arena_new_block(arena, capacity, arena->block);
+        if(block == NULL) return NULL;
+        arena->block = block;
+    }
+
+    void* memory = (char *) block + ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+    return memory;
+}
+
+// throws everything away, the memory stays for the next calculation
+void arena_reset(struct Arena* arena){
+    struct ArenaBlock* block = arena->block;
+    if(block == NULL) return;
+
+    if(block->previous == NULL){
+        block->used = 0;
+        return;
+    }
+
+    // the last calculation needed more than one block, swap them for one that fits everything
+    size_t capacity = 0;
+    while(block != NULL){
+        struct ArenaBlock* previous = block->previous;
+        capacity += block->capacity;
+        free(block);
+        block = previous;
+    }
+    arena->block = arena_new_block(arena, capacity, NULL);
+}
+
+void arena_free(struct Arena* arena){
+    struct ArenaBlock* block = arena->block;
+    while(block != NULL){
+        struct ArenaBlock* previous = block->previous;
+        free(block);
+        block = previous;
+    }
+    arena->block = NULL;
+}
@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+#define CACHE_EMPTY 0
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+struct CacheEntry{
+    uint64_t hash;
+    char* key;
+    size_t key_length;
+    double result;
+    int status;
+    unsigned char referenced;
+};
+
+// Open addressing with linear probing, 'capacity' is a power of two at least double 'max_entries'
+// so the runs stay short. Removing an entry shifts the entries behind it back so no tombstones are needed.
+struct CalQl8rCache{
+    struct CacheEntry* entries;
+    size_t mask;
+    size_t max_entries;
+    size_t max_bytes;
+    size_t clock_hand;
+    char* scratch;
+    size_t scratch_capacity;
+    struct CalQl8rCacheStats stats;
+};
+
+// https://www.youtube.com/watch?v=LscgaBzlGdE
+// copies the non whitespace characters of 'text' into 'list' and returns how many there are
+size_t trim_whitespaces(const char* text, size_t length, char* list){
+    size_t j = 0;
+    for(size_t i = 0; i < length; i++) {
+        char c = *(text + i);
+
+        // assign value to point
+        if(!is_whitespace(c)) *(list + j++) = c;
+    }
+    return j;
+}
+
+uint64_t hash_text(const char* text, size_t length){
+    uint64_t hash = FNV_OFFSET;
+    for(size_t i = 0; i < length; i++){
+        hash ^= (unsigned char) text[i];
+        hash *= FNV_PRIME;
+    }
+    return hash == CACHE_EMPTY ? 1 : hash;
+}
+
+struct CalQl8rCache* calql8r_cache_create(size_t max_entries, size_t max_bytes){
+    if(max_entries == 0) max_entries = 1;
+    size_t capacity = 2;
+    while(capacity < max_entries * 2) capacity *= 2;
+
+    struct CalQl8rCache* cache = (struct CalQl8rCache*) calloc(1, sizeof (struct CalQl8rCache));
+    if(cache == NULL) return NULL;
+    cache->entries = (struct CacheEntry*) calloc(capacity, sizeof (struct CacheEntry));
+    if(cache->entries == NULL){
+        free(cache);
+        return NULL;
+    }
+    cache->mask = capacity - 1;
+    cache->max_entries = max_entries;
+    cache->max_bytes = max_bytes;
+    return cache;
+}
+
+void calql8r_cache_destroy(struct CalQl8rCache* cache){
+    if(cache == NULL) return;
+    for(size_t i = 0; i <= cache->mask; i++) free(cache->entries[i].key);
+    free(cache->entries);
+    free(cache->scratch);
+    free(cache);
+}
+
+struct CalQl8rCacheStats calql8r_cache_stats(const struct CalQl8rCache* cache){
+    return cache->stats;
+}
+
+void cache_remove(struct CalQl8rCache* cache, size_t slot){
+    struct CacheEntry* entries = cache->entries;
+    cache->stats.entries--;
+    cache->stats.bytes -= entries[slot].key_length;
+    free(entries[slot].key);
+
+    // move back every entry after it that would not be found anymore with the gap
+    size_t next = slot;
+    for(;;){
+        next = (next + 1) & cache->mask;
+        if(entries[next].hash == CACHE_EMPTY) break;
+
+        size_t home = entries[next].hash & cache->mask;
+        if(((next - home) & cache->mask) >= ((next - slot) & cache->mask)){
+            entries[slot] = entries[next];
+            slot = next;
+        }
+    }
+    entries[slot].hash = CACHE_EMPTY;
+    entries[slot].key = NULL;
+    entries[slot].key_length = 0;
+}
+
+// CLOCK: go round the slots giving every used entry a second chance
+void cache_evict(struct CalQl8rCache* cache){
+    for(;;){
+        size_t slot = cache->clock_hand;
+        struct CacheEntry* entry = &cache->entries[slot];
+        cache->clock_hand = (slot + 1) & cache->mask;
+
+        if(entry->hash == CACHE_EMPTY) continue;
+        if(entry->referenced){
+            entry->referenced = 0;
+            continue;
+        }
+        cache_remove(cache, slot);
+        cache->stats.evictions++;
+        return;
+    }
+}
+
+void cache_insert(struct CalQl8rCache* cache, uint64_t hash, const char* key, size_t key_length, int status, double result){
+    // too big to ever fit
+    if(key_length > cache->max_bytes) return;
+
+    while(cache->stats.entries >= cache->max_entries || cache->stats.bytes + key_length > cache->max_bytes) cache_evict(cache);
+
+    char* copy = (char *) malloc(key_length > 0 ? key_length : 1);
+    if(copy == NULL) return;
+    memcpy(copy, key, key_length);
+
+    size_t slot = hash & cache->mask;
+    while(cache->entries[slot].hash != CACHE_EMPTY) slot = (slot + 1) & cache->mask;
+
+    struct CacheEntry* entry = &cache->entries[slot];
+    entry->hash = hash;
+    entry->key = copy;
+    entry->key_length = key_length;
+    entry->result = result;
+    entry->status = status;
+    entry->referenced = 0;
+    cache->stats.entries++;
+    cache->stats.bytes += key_length;
+}
+
+int calql8r_cache_eval(struct CalQl8rCache* cache, struct CalQl8r* ctx, const char* text, size_t length, double* result){
+    if(cache->scratch_capacity < length){
+        char* scratch = (char *) realloc(cache->scratch, length);
+        if(scratch == NULL) return CAL_ERROR_MEMORY;
+        cache->scratch = scratch;
+        cache->scratch_capacity = length;
+    }
+
+    const size_t key_length = trim_whitespaces(text, length, cache->scratch);
+    const uint64_t hash = hash_text(cache->scratch, key_length);
+
+    size_t slot = hash & cache->mask;
+    while(cache->entries[slot].hash != CACHE_EMPTY){
+        struct CacheEntry* entry = &cache->entries[slot];
+        if(entry->hash == hash && entry->key_length == key_length && memcmp(entry->key, cache->scratch, key_length) == 0){
+            cache->stats.hits++;
+            entry->referenced = 1;
+            if(entry->status == CAL_OK) *result = entry->result;
+            return entry->status;
+        }
+        slot = (slot + 1) & cache->mask;
+    }
+
+    cache->stats.misses++;
+    double answer = 0;
+    int status = calql8r_eval(ctx, cache->scratch, key_length, &answer);
+
+    // running out of memory isn't an answer of the expression
+    if(status != CAL_ERROR_MEMORY) cache_insert(cache, hash, cache->scratch, key_length, status, answer);
+    if(status == CAL_OK) *result = answer;
+    return status;
+}
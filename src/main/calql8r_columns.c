@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+// rows worked on at a time, a few blocks of the stack still fit in the L1 cache
+#define COLUMN_BLOCK_SIZE 512
+
+// Every operator of calculate_math over a block of values. 'a' is the value on the left
+// and gets the answer. The loops have no early exits so they can be vectorized, rows where
+// calculate_math would give an error are marked in 'errors' and come out as NAN at the end.
+
+void column_fill(double* restrict a, double value, int n){
+    for(int i = 0; i < n; i++) a[i] = value;
+}
+
+void column_add(double* restrict a, const double* restrict b, int n){
+    for(int i = 0; i < n; i++) a[i] += b[i];
+}
+
+void column_substract(double* restrict a, const double* restrict b, int n){
+    for(int i = 0; i < n; i++) a[i] -= b[i];
+}
+
+void column_multiply(double* restrict a, const double* restrict b, int n){
+    for(int i = 0; i < n; i++) a[i] *= b[i];
+}
+
+void column_divide(double* restrict a, const double* restrict b, unsigned char* restrict errors, int n){
+    for(int i = 0; i < n; i++){
+        errors[i] |= b[i] == 0;
+        a[i] /= b[i];
+    }
+}
+
+void column_pow(double* restrict a, const double* restrict b, int n){
+    for(int i = 0; i < n; i++) a[i] = pow(a[i], b[i]);
+}
+
+void column_root(double* restrict a, const double* restrict b, unsigned char* restrict errors, int n){
+    for(int i = 0; i < n; i++){
+        errors[i] |= a[i] <= 0;
+        a[i] = pow(b[i], 1 / a[i]);
+    }
+}
+
+void column_log(double* restrict a, const double* restrict b, unsigned char* restrict errors, int n){
+    for(int i = 0; i < n; i++){
+        errors[i] |= (a[i] <= 0) | (b[i] <= 0);
+        a[i] = log(b[i]) / log(a[i]);
+    }
+}
+
+void column_negate(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = -a[i];
+}
+
+void column_sin(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = sin(a[i]);
+}
+
+void column_sinh(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = sinh(a[i]);
+}
+
+void column_cos(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = cos(a[i]);
+}
+
+void column_cosh(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = cosh(a[i]);
+}
+
+void column_tan(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = tan(a[i]);
+}
+
+void column_tanh(double* restrict a, int n){
+    for(int i = 0; i < n; i++) a[i] = tanh(a[i]);
+}
+
+void column_log10(double* restrict a, unsigned char* restrict errors, int n){
+    for(int i = 0; i < n; i++){
+        errors[i] |= a[i] <= 0;
+        a[i] = log10(a[i]);
+    }
+}
+
+void column_ln(double* restrict a, unsigned char* restrict errors, int n){
+    for(int i = 0; i < n; i++){
+        errors[i] |= a[i] <= 0;
+        a[i] = log(a[i]);
+    }
+}
+
+// factorials, nPr and nCr aren't worth vectorizing, they go through calculate_math's functions
+void column_2_values(double* restrict a, const double* restrict b, unsigned char* restrict errors, int n, struct Element (*callbackFunction) (double, double)){
+    for(int i = 0; i < n; i++){
+        struct Element ele = callbackFunction(a[i], b[i]);
+        errors[i] |= ele.type == CAL_ELEMENT_ERROR;
+        a[i] = ele.value;
+    }
+}
+
+void column_1_value(double* restrict a, unsigned char* restrict errors, int n, struct Element (*callbackFunction) (double)){
+    for(int i = 0; i < n; i++){
+        struct Element ele = callbackFunction(a[i]);
+        errors[i] |= ele.type == CAL_ELEMENT_ERROR;
+        a[i] = ele.value;
+    }
+}
+
+// applies operator 'type' to the blocks, 'b' is only used by the operators with two values
+int column_operator(char type, double* restrict a, const double* restrict b, unsigned char* restrict errors, int n){
+    switch (type) {
+        case OPERATOR_ADD: column_add(a, b, n); break;
+        case OPERATOR_SUBSTRACT: column_substract(a, b, n); break;
+        case OPERATOR_MULTPILY: column_multiply(a, b, n); break;
+        case OPERATOR_DIVIDE: column_divide(a, b, errors, n); break;
+        case OPERATOR_POW: column_pow(a, b, n); break;
+        case OPERATOR_ROOT: column_root(a, b, errors, n); break;
+        case OPERATOR_LOGx: column_log(a, b, errors, n); break;
+        case PERMUTATIONS: column_2_values(a, b, errors, n, calculate_permutation); break;
+        case COMBINATIONS: column_2_values(a, b, errors, n, calculate_combinations); break;
+        case OPERATOR_FACTORIAL: column_1_value(a, errors, n, calculate_factorial); break;
+        case OPERATOR_NEGATE: column_negate(a, n); break;
+        case OPERATOR_SIN: column_sin(a, n); break;
+        case OPERATOR_SINH: column_sinh(a, n); break;
+        case OPERATOR_COS: column_cos(a, n); break;
+        case OPERATOR_COSH: column_cosh(a, n); break;
+        case OPERATOR_TAN: column_tan(a, n); break;
+        case OPERATOR_TANH: column_tanh(a, n); break;
+        case OPERATOR_LOG10: column_log10(a, errors, n); break;
+        case OPERATOR_LN: column_ln(a, errors, n); break;
+        default: return CAL_ERROR_SYNTAX;
+    }
+    return CAL_OK;
+}
+
+// runs the program over rows [row, row + n) with one block of 'stack' per stack value and then per slot
+int run_program_block(const struct CalQl8rProgram* program, const double* const* columns, size_t row, int n, double* stack, unsigned char* errors){
+    int top = 0;
+    memset(errors, 0, n);
+    const double* constant = program->constants;
+    double* slots = stack + program->stack_size * COLUMN_BLOCK_SIZE;
+
+    for(int i = 0; i < program->code_length; i++){
+        const char c = program->code[i];
+        if(c == NUMBER){
+            column_fill(stack + top++ * COLUMN_BLOCK_SIZE, *constant++, n);
+            continue;
+        }
+        if(c == VARIABLE){
+            memcpy(stack + top++ * COLUMN_BLOCK_SIZE, columns[(int) *constant++] + row, n * sizeof (double));
+            continue;
+        }
+        if(c == SLOT_STORE){
+            memcpy(slots + (int) *constant++ * COLUMN_BLOCK_SIZE, stack + (top - 1) * COLUMN_BLOCK_SIZE, n * sizeof (double));
+            continue;
+        }
+        if(c == SLOT_LOAD){
+            memcpy(stack + top++ * COLUMN_BLOCK_SIZE, slots + (int) *constant++ * COLUMN_BLOCK_SIZE, n * sizeof (double));
+            continue;
+        }
+
+        // two value operators pop the right value first
+        if(c != OPERATOR_FACTORIAL && !is_function_operator(c)) top--;
+        if(column_operator(c, stack + (top - 1) * COLUMN_BLOCK_SIZE, stack + top * COLUMN_BLOCK_SIZE, errors, n) != CAL_OK) return CAL_ERROR_SYNTAX;
+    }
+    return CAL_OK;
+}
+
+int calql8r_run_columns(const struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results){
+    // the counts and native code change, the program itself doesn't
+    if(jit_run_columns((struct CalQl8rProgram *) program, columns, rows, results)) return CAL_OK;
+    return run_columns_interpreted(program, columns, rows, results);
+}
+
+int run_columns_interpreted(const struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results){
+    const int blocks = program->stack_size + program->slots_length;
+    double* stack = (double *) malloc(sizeof (double) * COLUMN_BLOCK_SIZE * (blocks > 0 ? blocks : 1));
+    if(stack == NULL) return CAL_ERROR_MEMORY;
+
+    unsigned char errors[COLUMN_BLOCK_SIZE];
+    int status = CAL_OK;
+    for(size_t row = 0; row < rows && status == CAL_OK; row += COLUMN_BLOCK_SIZE){
+        const int n = rows - row < COLUMN_BLOCK_SIZE ? (int) (rows - row) : COLUMN_BLOCK_SIZE;
+        status = run_program_block(program, columns, row, n, stack, errors);
+        for(int i = 0; i < n; i++) results[row + i] = errors[i] ? NAN : stack[i];
+    }
+
+    free(stack);
+    return status;
+}
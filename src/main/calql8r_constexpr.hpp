@@ -0,0 +1,915 @@
+#ifndef CALQL8R_CONSTEXPR_HPP
+#define CALQL8R_CONSTEXPR_HPP
+
+// Header only C++20 version of calql8r_eval_exact for expressions that never change e.g
+//
+//     constexpr double area = calql8r::constant("p*2.5^2");
+//     static_assert(calql8r::evaluate("5Z2").integer == 10);
+//
+// Same grammar, same steps and same answers as the library: the tokens are read the same way,
+// whole numbers go through 64 bit integers first and everything else through the same passes
+// (! Y Z, functions, negative signs, l ^ r / * - +) with brackets calculated from the inside out.
+// Numbers are rounded to the closest double like calql8r_number.c does. With GCC the math functions
+// are its builtins, which it calculates while compiling. Other compilers can't do that yet, there
+// S s C c T t L E l r and ^ (unless the answer is a whole number) only work outside constant expressions.
+// A step that overflows to infinity (1e300*1e300) isn't a constant either, the compiler stops there.
+// Variables aren't supported, they are a syntax error like in calql8r_eval.
+
+#include <array>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <string_view>
+#include <vector>
+#include "calql8r.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define CALQL8R_CONSTANT_MATH 1
+#else
+#define CALQL8R_CONSTANT_MATH 0
+#endif
+
+namespace calql8r {
+
+// 'exact' is true when the answer came from 64 bit integers, then 'integer' has it like calql8r_eval_exact
+struct Answer{
+    int status;
+    double value;
+    bool exact;
+    long long integer;
+};
+
+namespace detail {
+
+// the element types of calql8r_internal.h
+inline constexpr char NUMBER = 'N';
+inline constexpr char NUMBER_REMOVE = 'M';
+inline constexpr char VARIABLE = 'V';
+inline constexpr char ELEMENT_ERROR = '_';
+inline constexpr char OPERATOR_NEGATE = '~';
+inline constexpr char DECIMAL_POINT = '.';
+inline constexpr char EXPONENT = 'e';
+inline constexpr char PI = 'p';
+inline constexpr char BRACKET_OPEN = '(';
+inline constexpr char BRACKET_CLOSE = ')';
+inline constexpr std::string_view RESERVED_LETTERS = "SsCcTtLElrpYZe";
+
+inline constexpr int EXACT_FACTORIAL_LIMIT = 20;
+inline constexpr int FACTORIAL_LIMIT = 170;
+inline constexpr double EXACT_INTEGER_LIMIT = 9007199254740992.0;
+inline constexpr int COMBINATIONS_STEP_LIMIT = 1024;
+inline constexpr double INF = std::numeric_limits<double>::infinity();
+
+// numbers keep their first 800 significant digits and whether any after them isn't 0
+inline constexpr int SIGNIFICANT_DIGITS = 800;
+inline constexpr long long EXPONENT_LIMIT = 1000000000LL;
+
+struct Element{
+    double value;
+    char type;
+    // where the open bracket before an open bracket is, see calculate_all_brackets
+    int previous_open;
+};
+
+// part of the elements that is calculated where it is, like struct Expression
+struct Expression{
+    Element* elements;
+    int length;
+    int error;
+};
+
+// math that is the same as libm, see CALQL8R_CONSTANT_MATH. Without the builtins only the answers
+// that don't need libm are constant
+#if CALQL8R_CONSTANT_MATH
+constexpr double math_sin(double x){ return __builtin_sin(x); }
+constexpr double math_sinh(double x){ return __builtin_sinh(x); }
+constexpr double math_cos(double x){ return __builtin_cos(x); }
+constexpr double math_cosh(double x){ return __builtin_cosh(x); }
+constexpr double math_tan(double x){ return __builtin_tan(x); }
+constexpr double math_tanh(double x){ return __builtin_tanh(x); }
+constexpr double math_log(double x){ return __builtin_log(x); }
+constexpr double math_log10(double x){ return __builtin_log10(x); }
+constexpr double math_exp(double x){ return __builtin_exp(x); }
+constexpr double math_pow(double x, double y){ return __builtin_pow(x, y); }
+#else
+constexpr double math_sin(double x){ return x == 0 || x != x ? x : std::sin(x); }
+constexpr double math_sinh(double x){ return x == 0 || x != x ? x : std::sinh(x); }
+constexpr double math_cos(double x){ return x == 0 ? 1.0 : std::cos(x); }
+constexpr double math_cosh(double x){ return x == 0 ? 1.0 : std::cosh(x); }
+constexpr double math_tan(double x){ return x == 0 || x != x ? x : std::tan(x); }
+constexpr double math_tanh(double x){ return x == 0 || x != x ? x : std::tanh(x); }
+constexpr double math_log(double x){ return x == 1 ? 0.0 : std::log(x); }
+constexpr double math_log10(double x){ return x == 1 ? 0.0 : std::log10(x); }
+constexpr double math_exp(double x){ return x == 0 ? 1.0 : std::exp(x); }
+constexpr double math_pow(double x, double y){ return y == 0 ? 1.0 : y == 1 ? x : std::pow(x, y); }
+#endif
+
+// no compiler calculates lgamma while compiling so nPr and nCr past the tables and the steps (e.g 1e20Y200)
+// are never constant
+inline double math_lgamma(double x){ return std::lgamma(x); }
+
+constexpr bool is_nan(double x){ return x != x; }
+constexpr bool is_inf(double x){ return x == INF || x == -INF; }
+constexpr double absolute(double x){ return x < 0 ? -x : x; }
+
+constexpr double truncate(double x){
+    // past 2^52 every double is already whole
+    if(is_nan(x) || absolute(x) >= 4503599627370496.0) return x;
+    // -0.5 gives 0 instead of -0, nothing here looks at the sign of 0
+    return (double) (long long) x;
+}
+
+// whole number of up to 4096 bits with the lowest 32 bits first, enough for every number the parser
+// has to round and for 170!
+struct Big{
+    std::array<std::uint32_t, 128> limbs{};
+    int length = 0;
+};
+
+constexpr void big_multiply_add(Big& big, std::uint32_t factor, std::uint32_t add){
+    std::uint64_t carry = add;
+    for(int i = 0; i < big.length; i++){
+        const std::uint64_t product = (std::uint64_t) big.limbs[i] * factor + carry;
+        big.limbs[i] = (std::uint32_t) product;
+        carry = product >> 32;
+    }
+    if(carry != 0) big.limbs[big.length++] = (std::uint32_t) carry;
+}
+
+constexpr int big_bits(const Big& big){
+    if(big.length == 0) return 0;
+    return big.length * 32 - std::countl_zero(big.limbs[big.length - 1]);
+}
+
+constexpr Big big_shift_left(const Big& big, int bits){
+    Big shifted;
+    if(big.length == 0) return shifted;
+    const int limbs = bits / 32;
+    const int rest = bits % 32;
+    for(int i = big.length - 1; i >= 0; i--){
+        const std::uint64_t moved = (std::uint64_t) big.limbs[i] << rest;
+        shifted.limbs[i + limbs + 1] |= (std::uint32_t) (moved >> 32);
+        shifted.limbs[i + limbs] |= (std::uint32_t) moved;
+    }
+    shifted.length = big.length + limbs + 1;
+    while(shifted.length > 0 && shifted.limbs[shifted.length - 1] == 0) shifted.length--;
+    return shifted;
+}
+
+constexpr int big_compare(const Big& a, const Big& b){
+    if(a.length != b.length) return a.length < b.length ? -1 : 1;
+    for(int i = a.length - 1; i >= 0; i--){
+        if(a.limbs[i] != b.limbs[i]) return a.limbs[i] < b.limbs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// a - b where a >= b
+constexpr void big_subtract(Big& a, const Big& b){
+    std::int64_t borrow = 0;
+    for(int i = 0; i < a.length; i++){
+        std::int64_t difference = (std::int64_t) a.limbs[i] - (i < b.length ? b.limbs[i] : 0) - borrow;
+        borrow = difference < 0;
+        if(borrow) difference += (std::int64_t) 1 << 32;
+        a.limbs[i] = (std::uint32_t) difference;
+    }
+    while(a.length > 0 && a.limbs[a.length - 1] == 0) a.length--;
+}
+
+// top * 2^exponent rounded to the closest double (ties to even), the highest bit of 'top' is set and
+// 'sticky' is true when the value is a bit more than that
+constexpr double round_to_double(std::uint64_t top, bool sticky, int exponent){
+    const int highest = exponent + 63;
+    if(highest > 1023) return INF;
+
+    // subnormals keep less bits
+    int shift = 11;
+    if(highest < -1022) shift += -1022 - highest;
+    if(shift > 64) return 0.0;
+
+    std::uint64_t mantissa = shift == 64 ? 0 : top >> shift;
+    const std::uint64_t rest = shift == 64 ? top : top & ((std::uint64_t(1) << shift) - 1);
+    const std::uint64_t half = std::uint64_t(1) << (shift - 1);
+    if(rest > half || (rest == half && (sticky || (mantissa & 1)))) mantissa++;
+
+    // the 53rd bit of a normal number is the exponent, a carry out of it moves the exponent up by itself
+    std::uint64_t bits = mantissa;
+    if(highest >= -1022) bits = ((std::uint64_t) (highest + 1023) << 52) + mantissa - (std::uint64_t(1) << 52);
+    return std::bit_cast<double>(bits);
+}
+
+constexpr double big_to_double(const Big& big){
+    const int bits = big_bits(big);
+    if(bits == 0) return 0.0;
+    if(bits <= 64){
+        std::uint64_t value = 0;
+        for(int i = big.length - 1; i >= 0; i--) value = (value << 32) | big.limbs[i];
+        return round_to_double(value << (64 - bits), false, bits - 64);
+    }
+
+    // the top 64 bits, everything under them only decides 'sticky'
+    std::uint64_t top = 0;
+    bool sticky = false;
+    for(int bit = bits - 1; bit >= 0; bit--){
+        const bool set = (big.limbs[bit / 32] >> (bit % 32)) & 1;
+        if(bit >= bits - 64) top = (top << 1) | set;
+        else if(set){
+            sticky = true;
+            break;
+        }
+    }
+    return round_to_double(top, sticky, bits - 64);
+}
+
+// mantissa / 10^power rounded to the closest double
+constexpr double big_divide_to_double(const Big& mantissa, int power){
+    Big divisor;
+    divisor.limbs[0] = 1;
+    divisor.length = 1;
+    for(int i = 0; i < power; i++) big_multiply_add(divisor, 10, 0);
+
+    // one of them is shifted so the quotient has 64 bits, the remainder is the sticky bit
+    for(int extra = 0; extra < 2; extra++){
+        const int shift = big_bits(divisor) + 63 + extra - big_bits(mantissa);
+        Big remainder = shift > 0 ? big_shift_left(mantissa, shift) : mantissa;
+        const Big shifted = shift < 0 ? big_shift_left(divisor, -shift) : divisor;
+        std::uint64_t quotient = 0;
+        for(int bit = big_bits(remainder) - big_bits(shifted); bit >= 0; bit--){
+            const Big part = big_shift_left(shifted, bit);
+            if(big_compare(remainder, part) >= 0){
+                big_subtract(remainder, part);
+                quotient |= std::uint64_t(1) << bit;
+            }
+        }
+        if(quotient >> 63) return round_to_double(quotient, remainder.length != 0, -shift);
+    }
+    return 0.0;
+}
+
+// n! rounded to the closest double for every n up to FACTORIAL_LIMIT, the FACTORIALS table of calql8r.c
+constexpr std::array<double, FACTORIAL_LIMIT + 1> make_factorials(){
+    std::array<double, FACTORIAL_LIMIT + 1> factorials{};
+    Big big;
+    big.limbs[0] = 1;
+    big.length = 1;
+    for(int n = 0; n <= FACTORIAL_LIMIT; n++){
+        if(n > 1) big_multiply_add(big, (std::uint32_t) n, 0);
+        factorials[n] = big_to_double(big);
+    }
+    return factorials;
+}
+
+inline constexpr std::array<double, FACTORIAL_LIMIT + 1> FACTORIALS = make_factorials();
+
+constexpr unsigned long long exact_factorial(int n){
+    unsigned long long value = 1;
+    for(int i = 2; i <= n; i++) value *= (unsigned long long) i;
+    return value;
+}
+
+constexpr bool is_whitespace(char c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+constexpr bool is_digit(char c){
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool is_variable_character(char c, bool first){
+    if(c == '_') return true;
+    if(!first && is_digit(c)) return true;
+    if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) return false;
+    return RESERVED_LETTERS.find(c) == std::string_view::npos;
+}
+
+// the digits of a number, like struct Decimal but with all of the significant digits
+struct Decimal{
+    Big mantissa;
+    int digits = 0;
+    long long exponent = 0;
+    bool sticky = false;
+};
+
+constexpr void add_digit(Decimal& decimal, char c, bool fraction){
+    if(decimal.digits == 0 && c == '0'){
+        if(fraction) decimal.exponent--;
+        return;
+    }
+    if(decimal.digits < SIGNIFICANT_DIGITS){
+        big_multiply_add(decimal.mantissa, 10, (std::uint32_t) (c - '0'));
+        decimal.digits++;
+        if(fraction) decimal.exponent--;
+    } else {
+        if(c != '0') decimal.sticky = true;
+        if(!fraction) decimal.exponent++;
+    }
+}
+
+constexpr int read_digits(std::string_view text, std::size_t& i, Decimal& decimal, bool fraction){
+    int count = 0;
+    for(; i < text.size(); i++){
+        const char c = text[i];
+        if(is_digit(c)){
+            add_digit(decimal, c, fraction);
+            count++;
+        } else if(!is_whitespace(c)){
+            break;
+        }
+    }
+    return count;
+}
+
+constexpr long long read_exponent(std::string_view text, std::size_t& i){
+    std::size_t next = i + 1;
+    while(next < text.size() && is_whitespace(text[next])) next++;
+
+    bool negative = false;
+    if(next < text.size() && (text[next] == '+' || text[next] == '-')){
+        negative = text[next] == '-';
+        next++;
+        while(next < text.size() && is_whitespace(text[next])) next++;
+    }
+    if(next == text.size() || !is_digit(text[next])) return 0;
+
+    long long exponent = 0;
+    while(next < text.size() && (is_digit(text[next]) || is_whitespace(text[next]))){
+        if(is_digit(text[next]) && exponent < EXPONENT_LIMIT) exponent = exponent * 10 + (text[next] - '0');
+        next++;
+    }
+    i = next;
+    return negative ? -exponent : exponent;
+}
+
+// parse_number: the double closest to the decimal at text[i], moves i past it
+constexpr int parse_number(std::string_view text, std::size_t& i, double& value){
+    Decimal decimal;
+    if(read_digits(text, i, decimal, false) == 0) return CAL_ERROR_SYNTAX;
+    if(i < text.size() && text[i] == DECIMAL_POINT){
+        i++;
+        if(read_digits(text, i, decimal, true) == 0) return CAL_ERROR_SYNTAX;
+    }
+    long long written_exponent = 0;
+    if(i < text.size() && text[i] == EXPONENT) written_exponent = read_exponent(text, i);
+
+    value = 0;
+    if(decimal.digits == 0) return CAL_OK;
+
+    // one more digit that isn't 0 keeps it between the same two doubles
+    if(decimal.sticky){
+        big_multiply_add(decimal.mantissa, 10, 1);
+        decimal.digits++;
+        decimal.exponent--;
+    }
+    const long long exponent = decimal.exponent + written_exponent;
+
+    // 10^308 and more is infinity, under 10^-343 it rounds to 0
+    if(exponent + decimal.digits > 309){
+        value = INF;
+        return CAL_OK;
+    }
+    if(exponent + decimal.digits < -343) return CAL_OK;
+
+    // both the mantissa and the power of ten are exact so there is only one rounding
+    if(decimal.digits <= 15 && exponent >= -22 && exponent <= 22){
+        double power = 1;
+        for(long long p = 0; p < (exponent < 0 ? -exponent : exponent); p++) power *= 10;
+        const double mantissa = big_to_double(decimal.mantissa);
+        value = exponent < 0 ? mantissa / power : mantissa * power;
+        return CAL_OK;
+    }
+
+    if(exponent < 0){
+        value = big_divide_to_double(decimal.mantissa, (int) -exponent);
+    } else {
+        for(long long p = 0; p < exponent; p++) big_multiply_add(decimal.mantissa, 10, 0);
+        value = big_to_double(decimal.mantissa);
+    }
+    return CAL_OK;
+}
+
+// lex_expression
+constexpr int lex_expression(std::string_view text, std::vector<Element>& elements){
+    std::size_t i = 0;
+    while(i < text.size()){
+        const char c = text[i];
+        if(is_whitespace(c)){
+            i++;
+            continue;
+        }
+
+        // a minus is a negative sign when there isn't a value on its left
+        bool negative = false;
+        if(c == '-'){
+            const char prev = elements.empty() ? BRACKET_OPEN : elements.back().type;
+            std::size_t next = i + 1;
+            while(next < text.size() && is_whitespace(text[next])) next++;
+            if(prev != NUMBER && prev != VARIABLE && prev != BRACKET_CLOSE && prev != '!'){
+                if(next < text.size() && (is_digit(text[next]) || text[next] == PI)){
+                    negative = true;
+                    i = next;
+                } else {
+                    elements.push_back({0.0, OPERATOR_NEGATE, -1});
+                    i++;
+                    continue;
+                }
+            }
+        }
+
+        const char d = text[i];
+        if(!negative && is_variable_character(d, true)){
+            const std::size_t start = i;
+            while(i < text.size() && is_variable_character(text[i], false)) i++;
+            if(i - start > USHRT_MAX) return CAL_ERROR_SYNTAX;
+            elements.push_back({0.0, VARIABLE, -1});
+            continue;
+        }
+
+        if(!negative && !is_digit(d) && d != PI && d != DECIMAL_POINT){
+            elements.push_back({0.0, d, -1});
+            i++;
+            continue;
+        }
+
+        double value = 0;
+        if(d == PI){
+            value = std::numbers::pi;
+            i++;
+        } else {
+            if(parse_number(text, i, value) != CAL_OK) return CAL_ERROR_SYNTAX;
+            if(i < text.size() && text[i] == DECIMAL_POINT) return CAL_ERROR_SYNTAX;
+        }
+        if(negative) value = -value;
+        elements.push_back({value, NUMBER, -1});
+    }
+    return CAL_OK;
+}
+
+// whole numbers, calql8r_integer.c
+
+constexpr bool checked_add(long long a, long long b, long long& answer){
+    if((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) return false;
+    answer = a + b;
+    return true;
+}
+
+constexpr bool checked_subtract(long long a, long long b, long long& answer){
+    if((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b)) return false;
+    answer = a - b;
+    return true;
+}
+
+constexpr bool checked_multiply(long long a, long long b, long long& answer){
+    if(a > 0 ? (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a) : (b > 0 ? a < LLONG_MIN / b : (a != 0 && b < LLONG_MAX / a))){
+        return false;
+    }
+    answer = a * b;
+    return true;
+}
+
+constexpr bool is_exact_integer(double value){
+    return value == truncate(value) && absolute(value) < EXACT_INTEGER_LIMIT;
+}
+
+constexpr bool integer_pow(long long base, long long exponent, long long& answer){
+    if(exponent < 0) return false;
+    if(base == 0 || base == 1) answer = exponent == 0 ? 1 : base;
+    else if(base == -1) answer = exponent % 2 == 0 ? 1 : -1;
+    if(base >= -1 && base <= 1) return true;
+    if(exponent >= 63) return false;
+
+    long long value = 1;
+    while(exponent > 0){
+        if((exponent & 1) && !checked_multiply(value, base, value)) return false;
+        exponent >>= 1;
+        if(exponent > 0 && !checked_multiply(base, base, base)) return false;
+    }
+    answer = value;
+    return true;
+}
+
+constexpr bool exact_permutation(double n, double r, unsigned long long& answer){
+    if(n > EXACT_INTEGER_LIMIT) return false;
+    const unsigned long long top = (unsigned long long) n;
+    unsigned long long value = 1;
+    for(unsigned long long i = 0; i < (unsigned long long) r; i++){
+        const unsigned long long factor = top - i;
+        if(factor > 1 && value > ULLONG_MAX / factor) return false;
+        value *= factor;
+    }
+    answer = value;
+    return true;
+}
+
+constexpr unsigned long long greatest_common_divisor(unsigned long long a, unsigned long long b){
+    while(b != 0){
+        const unsigned long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+constexpr bool exact_combinations(double n, double r, unsigned long long& answer){
+    if(n > EXACT_INTEGER_LIMIT) return false;
+    const unsigned long long bottom = (unsigned long long) (n - r);
+    unsigned long long value = 1;
+    for(unsigned long long i = 1; i <= (unsigned long long) r; i++){
+        const unsigned long long divisor = greatest_common_divisor(value, i);
+        const unsigned long long factor = (bottom + i) / (i / divisor);
+        value /= divisor;
+        if(value > ULLONG_MAX / factor) return false;
+        value *= factor;
+    }
+    answer = value;
+    return true;
+}
+
+constexpr bool integer_factorials(char type, long long n, long long r, long long& answer){
+    if(n < 0 || r < 0 || r > n || (double) n >= EXACT_INTEGER_LIMIT) return false;
+    if(type == 'Z' && n - r < r) r = n - r;
+    const long long smallest = type == 'Z' ? (r > 0 ? n / r : 1) : n - r + 1;
+    if(r >= 63 || (smallest > 1 && r * (63 - std::countl_zero((unsigned long long) smallest)) >= 63)) return false;
+
+    unsigned long long value = 0;
+    if(type == 'Z'){
+        if(!exact_combinations((double) n, (double) r, value)) return false;
+    } else {
+        if(!exact_permutation((double) n, (double) r, value)) return false;
+    }
+    if(value > LLONG_MAX) return false;
+    answer = (long long) value;
+    return true;
+}
+
+constexpr bool integer_operator(char type, long long a, long long b, long long& answer){
+    switch (type) {
+        case '+': return checked_add(a, b, answer);
+        case '-': return checked_subtract(a, b, answer);
+        case '*': return checked_multiply(a, b, answer);
+        case OPERATOR_NEGATE: return checked_subtract(0, a, answer);
+        case '^': return integer_pow(a, b, answer);
+        case '!': return integer_factorials('!', a, a, answer);
+        case 'Y':
+        case 'Z':
+            return integer_factorials(type, a, b, answer);
+        default: return false;
+    }
+}
+
+// operator_precedence of calql8r_program.c
+constexpr int operator_precedence(char type){
+    switch (type) {
+        case '+': return 1;
+        case '-': return 2;
+        case '*': return 3;
+        case '/': return 4;
+        case 'r': return 5;
+        case '^': return 6;
+        case 'l': return 7;
+        case 'S': case 's': case 'C': case 'c': case 'T': case 't': case 'L': case 'E': case OPERATOR_NEGATE:
+            return 8;
+        case 'Z': return 9;
+        case 'Y': return 10;
+        default: return 0;
+    }
+}
+
+constexpr bool is_integer_operator(char type){
+    return type == '+' || type == '-' || type == '*' || type == '^' || type == 'Y' || type == 'Z';
+}
+
+constexpr bool reduce_integer_operator(std::vector<long long>& values, char type){
+    long long right = 0;
+    if(type != '!' && type != OPERATOR_NEGATE){
+        right = values.back();
+        values.pop_back();
+    }
+    return integer_operator(type, values.back(), right, values.back());
+}
+
+// calculate_integer_expression
+constexpr bool calculate_integer_expression(const std::vector<Element>& elements, long long& answer){
+    std::vector<char> operators;
+    std::vector<long long> values;
+    bool expect_value = true;
+    char previous = 0;
+
+    for(const Element& ele : elements){
+        const char c = ele.type;
+        if(c == previous && (c == '!' || c == OPERATOR_NEGATE)) return false;
+        previous = c;
+
+        if(expect_value){
+            if(c == NUMBER){
+                if(!is_exact_integer(ele.value)) return false;
+                values.push_back((long long) ele.value);
+                expect_value = false;
+            } else if(c == BRACKET_OPEN || c == OPERATOR_NEGATE){
+                operators.push_back(c);
+            } else {
+                return false;
+            }
+            continue;
+        }
+
+        if(c == '!'){
+            if(!reduce_integer_operator(values, c)) return false;
+        } else if(c == BRACKET_CLOSE){
+            while(!operators.empty() && operators.back() != BRACKET_OPEN){
+                const char type = operators.back();
+                operators.pop_back();
+                if(!reduce_integer_operator(values, type)) return false;
+            }
+            if(operators.empty()) return false;
+            operators.pop_back();
+        } else if(is_integer_operator(c)){
+            const int precedence = operator_precedence(c);
+            while(!operators.empty() && operators.back() != BRACKET_OPEN && operator_precedence(operators.back()) >= precedence){
+                const char type = operators.back();
+                operators.pop_back();
+                if(!reduce_integer_operator(values, type)) return false;
+            }
+            operators.push_back(c);
+            expect_value = true;
+        } else {
+            return false;
+        }
+    }
+    if(expect_value) return false;
+
+    while(!operators.empty()){
+        const char c = operators.back();
+        operators.pop_back();
+        if(c == BRACKET_OPEN) return false;
+        if(!reduce_integer_operator(values, c)) return false;
+    }
+    if(values[0] == 0) return false;
+    answer = values[0];
+    return true;
+}
+
+// doubles, calql8r.c
+
+constexpr Element number(double value){
+    return {value, NUMBER, -1};
+}
+
+constexpr Element error(){
+    return {0.0, ELEMENT_ERROR, -1};
+}
+
+constexpr Element calculate_sin(double num){ return number(math_sin(num)); }
+constexpr Element calculate_sinh(double num){ return number(math_sinh(num)); }
+constexpr Element calculate_cos(double num){ return number(math_cos(num)); }
+constexpr Element calculate_cosh(double num){ return number(math_cosh(num)); }
+constexpr Element calculate_tan(double num){ return number(math_tan(num)); }
+constexpr Element calculate_tanh(double num){ return number(math_tanh(num)); }
+constexpr Element calculate_log10(double num){ return num <= 0 ? error() : number(math_log10(num)); }
+constexpr Element calculate_ln(double num){ return num <= 0 ? error() : number(math_log(num) / math_log(math_exp(1))); }
+constexpr Element calculate_negate(double num){ return number(-num); }
+constexpr Element calculate_add(double num1, double num2){ return number(num1 + num2); }
+constexpr Element calculate_substract(double num1, double num2){ return number(num1 - num2); }
+constexpr Element calculate_multiply(double num1, double num2){ return number(num1 * num2); }
+constexpr Element calculate_divide(double num1, double num2){ return num2 == 0 ? error() : number(num1 / num2); }
+constexpr Element calculate_pow(double base, double exp){ return number(math_pow(base, exp)); }
+constexpr Element calculate_root(double num1, double num2){ return num1 <= 0 ? error() : number(math_pow(num2, 1 / num1)); }
+
+constexpr Element calculate_log(double base, double raised){
+    if(base <= 0 || raised <= 0) return error();
+    return number(math_log(raised) / math_log(base));
+}
+
+constexpr bool factorial_values(double n1, double r1, double& n, double& r){
+    if(is_nan(n1) || is_nan(r1)) return false;
+    n = truncate(n1);
+    r = truncate(r1);
+    return n >= 0 && r >= 0 && r <= n && !is_inf(n);
+}
+
+constexpr Element calculate_permutation(double n1, double r1){
+    double n = 0, r = 0;
+    if(!factorial_values(n1, r1, n, r)) return error();
+
+    unsigned long long exact = 0;
+    if(n <= EXACT_FACTORIAL_LIMIT) return number((double) (exact_factorial((int) n) / exact_factorial((int) (n - r))));
+    if(exact_permutation(n, r, exact)) return number((double) exact);
+    if(n <= FACTORIAL_LIMIT) return number(FACTORIALS[(int) n] / FACTORIALS[(int) (n - r)]);
+    if(r <= FACTORIAL_LIMIT){
+        double value = 1;
+        for(int i = 0; i < (int) r; i++) value *= n - i;
+        return number(value);
+    }
+    return number(math_exp(math_lgamma(n + 1) - math_lgamma(n - r + 1)));
+}
+
+constexpr Element calculate_combinations(double n1, double r1){
+    double n = 0, r = 0;
+    if(!factorial_values(n1, r1, n, r)) return error();
+    if(n - r < r) r = n - r;
+
+    unsigned long long exact = 0;
+    if(n <= EXACT_FACTORIAL_LIMIT){
+        return number((double) (exact_factorial((int) n) / (exact_factorial((int) r) * exact_factorial((int) (n - r)))));
+    }
+    if(exact_combinations(n, r, exact)) return number((double) exact);
+    if(n <= FACTORIAL_LIMIT) return number(FACTORIALS[(int) n] / (FACTORIALS[(int) r] * FACTORIALS[(int) (n - r)]));
+    if(r <= COMBINATIONS_STEP_LIMIT){
+        double value = 1;
+        for(int i = 1; i <= (int) r; i++) value *= (n - r + i) / i;
+        return number(value);
+    }
+    return number(math_exp(math_lgamma(n + 1) - math_lgamma(r + 1) - math_lgamma(n - r + 1)));
+}
+
+constexpr Element calculate_factorial(double num){
+    if(is_nan(num) || num < 0) return error();
+    if(num <= EXACT_FACTORIAL_LIMIT) return number((double) exact_factorial((int) num));
+    if(num > FACTORIAL_LIMIT) return number(INF);
+    return number(FACTORIALS[(int) num]);
+}
+
+// calculate_2_value_expressions
+constexpr Expression calculate_2_value_expressions(Expression expression, char symbol, Element (*callback)(double, double)){
+    Expression expr{expression.elements, 0, CAL_OK};
+    Element* elements = expression.elements;
+
+    int prev_number_index = -1;
+    for(int i = 0; i < expression.length; i++){
+        const char c = elements[i].type;
+        if(c == symbol){
+            if(i == 0 || i == expression.length - 1) return expr.error = CAL_ERROR_SYNTAX, expr;
+
+            Element prev = elements[i - 1];
+            const Element next = elements[i + 1];
+            if(prev.type == NUMBER && next.type == NUMBER && prev_number_index == -1){
+                const Element ele = callback(prev.value, next.value);
+                if(ele.type == ELEMENT_ERROR) return expr.error = CAL_ERROR_SYNTAX, expr;
+                elements[i - 1] = ele;
+                prev_number_index = i - 1;
+                elements[i].type = NUMBER_REMOVE;
+                elements[i + 1].type = NUMBER_REMOVE;
+            } else if(next.type == NUMBER && prev_number_index > -1){
+                prev = elements[prev_number_index];
+                const Element ele = callback(prev.value, next.value);
+                if(ele.type == ELEMENT_ERROR) return expr.error = CAL_ERROR_SYNTAX, expr;
+                elements[prev_number_index] = ele;
+                elements[i].type = NUMBER_REMOVE;
+                elements[i + 1].type = NUMBER_REMOVE;
+            } else {
+                return expr.error = CAL_ERROR_SYNTAX, expr;
+            }
+        } else if(c != NUMBER_REMOVE) {
+            prev_number_index = -1;
+        }
+    }
+
+    for(int i = 0; i < expression.length; i++){
+        if(elements[i].type != NUMBER_REMOVE) expr.elements[expr.length++] = elements[i];
+    }
+    return expr;
+}
+
+// calculate_1_value_expression, functions take the value on their right and ! the one on its left
+constexpr Expression calculate_1_value_expression(Expression expression, char symbol, bool left, Element (*callback)(double)){
+    Expression expr{expression.elements, 0, CAL_OK};
+    Element* elements = expression.elements;
+
+    for(int i = 0; i < expression.length; i++){
+        if(elements[i].type != symbol) continue;
+        if((i == 0 && left) || (i == expression.length - 1 && !left)) return expr.error = CAL_ERROR_SYNTAX, expr;
+
+        if(left){
+            if(elements[i - 1].type != NUMBER) return expr.error = CAL_ERROR_SYNTAX, expr;
+            const Element ele = callback(elements[i - 1].value);
+            if(ele.type == ELEMENT_ERROR) return expr.error = CAL_ERROR_SYNTAX, expr;
+            elements[i - 1] = ele;
+            elements[i].type = NUMBER_REMOVE;
+        } else {
+            if(elements[i + 1].type != NUMBER) return expr.error = CAL_ERROR_SYNTAX, expr;
+            const Element ele = callback(elements[i + 1].value);
+            if(ele.type == ELEMENT_ERROR) return expr.error = CAL_ERROR_SYNTAX, expr;
+            elements[i].type = NUMBER_REMOVE;
+            elements[i + 1] = ele;
+        }
+    }
+
+    for(int i = 0; i < expression.length; i++){
+        if(elements[i].type != NUMBER_REMOVE) expr.elements[expr.length++] = elements[i];
+    }
+    return expr;
+}
+
+// calculate_math, one pass per operator in the same order
+constexpr Expression calculate_math(Expression expr){
+    const auto one = [](Expression e, char symbol, bool left, Element (*callback)(double)){
+        return e.error != CAL_OK ? e : calculate_1_value_expression(e, symbol, left, callback);
+    };
+    const auto two = [](Expression e, char symbol, Element (*callback)(double, double)){
+        return e.error != CAL_OK ? e : calculate_2_value_expressions(e, symbol, callback);
+    };
+
+    expr = one(expr, '!', true, calculate_factorial);
+    expr = two(expr, 'Y', calculate_permutation);
+    expr = two(expr, 'Z', calculate_combinations);
+    expr = one(expr, 'S', false, calculate_sin);
+    expr = one(expr, 's', false, calculate_sinh);
+    expr = one(expr, 'C', false, calculate_cos);
+    expr = one(expr, 'c', false, calculate_cosh);
+    expr = one(expr, 'T', false, calculate_tan);
+    expr = one(expr, 't', false, calculate_tanh);
+    expr = one(expr, 'L', false, calculate_log10);
+    expr = one(expr, 'E', false, calculate_ln);
+    expr = one(expr, OPERATOR_NEGATE, false, calculate_negate);
+    expr = two(expr, 'l', calculate_log);
+    expr = two(expr, '^', calculate_pow);
+    expr = two(expr, 'r', calculate_root);
+    expr = two(expr, '/', calculate_divide);
+    expr = two(expr, '*', calculate_multiply);
+    expr = two(expr, '-', calculate_substract);
+    expr = two(expr, '+', calculate_add);
+    return expr;
+}
+
+// calculate_all_brackets
+constexpr int calculate_all_brackets(Expression& expression){
+    Element* elements = expression.elements;
+    int length = 0;
+    int last_open_bracket = -1;
+
+    for(int i = 0; i < expression.length; i++){
+        Element ele = elements[i];
+        if(ele.type == BRACKET_OPEN){
+            ele.previous_open = last_open_bracket;
+            last_open_bracket = length;
+        } else if(ele.type == BRACKET_CLOSE){
+            if(last_open_bracket == -1) return CAL_ERROR_SYNTAX;
+
+            Expression bracket{elements + last_open_bracket + 1, length - last_open_bracket - 1, CAL_OK};
+            bracket = calculate_math(bracket);
+            if(bracket.error != CAL_OK) return bracket.error;
+            if(bracket.length != 1) return CAL_ERROR_MATH;
+
+            const int previous_open_bracket = elements[last_open_bracket].previous_open;
+            elements[last_open_bracket] = bracket.elements[0];
+            length = last_open_bracket + 1;
+            last_open_bracket = previous_open_bracket;
+            continue;
+        }
+        elements[length++] = ele;
+    }
+    if(last_open_bracket != -1) return CAL_ERROR_SYNTAX;
+
+    expression.length = length;
+    return CAL_OK;
+}
+
+} // namespace detail
+
+// calql8r_eval_exact of 'text', works in constant expressions and at run time
+constexpr Answer evaluate(std::string_view text){
+    Answer answer{CAL_OK, 0.0, false, 0};
+    std::vector<detail::Element> elements;
+    int status = detail::lex_expression(text, elements);
+    if(status == CAL_OK && elements.empty()) status = CAL_ERROR_SYNTAX;
+    if(status != CAL_OK) return answer.status = status, answer;
+
+    if(detail::calculate_integer_expression(elements, answer.integer)){
+        answer.exact = true;
+        answer.value = (double) answer.integer;
+        return answer;
+    }
+
+    detail::Expression expr{elements.data(), (int) elements.size(), CAL_OK};
+    status = detail::calculate_all_brackets(expr);
+    if(status != CAL_OK) return answer.status = status, answer;
+
+    expr = detail::calculate_math(expr);
+    if(expr.error != CAL_OK) return answer.status = expr.error, answer;
+    if(expr.length != 1 || expr.elements[0].type != detail::NUMBER) return answer.status = CAL_ERROR_SYNTAX, answer;
+
+    answer.value = expr.elements[0].value;
+    return answer;
+}
+
+// The answer of a constant expression while compiling, an expression with an error doesn't compile
+consteval double constant(std::string_view text){
+    const Answer answer = evaluate(text);
+    if(answer.status != CAL_OK) throw "calql8r::constant: the expression has an error";
+    return answer.value;
+}
+
+namespace literals {
+
+// "2r2*p"_calql8r
+consteval double operator""_calql8r(const char* text, std::size_t length){
+    return constant(std::string_view(text, length));
+}
+
+} // namespace literals
+
+} // namespace calql8r
+
+#endif
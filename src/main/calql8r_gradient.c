@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+// rows worked on at a time, every value on the stack has a block for each variable as well so they are smaller than the columns
+#define GRADIENT_BLOCK_SIZE 128
+// doubles calql8r_run_gradient can use before it needs the heap
+#define GRADIENT_LOCAL_SIZE 1024
+
+// Dual numbers. Every value on the stack carries its derivative for each variable (its tangents) in the blocks after it.
+// A VARIABLE starts with 1 for its own variable and 0 for the others. Every operator calculates its answer with the same
+// functions as calql8r_run_columns and then its tangents with the chain rule, t = da * ta + db * tb where da and db
+// are the derivatives of the operator for its left and right value.
+// Every value also has a mask of the variables it changes with and only those tangents are written and read,
+// the others are 0. Numbers, nPr, nCr and ! have none. Past 63 variables the last bit stands for all the rest.
+
+static inline unsigned long long variable_bit(int index){
+    return 1ULL << (index < 63 ? index : 63);
+}
+
+// derivatives of the operators with two values, 'a' and 'b' are the values before the operator and 'v' its answer
+void gradient_derivatives_2(char type, const double* restrict a, const double* restrict b, const double* restrict v, double* restrict da, double* restrict db, int n){
+    switch (type) {
+        case OPERATOR_MULTPILY:
+            for(int i = 0; i < n; i++){
+                da[i] = b[i];
+                db[i] = a[i];
+            }
+            break;
+        case OPERATOR_DIVIDE:
+            for(int i = 0; i < n; i++){
+                da[i] = 1 / b[i];
+                db[i] = -v[i] / b[i];
+            }
+            break;
+        // a^b is b a^(b-1) for a and a^b ln(a) for b, which is 0 when a^b is 0 (e.g 0^x)
+        case OPERATOR_POW:
+            for(int i = 0; i < n; i++){
+                da[i] = b[i] == 0 ? 0 : b[i] * pow(a[i], b[i] - 1);
+                db[i] = v[i] == 0 ? 0 : v[i] * log(a[i]);
+            }
+            break;
+        // a r b is b^(1/a)
+        case OPERATOR_ROOT:
+            for(int i = 0; i < n; i++){
+                da[i] = v[i] == 0 ? 0 : -v[i] * log(b[i]) / (a[i] * a[i]);
+                db[i] = pow(b[i], 1 / a[i] - 1) / a[i];
+            }
+            break;
+        // a l b is ln(b) / ln(a)
+        case OPERATOR_LOGx:
+            for(int i = 0; i < n; i++){
+                da[i] = -v[i] / (a[i] * log(a[i]));
+                db[i] = 1 / (b[i] * log(a[i]));
+            }
+            break;
+    }
+}
+
+// derivatives of the functions, 'a' is the value before the function and 'v' its answer
+void gradient_derivatives_1(char type, const double* restrict a, const double* restrict v, double* restrict da, int n){
+    switch (type) {
+        case OPERATOR_SIN: for(int i = 0; i < n; i++) da[i] = cos(a[i]); break;
+        case OPERATOR_SINH: for(int i = 0; i < n; i++) da[i] = cosh(a[i]); break;
+        case OPERATOR_COS: for(int i = 0; i < n; i++) da[i] = -sin(a[i]); break;
+        case OPERATOR_COSH: for(int i = 0; i < n; i++) da[i] = sinh(a[i]); break;
+        case OPERATOR_TAN: for(int i = 0; i < n; i++) da[i] = 1 + v[i] * v[i]; break;
+        case OPERATOR_TANH: for(int i = 0; i < n; i++) da[i] = 1 - v[i] * v[i]; break;
+        case OPERATOR_LOG10: for(int i = 0; i < n; i++) da[i] = 1 / (a[i] * M_LN10); break;
+        case OPERATOR_LN: for(int i = 0; i < n; i++) da[i] = 1 / a[i]; break;
+    }
+}
+
+// A tangent that is 0 adds nothing even when its derivative is infinite or NAN
+// e.g x^3 at x = -2 has ln(-2) as the derivative for the 3 but the 3 doesn't change with x
+static inline double chain(double derivative, double tangent){
+    return tangent != 0 ? derivative * tangent : 0;
+}
+
+void tangent_chain_2(double* restrict ta, const double* restrict tb, const double* restrict da, const double* restrict db, int n){
+    for(int i = 0; i < n; i++) ta[i] = chain(da[i], ta[i]) + chain(db[i], tb[i]);
+}
+
+void tangent_chain_left(double* restrict ta, const double* restrict da, int n){
+    for(int i = 0; i < n; i++) ta[i] = chain(da[i], ta[i]);
+}
+
+void tangent_chain_right(double* restrict ta, const double* restrict tb, const double* restrict db, int n){
+    for(int i = 0; i < n; i++) ta[i] = chain(db[i], tb[i]);
+}
+
+void tangent_add(double* restrict ta, const double* restrict tb, double sign, int left, int n){
+    if(left) for(int i = 0; i < n; i++) ta[i] += sign * tb[i];
+    else for(int i = 0; i < n; i++) ta[i] = sign * tb[i];
+}
+
+// Tangents of the answer of 'type' into the tangents of 'a', 'previous' is the value of 'a' before the operator.
+// 'left' and 'right' are the masks of the values, gives the mask of the answer.
+unsigned long long tangent_operator(char type, double* a, const double* b, const double* previous, double* da, double* db,
+    unsigned long long left, unsigned long long right, int tangents, int size, int n){
+    switch (type) {
+        // only change at whole numbers
+        case OPERATOR_FACTORIAL:
+        case PERMUTATIONS:
+        case COMBINATIONS:
+            return 0;
+        case OPERATOR_ADD:
+        case OPERATOR_SUBSTRACT:
+            for(int j = 0; j < tangents; j++){
+                if(right & variable_bit(j)) tangent_add(a + (j + 1) * size, b + (j + 1) * size, type == OPERATOR_ADD ? 1 : -1, (left & variable_bit(j)) != 0, n);
+            }
+            return left | right;
+        case OPERATOR_NEGATE:
+            for(int j = 0; j < tangents; j++){
+                if(!(left & variable_bit(j))) continue;
+                double* ta = a + (j + 1) * size;
+                for(int i = 0; i < n; i++) ta[i] = -ta[i];
+            }
+            return left;
+        case OPERATOR_MULTPILY:
+        case OPERATOR_DIVIDE:
+        case OPERATOR_POW:
+        case OPERATOR_ROOT:
+        case OPERATOR_LOGx:
+            gradient_derivatives_2(type, previous, b, a, da, db, n);
+            for(int j = 0; j < tangents; j++){
+                double* ta = a + (j + 1) * size;
+                const double* tb = b + (j + 1) * size;
+                const unsigned long long bit = variable_bit(j);
+                if((left & bit) && (right & bit)) tangent_chain_2(ta, tb, da, db, n);
+                else if(left & bit) tangent_chain_left(ta, da, n);
+                else if(right & bit) tangent_chain_right(ta, tb, db, n);
+            }
+            return left | right;
+        default:
+            gradient_derivatives_1(type, previous, a, da, n);
+            for(int j = 0; j < tangents; j++){
+                if(left & variable_bit(j)) tangent_chain_left(a + (j + 1) * size, da, n);
+            }
+            return left;
+    }
+}
+
+// Runs the program over rows [row, row + n) of 'columns', or over the one row in 'variables' when 'columns' is NULL.
+// Every stack value and then every slot has a block of 'size' doubles for its answers and one after it for each variable,
+// three more blocks after them are for the operators.
+int run_gradient_block(const struct CalQl8rProgram* program, const double* const* columns, const double* variables, size_t row, int n, int size,
+    double* stack, unsigned long long* masks, unsigned char* errors){
+    const int tangents = program->variables_length;
+    const size_t width = (size_t) (tangents + 1) * size;
+    double* slots = stack + program->stack_size * width;
+    unsigned long long* slots_masks = masks + program->stack_size;
+    double* previous = slots + program->slots_length * width;
+    double* da = previous + size;
+    double* db = da + size;
+    const double* constant = program->constants;
+    int top = 0;
+    memset(errors, 0, n);
+
+    for(int i = 0; i < program->code_length; i++){
+        const char c = program->code[i];
+        if(c == NUMBER){
+            double* value = stack + top * width;
+            for(int r = 0; r < n; r++) value[r] = *constant;
+            constant++;
+            masks[top++] = 0;
+            continue;
+        }
+        if(c == VARIABLE){
+            const int index = (int) *constant++;
+            double* value = stack + top * width;
+            if(columns != NULL) memcpy(value, columns[index] + row, n * sizeof (double));
+            else value[0] = variables[index];
+            // the tangents past 63 share a bit so they all have to be there
+            if(index >= 63) memset(value + 64 * size, 0, (tangents - 63) * size * sizeof (double));
+            for(int r = 0; r < n; r++) value[(index + 1) * size + r] = 1;
+            masks[top++] = variable_bit(index);
+            continue;
+        }
+        if(c == SLOT_STORE){
+            const int slot = (int) *constant++;
+            slots_masks[slot] = masks[top - 1];
+            memcpy(slots + slot * width, stack + (top - 1) * width, (masks[top - 1] ? width : (size_t) n) * sizeof (double));
+            continue;
+        }
+        if(c == SLOT_LOAD){
+            const int slot = (int) *constant++;
+            masks[top] = slots_masks[slot];
+            memcpy(stack + top++ * width, slots + slot * width, (slots_masks[slot] ? width : (size_t) n) * sizeof (double));
+            continue;
+        }
+
+        // two value operators pop the right value first
+        const int two_values = c != OPERATOR_FACTORIAL && !is_function_operator(c);
+        if(two_values) top--;
+        double* a = stack + (top - 1) * width;
+        const double* b = stack + top * width;
+        const unsigned long long left = masks[top - 1];
+        const unsigned long long right = two_values ? masks[top] : 0;
+
+        if(left || right) memcpy(previous, a, n * sizeof (double));
+        if(column_operator(c, a, b, errors, n) != CAL_OK) return CAL_ERROR_SYNTAX;
+        if(left || right) masks[top - 1] = tangent_operator(c, a, b, previous, da, db, left, right, tangents, size, n);
+    }
+    return CAL_OK;
+}
+
+int calql8r_run_gradient(const struct CalQl8rProgram* program, const double* variables, double* result, double* gradient){
+    double local_stack[GRADIENT_LOCAL_SIZE];
+    unsigned long long local_masks[GRADIENT_LOCAL_SIZE];
+    double* stack = local_stack;
+    unsigned long long* masks = local_masks;
+
+    // only very deep programs or ones with a lot of variables need the heap
+    const int entries = program->stack_size + program->slots_length;
+    const size_t doubles = (size_t) entries * (program->variables_length + 1) + 3;
+    if(doubles > GRADIENT_LOCAL_SIZE){
+        stack = (double *) malloc((doubles + entries) * sizeof (double));
+        if(stack == NULL) return CAL_ERROR_MEMORY;
+        masks = (unsigned long long *) (stack + doubles);
+    }
+
+    unsigned char error;
+    int status = run_gradient_block(program, NULL, variables, 0, 1, 1, stack, masks, &error);
+    if(status == CAL_OK && error) status = CAL_ERROR_SYNTAX;
+    if(status == CAL_OK){
+        *result = stack[0];
+        for(int j = 0; j < program->variables_length; j++) gradient[j] = masks[0] & variable_bit(j) ? stack[j + 1] : 0;
+    }
+
+    if(stack != local_stack) free(stack);
+    return status;
+}
+
+int calql8r_run_gradient_columns(const struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results, double* const* gradients){
+    const int entries = program->stack_size + program->slots_length;
+    const size_t doubles = ((size_t) entries * (program->variables_length + 1) + 3) * GRADIENT_BLOCK_SIZE;
+    double* stack = (double *) malloc((doubles + entries) * sizeof (double));
+    if(stack == NULL) return CAL_ERROR_MEMORY;
+    unsigned long long* masks = (unsigned long long *) (stack + doubles);
+
+    unsigned char errors[GRADIENT_BLOCK_SIZE];
+    int status = CAL_OK;
+    for(size_t row = 0; row < rows && status == CAL_OK; row += GRADIENT_BLOCK_SIZE){
+        const int n = rows - row < GRADIENT_BLOCK_SIZE ? (int) (rows - row) : GRADIENT_BLOCK_SIZE;
+        status = run_gradient_block(program, columns, NULL, row, n, GRADIENT_BLOCK_SIZE, stack, masks, errors);
+        for(int i = 0; i < n; i++) results[row + i] = errors[i] ? NAN : stack[i];
+        for(int j = 0; j < program->variables_length; j++){
+            const double* tangent = stack + (j + 1) * GRADIENT_BLOCK_SIZE;
+            const int changes = (masks[0] & variable_bit(j)) != 0;
+            for(int i = 0; i < n; i++) gradients[j][row + i] = errors[i] ? NAN : changes ? tangent[i] : 0;
+        }
+    }
+
+    free(stack);
+    return status;
+}
@@ -0,0 +1,162 @@
+#include <math.h>
+#include <limits.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+// whole numbers read from the text, only the ones below 2^53 are sure to be exactly what was written
+int is_exact_integer(double value){
+    return value == trunc(value) && fabs(value) < EXACT_INTEGER_LIMIT;
+}
+
+// base^exponent by squaring, FALSE when it doesn't fit or the exponent is negative
+int integer_pow(long long base, long long exponent, long long* answer){
+    if(exponent < 0) return FALSE;
+    if(base == 0 || base == 1) *answer = exponent == 0 ? 1 : base;
+    else if(base == -1) *answer = exponent % 2 == 0 ? 1 : -1;
+    if(base >= -1 && base <= 1) return TRUE;
+
+    // 2^63 doesn't fit either
+    if(exponent >= 63) return FALSE;
+
+    long long value = 1;
+    while(exponent > 0){
+        if((exponent & 1) && __builtin_mul_overflow(value, base, &value)) return FALSE;
+        exponent >>= 1;
+
+        // the square is a factor of the answer when there are bits left so it has to fit too
+        if(exponent > 0 && __builtin_mul_overflow(base, base, &base)) return FALSE;
+    }
+    *answer = value;
+    return TRUE;
+}
+
+// nPr, nCr and n! with the same exact steps as calculate_permutation and calculate_combinations
+int integer_factorials(char type, long long n, long long r, long long* answer){
+    if(n < 0 || r < 0 || r > n || (double) n >= EXACT_INTEGER_LIMIT) return FALSE;
+
+    // nPr is at least (n-r+1)^r and nCr at least (n/r)^r, when that is 2^63 or more the exact steps
+    // would only find out after many divisions that it doesn't fit
+    if(type == COMBINATIONS && n - r < r) r = n - r;
+    const long long smallest = type == COMBINATIONS ? (r > 0 ? n / r : 1) : n - r + 1;
+    if(r >= 63 || (smallest > 1 && r * (63 - __builtin_clzll(smallest)) >= 63)) return FALSE;
+
+    unsigned long long value;
+    if(type == COMBINATIONS){
+        if(!exact_combinations((double) n, (double) r, &value)) return FALSE;
+    } else {
+        if(!exact_permutation((double) n, (double) r, &value)) return FALSE;
+    }
+    if(value > LLONG_MAX) return FALSE;
+    *answer = (long long) value;
+    return TRUE;
+}
+
+// FALSE when the answer doesn't fit in 64 bits or the values can't be calculated e.g 2Y3
+int integer_operator(char type, long long a, long long b, long long* answer){
+    switch (type) {
+        case OPERATOR_ADD: return !__builtin_add_overflow(a, b, answer);
+        case OPERATOR_SUBSTRACT: return !__builtin_sub_overflow(a, b, answer);
+        case OPERATOR_MULTPILY: return !__builtin_mul_overflow(a, b, answer);
+        case OPERATOR_NEGATE: return !__builtin_sub_overflow(0, a, answer);
+        case OPERATOR_POW: return integer_pow(a, b, answer);
+        case OPERATOR_FACTORIAL: return integer_factorials(OPERATOR_FACTORIAL, a, a, answer);
+        case PERMUTATIONS:
+        case COMBINATIONS:
+            return integer_factorials(type, a, b, answer);
+        default: return FALSE;
+    }
+}
+
+int is_integer_operator(char type){
+    return type == OPERATOR_ADD || type == OPERATOR_SUBSTRACT || type == OPERATOR_MULTPILY || type == OPERATOR_POW
+        || type == PERMUTATIONS || type == COMBINATIONS;
+}
+
+int reduce_integer_operator(long long* values, int* values_length, char type){
+    long long right = 0;
+    if(type != OPERATOR_FACTORIAL && type != OPERATOR_NEGATE) right = values[--(*values_length)];
+    return integer_operator(type, values[*values_length - 1], right, &values[*values_length - 1]);
+}
+
+// The shunting yard of calculate_integer_expression. When 'integers' isn't NULL the NUMBER elements are read
+// from it instead of from expr->values e.g the answers of brackets that were calculated on their own.
+// 'operators' and 'values' need room for every element.
+int integer_expression(const struct Expression* expr, const long long* integers, char* operators, long long* values, long long* answer){
+    int operators_length = 0;
+    int values_length = 0;
+    int expect_value = TRUE;
+    char previous = 0;
+
+    for(int i = 0; i < expr->array_length; i++){
+        const char c = expr->types[i];
+
+        // calculate_math doesn't take 3!!, - -(3) or 5Y--2 either
+        const char before = previous;
+        previous = c;
+        if(c == OPERATOR_FACTORIAL && before == OPERATOR_FACTORIAL) return FALSE;
+        if(c == OPERATOR_NEGATE && !can_take_prefix(before, c)) return FALSE;
+
+        if(expect_value){
+            if(c == NUMBER){
+                if(integers != NULL){
+                    values[values_length++] = integers[i];
+                } else {
+                    if(!is_exact_integer(expr->values[i])) return FALSE;
+                    values[values_length++] = (long long) expr->values[i];
+                }
+                expect_value = FALSE;
+            } else if(c == BRACKET_OPEN || c == OPERATOR_NEGATE){
+                operators[operators_length++] = c;
+            } else {
+                return FALSE;
+            }
+            continue;
+        }
+
+        if(c == OPERATOR_FACTORIAL){
+            if(!reduce_integer_operator(values, &values_length, c)) return FALSE;
+        } else if(c == BRACKET_CLOSE){
+            while(operators_length > 0 && operators[operators_length - 1] != BRACKET_OPEN){
+                if(!reduce_integer_operator(values, &values_length, operators[--operators_length])) return FALSE;
+            }
+            if(operators_length == 0) return FALSE;
+            operators_length--;
+        } else if(is_integer_operator(c)){
+            const int precedence = operator_precedence(c);
+            while(operators_length > 0 && operators[operators_length - 1] != BRACKET_OPEN
+                && operator_precedence(operators[operators_length - 1]) >= precedence){
+                if(!reduce_integer_operator(values, &values_length, operators[--operators_length])) return FALSE;
+            }
+            operators[operators_length++] = c;
+            expect_value = TRUE;
+        } else {
+            return FALSE;
+        }
+    }
+    if(expect_value) return FALSE;
+
+    while(operators_length > 0){
+        const char c = operators[--operators_length];
+        if(c == BRACKET_OPEN) return FALSE;
+        if(!reduce_integer_operator(values, &values_length, c)) return FALSE;
+    }
+
+    *answer = values[0];
+    return TRUE;
+}
+
+// Expressions of only whole numbers, brackets and + - * ^ ! Y Z (and negative signs) calculated in 64 bit
+// integers with the same precedence as compile_expression so the answer is exact instead of being rounded
+// at every step. Gives FALSE for anything else, when a step doesn't fit in 64 bits or when the answer is 0
+// (a double answer could be -0), calql8r_eval then calculates the same tokens with doubles.
+int calculate_integer_expression(struct CalQl8r* ctx, const struct Expression* expr, long long* answer){
+    const int capacity = expr->array_length;
+    char* operators = (char *) arena_alloc(&ctx->arena, capacity);
+    long long* values = (long long *) arena_alloc(&ctx->arena, capacity * sizeof (long long));
+    if(operators == NULL || values == NULL) return FALSE;
+
+    long long value;
+    if(!integer_expression(expr, NULL, operators, values, &value) || value == 0) return FALSE;
+    *answer = value;
+    return TRUE;
+}
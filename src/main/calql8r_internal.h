@@ -0,0 +1,233 @@
+#ifndef CALQL8R_INTERNAL_H
+#define CALQL8R_INTERNAL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "calql8r.h"
+
+// define boolean
+#define TRUE  1
+#define FALSE 0
+
+// Any random characters that are not being used for anything
+#define NUMBER 'N'
+#define NUMBER_REMOVE 'M'
+#define DECIMAL_POINT '.'
+#define EXPONENT 'e'
+
+#define OPERATOR_ADD '+'
+#define OPERATOR_SUBSTRACT '-'
+#define OPERATOR_MULTPILY '*'
+#define OPERATOR_DIVIDE '/'
+#define OPERATOR_LOGx 'l'
+#define OPERATOR_POW '^'
+#define OPERATOR_ROOT 'r'
+#define OPERATOR_SIN 'S'
+#define OPERATOR_SINH 's'
+#define OPERATOR_COS 'C'
+#define OPERATOR_COSH 'c'
+#define OPERATOR_TAN 'T'
+#define OPERATOR_TANH 't'
+#define OPERATOR_LOG10 'L'
+#define OPERATOR_LN 'E'
+#define OPERATOR_FACTORIAL '!'
+#define PI 'p'
+#define BRACKET_OPEN '('
+#define BRACKET_CLOSE ')'
+#define PERMUTATIONS 'Y'
+#define COMBINATIONS 'Z'
+#define VARIABLE 'V'
+#define OPERATOR_NEGATE '~'
+#define SLOT_STORE '='
+#define SLOT_LOAD '$'
+
+// letters that are operators, functions or constants and can't be used in variable names
+#define RESERVED_LETTERS "SsCcTtLElrpYZe"
+
+// order of the passes of calculate_math, the first pass holds on to its values the tightest
+#define MATH_PASS_ORDER "!YZSsCcTtLE~l^r/*-+"
+
+#define FUNCTION_VALUE_DIRECTION_RIGHT 1
+#define FUNCTION_VALUE_DIRECTION_LEFT -1
+
+#define CAL_ELEMENT_ERROR '_'
+
+// biggest n where n! fits in 64 bits and where it still fits in a double
+#define EXACT_FACTORIAL_LIMIT 20
+#define FACTORIAL_LIMIT 170
+// whole numbers up to 2^53 are exact in a double
+#define EXACT_INTEGER_LIMIT 9007199254740992.0
+#define COMBINATIONS_STEP_LIMIT 1024
+
+// rows of calql8r_run_columns before a program is compiled into native code
+#define JIT_THRESHOLD 10000
+#define JIT_INTERPRETED 0
+#define JIT_COMPILING 1
+#define JIT_NATIVE 2
+#define JIT_FAILED 3
+
+// answer of the calculate_* functions, 'type' is NUMBER or CAL_ELEMENT_ERROR
+struct Element{
+    double value;
+    char type;
+};
+
+// The elements live in the arena of the context as two arrays so the passes that look for their
+// operator only go over the types, one byte per element. Element i is values[i] and types[i].
+// A VARIABLE keeps where its name starts in the text in its value.
+struct Expression{
+    double* values;
+    char* types;
+    int array_length;
+};
+
+// Memory for the calculations. It is malloc'd once and every allocation just moves 'used' along.
+// When an expression needs more than the block has, another block is added and on the next
+// reset all of them are swapped for one block big enough for everything, so once the biggest
+// expression has been seen the calculations don't touch the heap at all.
+struct ArenaBlock{
+    struct ArenaBlock* previous;
+    size_t capacity;
+    size_t used;
+};
+
+struct Arena{
+    struct ArenaBlock* block;
+    size_t heap_allocations;
+};
+
+struct CalQl8r{
+    struct Arena arena;
+
+    // numbers and operators of the expression being calculated
+    struct Expression tokens;
+
+    // NULL unless calql8r_set_stats was given somewhere to count
+    struct CalQl8rStats* stats;
+};
+
+// native code of a program, see calql8r_jit.c
+struct Jit;
+
+// Postfix (reverse polish) instructions. 'code' holds the element types,
+// NUMBER pushes the next value in 'constants', VARIABLE pushes the variable whose index is
+// the next value in 'constants' and every operator pops its values and pushes the answer.
+// e.g "1+2*x" is N N V * +
+// A value that is needed more than once is kept in a slot, SLOT_STORE copies the top of the stack
+// into the slot whose index is the next value in 'constants' and SLOT_LOAD pushes it again.
+// The slots come straight after the 'stack_size' values of the stack.
+struct CalQl8rProgram{
+    char* code;
+    double* constants;
+    int code_length;
+    int constants_length;
+    int stack_size;
+    int slots_length;
+    const char** variable_names;
+    int variables_length;
+
+    // rows calql8r_run_columns has calculated, after JIT_THRESHOLD the program is compiled into native code
+    atomic_size_t evaluations;
+    atomic_int jit_state;
+    _Atomic(struct Jit*) jit;
+};
+
+// Expression tree that programs are generated from. 'left' and 'right' are indexes into the nodes
+// of the tree or -1, functions and factorials keep their value in 'left'.
+// Identical sub trees are only stored once so a node can have more than one parent ('uses').
+struct Node{
+    double value;
+    int left;
+    int right;
+    int uses;
+    int slot;
+    char type;
+};
+
+struct Tree{
+    struct Node* nodes;
+    int nodes_length;
+    int capacity;
+    // open addressing table of node indexes for finding a node that already exists
+    int* table;
+    int table_mask;
+    int slots_length;
+};
+
+// arena
+void arena_init(struct Arena* arena);
+void* arena_alloc(struct Arena* arena, size_t size);
+void arena_reset(struct Arena* arena);
+void arena_free(struct Arena* arena);
+
+// tokenizing
+int is_whitespace(char c);
+int is_digit(char c);
+int is_variable_character(char c, int first);
+int parse_number(const char* text, size_t length, size_t* i, double* value);
+int lex_token(const char* text, size_t length, size_t* index, char prev, double* value, char* type);
+int lex_expression(const char* text, size_t length, struct Expression* expr, int capacity);
+int tokenize_expression(struct CalQl8r* ctx, const char* text, size_t length);
+
+// cache
+size_t trim_whitespaces(const char* text, size_t length, char* list);
+
+// calculations
+struct Element calculate_sin(double num);
+struct Element calculate_sinh(double num);
+struct Element calculate_cos(double num);
+struct Element calculate_cosh(double num);
+struct Element calculate_tan(double num);
+struct Element calculate_tanh(double num);
+struct Element calculate_log10(double num);
+struct Element calculate_ln(double num);
+struct Element calculate_e(double num);
+struct Element calculate_add(double num1, double num2);
+struct Element calculate_substract(double num1, double num2);
+struct Element calculate_multiply(double num1, double num2);
+struct Element calculate_divide(double num1, double num2);
+struct Element calculate_pow(double base, double exp);
+struct Element calculate_root(double num1, double num2);
+struct Element calculate_log(double base, double raised);
+struct Element calculate_permutation(double n1, double r1);
+struct Element calculate_combinations(double n1, double r1);
+struct Element calculate_factorial(double num);
+int exact_permutation(double n, double r, unsigned long long* answer);
+int exact_combinations(double n, double r, unsigned long long* answer);
+struct Element calculate_negate(double num);
+int calculate_math(struct Expression* expr);
+int calculate_math_stats(struct Expression* expr, struct CalQl8rStats* stats);
+int calculate_all_brackets(struct Expression* expression, struct CalQl8rStats* stats);
+int can_take_prefix(char before, char prefix);
+int calculate_math_order(struct Expression* expr);
+int check_expression_order(struct Expression* expression);
+
+// whole numbers
+int is_exact_integer(double value);
+int integer_pow(long long base, long long exponent, long long* answer);
+int integer_operator(char type, long long a, long long b, long long* answer);
+int integer_expression(const struct Expression* expr, const long long* integers, char* operators, long long* values, long long* answer);
+int calculate_integer_expression(struct CalQl8r* ctx, const struct Expression* expr, long long* answer);
+
+// compiling
+int operator_precedence(char type);
+int is_function_operator(char type);
+int compile_expression(const struct Expression* expr, char* operators, int* values, struct Tree* tree, int* root);
+int run_program(const struct CalQl8rProgram* program, double* stack, double* result);
+
+// expression tree
+int calculate_operator(char type, double num1, double num2, double* answer);
+int tree_init(struct Tree* tree, struct Arena* arena, int capacity);
+int make_node(struct Tree* tree, char type, double value, int left, int right);
+int generate_program(struct Tree* tree, int root, struct Arena* arena, struct CalQl8rProgram* program);
+
+// columns
+int column_operator(char type, double* restrict a, const double* restrict b, unsigned char* restrict errors, int n);
+
+// native code
+void jit_init(struct CalQl8rProgram* program);
+void jit_free(struct CalQl8rProgram* program);
+int jit_run_columns(struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results);
+int run_columns_interpreted(const struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results);
+
+#endif
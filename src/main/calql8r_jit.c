@@ -0,0 +1,462 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+// native code is only written for x86-64 with the System V calling convention (Linux, macOS)
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(CALQL8R_NO_JIT)
+#define JIT_AVAILABLE
+#include <sys/mman.h>
+#endif
+
+// the stack and slots of the program live in the frame of the native code, very deep programs stay interpreted
+#define JIT_MAX_VALUES 4096
+// longest instruction of the program is the log of two values with its checks
+#define JIT_BYTES_PER_INSTRUCTION 160
+#define JIT_PROLOGUE_BYTES 128
+
+// constants in front of the code, 'rbp' points at them
+#define POOL_SIGN_MASK 0
+#define POOL_ZERO 16
+#define POOL_ONE 24
+#define POOL_LN_DIVISOR 32
+#define POOL_NAN 40
+#define POOL_PROGRAM 48
+
+// registers
+#define XMM0 0
+#define XMM1 1
+#define XMM2 2
+#define RBX 3
+#define RSP 4
+#define RBP 5
+
+// SSE2 instructions as (prefix, opcode)
+#define SCALAR 0xF2
+#define PACKED 0x66
+#define MOVSD_LOAD 0x10
+#define MOVSD_STORE 0x11
+#define ADDSD 0x58
+#define MULSD 0x59
+#define SUBSD 0x5C
+#define DIVSD 0x5E
+#define MOVAPD 0x28
+#define XORPD 0x57
+#define UCOMISD 0x2E
+
+// conditions of the 0F 8x jumps
+#define JUMP_BELOW 0x82
+#define JUMP_NOT_BELOW 0x83
+#define JUMP_EQUAL 0x84
+#define JUMP_NOT_EQUAL 0x85
+#define JUMP_BELOW_OR_EQUAL 0x86
+
+struct Jit{
+    // calculates rows [row, end) of the columns into 'results', rows that give an error get NAN
+    void (*run)(const double* const* columns, size_t row, size_t end, double* results);
+    void* memory;
+    size_t size;
+};
+
+// the operators that go through calculate_math's functions, give TRUE when the values gave an error
+int jit_call_1(double a, struct Element (*function) (double), double* answer){
+    const struct Element ele = function(a);
+    *answer = ele.value;
+    return ele.type == CAL_ELEMENT_ERROR;
+}
+
+int jit_call_2(double a, double b, struct Element (*function) (double, double), double* answer){
+    const struct Element ele = function(a, b);
+    *answer = ele.value;
+    return ele.type == CAL_ELEMENT_ERROR;
+}
+
+#ifdef JIT_AVAILABLE
+
+struct Emitter{
+    unsigned char* code;
+    size_t length;
+    // places of the jumps to the error code, they are filled in once it is written
+    int* errors;
+    int errors_length;
+};
+
+void emit_byte(struct Emitter* emitter, unsigned int byte){
+    emitter->code[emitter->length++] = (unsigned char) byte;
+}
+
+void emit_u32(struct Emitter* emitter, unsigned int value){
+    for(int i = 0; i < 4; i++) emit_byte(emitter, (value >> (i * 8)) & 0xFF);
+}
+
+void emit_u64(struct Emitter* emitter, unsigned long long value){
+    for(int i = 0; i < 8; i++) emit_byte(emitter, (unsigned int) (value >> (i * 8)) & 0xFF);
+}
+
+// e.g movsd xmm0, [rsp + 16]
+void emit_sse_memory(struct Emitter* emitter, unsigned int prefix, unsigned int opcode, int reg, int base, int displacement){
+    emit_byte(emitter, prefix);
+    emit_byte(emitter, 0x0F);
+    emit_byte(emitter, opcode);
+    emit_byte(emitter, 0x80 | (reg << 3) | base);
+    if(base == RSP) emit_byte(emitter, 0x24);
+    emit_u32(emitter, (unsigned int) displacement);
+}
+
+// e.g addsd xmm1, xmm0
+void emit_sse_register(struct Emitter* emitter, unsigned int prefix, unsigned int opcode, int reg, int rm){
+    emit_byte(emitter, prefix);
+    emit_byte(emitter, 0x0F);
+    emit_byte(emitter, opcode);
+    emit_byte(emitter, 0xC0 | (reg << 3) | rm);
+}
+
+void emit_call(struct Emitter* emitter, uintptr_t function){
+    // mov rax, function; call rax
+    emit_byte(emitter, 0x48);
+    emit_byte(emitter, 0xB8);
+    emit_u64(emitter, function);
+    emit_byte(emitter, 0xFF);
+    emit_byte(emitter, 0xD0);
+}
+
+void emit_jump_to_error(struct Emitter* emitter, unsigned int condition){
+    emit_byte(emitter, 0x0F);
+    emit_byte(emitter, condition);
+    emitter->errors[emitter->errors_length++] = (int) emitter->length;
+    emit_u32(emitter, 0);
+}
+
+// the same check as calculate_math's 'value <= 0', NAN is not an error
+void emit_error_if_not_positive(struct Emitter* emitter, int reg){
+    emit_sse_memory(emitter, PACKED, UCOMISD, reg, RBP, POOL_ZERO);
+    // jp over the jump, unordered is NAN
+    emit_byte(emitter, 0x7A);
+    emit_byte(emitter, 6);
+    emit_jump_to_error(emitter, JUMP_BELOW_OR_EQUAL);
+}
+
+// the value on the left of a two value operator into xmm1 and the answer back into xmm0
+void emit_arithmetic(struct Emitter* emitter, unsigned int opcode, int left){
+    emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM1, RSP, left);
+    emit_sse_register(emitter, SCALAR, opcode, XMM1, XMM0);
+    emit_sse_register(emitter, PACKED, MOVAPD, XMM0, XMM1);
+}
+
+// helper call that writes its answer into the frame at 'answer', errors jump away
+void emit_call_helper(struct Emitter* emitter, uintptr_t helper, uintptr_t function, int answer){
+    // mov rdi, function; lea rsi, [rsp + answer]
+    emit_byte(emitter, 0x48);
+    emit_byte(emitter, 0xBF);
+    emit_u64(emitter, function);
+    emit_byte(emitter, 0x48);
+    emit_byte(emitter, 0x8D);
+    emit_byte(emitter, 0xB4);
+    emit_byte(emitter, 0x24);
+    emit_u32(emitter, (unsigned int) answer);
+    emit_call(emitter, helper);
+
+    // test eax, eax
+    emit_byte(emitter, 0x85);
+    emit_byte(emitter, 0xC0);
+    emit_jump_to_error(emitter, JUMP_NOT_EQUAL);
+    emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RSP, answer);
+}
+
+// One row of the program. The top of the stack is kept in xmm0 and the values under it in the frame at
+// [rsp + 8 * index], the slots come after the stack. Gives FALSE for an instruction it doesn't know
+int emit_program(struct Emitter* emitter, const struct CalQl8rProgram* program){
+    int depth = 0;
+    int constant = 0;
+    const int slots = program->stack_size * 8;
+
+    for(int i = 0; i < program->code_length; i++){
+        const char c = program->code[i];
+
+        if(c == NUMBER || c == VARIABLE || c == SLOT_LOAD){
+            // the old top goes into the frame
+            if(depth > 0) emit_sse_memory(emitter, SCALAR, MOVSD_STORE, XMM0, RSP, (depth - 1) * 8);
+            depth++;
+
+            const int index = (int) program->constants[constant];
+            if(c == NUMBER){
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RBP, POOL_PROGRAM + constant * 8);
+            } else if(c == SLOT_LOAD){
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RSP, slots + index * 8);
+            } else {
+                // mov rax, [rbx + index * 8]; movsd xmm0, [rax + r13 * 8]
+                emit_byte(emitter, 0x48);
+                emit_byte(emitter, 0x8B);
+                emit_byte(emitter, 0x83);
+                emit_u32(emitter, (unsigned int) index * 8);
+                emit_byte(emitter, SCALAR);
+                emit_byte(emitter, 0x42);
+                emit_byte(emitter, 0x0F);
+                emit_byte(emitter, MOVSD_LOAD);
+                emit_byte(emitter, 0x04);
+                emit_byte(emitter, 0xE8);
+            }
+            constant++;
+            continue;
+        }
+        if(c == SLOT_STORE){
+            emit_sse_memory(emitter, SCALAR, MOVSD_STORE, XMM0, RSP, slots + (int) program->constants[constant++] * 8);
+            continue;
+        }
+
+        // two value operators take the value in the frame on the left of xmm0
+        if(c != OPERATOR_FACTORIAL && !is_function_operator(c)) depth--;
+        const int left = (depth - 1) * 8;
+
+        switch (c) {
+            case OPERATOR_ADD: emit_arithmetic(emitter, ADDSD, left); break;
+            case OPERATOR_SUBSTRACT: emit_arithmetic(emitter, SUBSD, left); break;
+            case OPERATOR_MULTPILY: emit_arithmetic(emitter, MULSD, left); break;
+            case OPERATOR_DIVIDE:
+                emit_sse_memory(emitter, PACKED, UCOMISD, XMM0, RBP, POOL_ZERO);
+                emit_byte(emitter, 0x7A);
+                emit_byte(emitter, 6);
+                emit_jump_to_error(emitter, JUMP_EQUAL);
+                emit_arithmetic(emitter, DIVSD, left);
+                break;
+            case OPERATOR_NEGATE:
+                emit_sse_memory(emitter, PACKED, XORPD, XMM0, RBP, POOL_SIGN_MASK);
+                break;
+            case OPERATOR_POW:
+                emit_sse_register(emitter, PACKED, MOVAPD, XMM1, XMM0);
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RSP, left);
+                emit_call(emitter, (uintptr_t) pow);
+                break;
+            case OPERATOR_ROOT:
+                // pow(right, 1 / left)
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM1, RSP, left);
+                emit_error_if_not_positive(emitter, XMM1);
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM2, RBP, POOL_ONE);
+                emit_sse_register(emitter, SCALAR, DIVSD, XMM2, XMM1);
+                emit_sse_register(emitter, PACKED, MOVAPD, XMM1, XMM2);
+                emit_call(emitter, (uintptr_t) pow);
+                break;
+            case OPERATOR_LOGx:
+                // log(right) / log(left), log(right) waits in the frame where the right value was
+                emit_error_if_not_positive(emitter, XMM0);
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM1, RSP, left);
+                emit_error_if_not_positive(emitter, XMM1);
+                emit_call(emitter, (uintptr_t) log);
+                emit_sse_memory(emitter, SCALAR, MOVSD_STORE, XMM0, RSP, left + 8);
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RSP, left);
+                emit_call(emitter, (uintptr_t) log);
+                emit_sse_register(emitter, PACKED, MOVAPD, XMM1, XMM0);
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RSP, left + 8);
+                emit_sse_register(emitter, SCALAR, DIVSD, XMM0, XMM1);
+                break;
+            case OPERATOR_LOG10:
+                emit_error_if_not_positive(emitter, XMM0);
+                emit_call(emitter, (uintptr_t) log10);
+                break;
+            case OPERATOR_LN:
+                emit_error_if_not_positive(emitter, XMM0);
+                emit_call(emitter, (uintptr_t) log);
+                emit_sse_memory(emitter, SCALAR, DIVSD, XMM0, RBP, POOL_LN_DIVISOR);
+                break;
+            case OPERATOR_SIN: emit_call(emitter, (uintptr_t) sin); break;
+            case OPERATOR_SINH: emit_call(emitter, (uintptr_t) sinh); break;
+            case OPERATOR_COS: emit_call(emitter, (uintptr_t) cos); break;
+            case OPERATOR_COSH: emit_call(emitter, (uintptr_t) cosh); break;
+            case OPERATOR_TAN: emit_call(emitter, (uintptr_t) tan); break;
+            case OPERATOR_TANH: emit_call(emitter, (uintptr_t) tanh); break;
+            case OPERATOR_FACTORIAL:
+                emit_call_helper(emitter, (uintptr_t) jit_call_1, (uintptr_t) calculate_factorial, left);
+                break;
+            case PERMUTATIONS:
+            case COMBINATIONS:
+                emit_sse_register(emitter, PACKED, MOVAPD, XMM1, XMM0);
+                emit_sse_memory(emitter, SCALAR, MOVSD_LOAD, XMM0, RSP, left);
+                emit_call_helper(emitter, (uintptr_t) jit_call_2,
+                    c == PERMUTATIONS ? (uintptr_t) calculate_permutation : (uintptr_t) calculate_combinations, left);
+                break;
+            default: return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// push rbx, rbp, r12 - r15 leaves rsp 8 off 16 so the frame makes up for it before any call
+int jit_frame_size(const struct CalQl8rProgram* program){
+    const int values = program->stack_size + program->slots_length;
+    return (values * 8 + 15) / 16 * 16 + 8;
+}
+
+int jit_compile(const struct CalQl8rProgram* program, struct Jit* jit){
+    if(program->stack_size + program->slots_length > JIT_MAX_VALUES) return FALSE;
+
+    const size_t pool_size = POOL_PROGRAM + (size_t) program->constants_length * 8;
+    const size_t code_size = JIT_PROLOGUE_BYTES + (size_t) program->code_length * JIT_BYTES_PER_INSTRUCTION;
+    const size_t size = pool_size + code_size;
+
+    struct Emitter emitter;
+    emitter.errors = (int *) malloc(sizeof (int) * (program->code_length * 2 + 1));
+    if(emitter.errors == NULL) return FALSE;
+    emitter.errors_length = 0;
+
+    unsigned char* memory = (unsigned char *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED){
+        free(emitter.errors);
+        return FALSE;
+    }
+
+    // the page is 16 byte aligned for xorpd
+    const unsigned long long sign_mask[2] = { 0x8000000000000000ULL, 0 };
+    const double pool[] = { 0, 1, log(exp(1)), NAN };
+    memcpy(memory + POOL_SIGN_MASK, sign_mask, sizeof sign_mask);
+    memcpy(memory + POOL_ZERO, pool, sizeof pool);
+    memcpy(memory + POOL_PROGRAM, program->constants, (size_t) program->constants_length * 8);
+
+    emitter.code = memory + pool_size;
+    emitter.length = 0;
+    const int frame = jit_frame_size(program);
+
+    // push rbx, rbp, r12, r13, r14, r15; sub rsp, frame
+    static const unsigned char prologue[] = { 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x48, 0x81, 0xEC };
+    memcpy(emitter.code, prologue, sizeof prologue);
+    emitter.length = sizeof prologue;
+    emit_u32(&emitter, (unsigned int) frame);
+
+    // rbx = columns, r13 = row, r14 = end, r12 = results, rbp = constants
+    static const unsigned char arguments[] = { 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF5, 0x49, 0x89, 0xD6, 0x49, 0x89, 0xCC, 0x48, 0xBD };
+    memcpy(emitter.code + emitter.length, arguments, sizeof arguments);
+    emitter.length += sizeof arguments;
+    emit_u64(&emitter, (uintptr_t) memory);
+
+    // cmp r13, r14; jae done
+    emit_byte(&emitter, 0x4D);
+    emit_byte(&emitter, 0x39);
+    emit_byte(&emitter, 0xF5);
+    emit_byte(&emitter, 0x0F);
+    emit_byte(&emitter, JUMP_NOT_BELOW);
+    const size_t skip_loop = emitter.length;
+    emit_u32(&emitter, 0);
+
+    const size_t loop = emitter.length;
+    if(!emit_program(&emitter, program)){
+        munmap(memory, size);
+        free(emitter.errors);
+        return FALSE;
+    }
+
+    // movsd [r12 + r13 * 8], xmm0
+    static const unsigned char store_result[] = { SCALAR, 0x43, 0x0F, MOVSD_STORE, 0x04, 0xEC };
+    memcpy(emitter.code + emitter.length, store_result, sizeof store_result);
+    emitter.length += sizeof store_result;
+
+    // next: inc r13; cmp r13, r14; jb loop
+    const size_t next = emitter.length;
+    static const unsigned char next_row[] = { 0x49, 0xFF, 0xC5, 0x4D, 0x39, 0xF5, 0x0F, JUMP_BELOW };
+    memcpy(emitter.code + emitter.length, next_row, sizeof next_row);
+    emitter.length += sizeof next_row;
+    emit_u32(&emitter, (unsigned int) (loop - (emitter.length + 4)));
+
+    // done: add rsp, frame; pop r15, r14, r13, r12, rbp, rbx; ret
+    const size_t done = emitter.length;
+    emit_byte(&emitter, 0x48);
+    emit_byte(&emitter, 0x81);
+    emit_byte(&emitter, 0xC4);
+    emit_u32(&emitter, (unsigned int) frame);
+    static const unsigned char epilogue[] = { 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3 };
+    memcpy(emitter.code + emitter.length, epilogue, sizeof epilogue);
+    emitter.length += sizeof epilogue;
+
+    // error: the row is NAN, movsd xmm0, [rbp + NAN]; movsd [r12 + r13 * 8], xmm0; jmp next
+    const size_t error = emitter.length;
+    emit_sse_memory(&emitter, SCALAR, MOVSD_LOAD, XMM0, RBP, POOL_NAN);
+    memcpy(emitter.code + emitter.length, store_result, sizeof store_result);
+    emitter.length += sizeof store_result;
+    emit_byte(&emitter, 0xE9);
+    emit_u32(&emitter, (unsigned int) (next - (emitter.length + 4)));
+
+    // the jumps are relative to the end of their 4 bytes
+    const unsigned int skip = (unsigned int) (done - (skip_loop + 4));
+    memcpy(emitter.code + skip_loop, &skip, 4);
+    for(int i = 0; i < emitter.errors_length; i++){
+        const unsigned int offset = (unsigned int) (error - (emitter.errors[i] + 4));
+        memcpy(emitter.code + emitter.errors[i], &offset, 4);
+    }
+    free(emitter.errors);
+
+    // never writable and executable at the same time
+    if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0){
+        munmap(memory, size);
+        return FALSE;
+    }
+
+    void* entry = memory + pool_size;
+    memcpy(&jit->run, &entry, sizeof entry);
+    jit->memory = memory;
+    jit->size = size;
+    return TRUE;
+}
+
+void jit_release(struct Jit* jit){
+    munmap(jit->memory, jit->size);
+}
+
+#else
+
+int jit_compile(const struct CalQl8rProgram* program, struct Jit* jit){
+    (void) program;
+    (void) jit;
+    return FALSE;
+}
+
+void jit_release(struct Jit* jit){
+    (void) jit;
+}
+
+#endif
+
+void jit_init(struct CalQl8rProgram* program){
+    atomic_init(&program->jit, NULL);
+    atomic_init(&program->jit_state, JIT_INTERPRETED);
+    atomic_init(&program->evaluations, 0);
+}
+
+void jit_free(struct CalQl8rProgram* program){
+    struct Jit* jit = atomic_load(&program->jit);
+    if(jit == NULL) return;
+    jit_release(jit);
+    free(jit);
+}
+
+int calql8r_program_jit(struct CalQl8rProgram* program){
+    // only one thread compiles, the others keep interpreting until the code is there
+    int expected = JIT_INTERPRETED;
+    if(!atomic_compare_exchange_strong(&program->jit_state, &expected, JIT_COMPILING)){
+        return atomic_load_explicit(&program->jit, memory_order_acquire) != NULL;
+    }
+
+    struct Jit* jit = (struct Jit *) malloc(sizeof (struct Jit));
+    if(jit == NULL || !jit_compile(program, jit)){
+        free(jit);
+        atomic_store(&program->jit_state, JIT_FAILED);
+        return FALSE;
+    }
+
+    atomic_store_explicit(&program->jit, jit, memory_order_release);
+    atomic_store(&program->jit_state, JIT_NATIVE);
+    return TRUE;
+}
+
+int jit_run_columns(struct CalQl8rProgram* program, const double* const* columns, size_t rows, double* results){
+    const struct Jit* jit = atomic_load_explicit(&program->jit, memory_order_acquire);
+    if(jit == NULL){
+        // count the rows while it is still interpreted
+        if(atomic_load_explicit(&program->jit_state, memory_order_relaxed) != JIT_INTERPRETED) return FALSE;
+        if(atomic_fetch_add_explicit(&program->evaluations, rows, memory_order_relaxed) + rows < JIT_THRESHOLD) return FALSE;
+        if(!calql8r_program_jit(program)) return FALSE;
+        jit = atomic_load_explicit(&program->jit, memory_order_acquire);
+    }
+
+    jit->run(columns, 0, rows, results);
+    return TRUE;
+}
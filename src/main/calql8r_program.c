@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+#define PRECEDENCE_NONE 0
+#define PRECEDENCE_FUNCTION 8
+#define RUN_STACK_SIZE 256
+
+// how tightly an operator holds on to its values.
+// follows the order of the passes in calculate_math, the last pass holds the tightest
+int operator_precedence(char type){
+    switch (type) {
+        case OPERATOR_ADD: return 1;
+        case OPERATOR_SUBSTRACT: return 2;
+        case OPERATOR_MULTPILY: return 3;
+        case OPERATOR_DIVIDE: return 4;
+        case OPERATOR_ROOT: return 5;
+        case OPERATOR_POW: return 6;
+        case OPERATOR_LOGx: return 7;
+        case OPERATOR_SIN:
+        case OPERATOR_SINH:
+        case OPERATOR_COS:
+        case OPERATOR_COSH:
+        case OPERATOR_TAN:
+        case OPERATOR_TANH:
+        case OPERATOR_LOG10:
+        case OPERATOR_LN:
+        case OPERATOR_NEGATE:
+            return PRECEDENCE_FUNCTION;
+        case COMBINATIONS: return 9;
+        case PERMUTATIONS: return 10;
+        default: return PRECEDENCE_NONE;
+    }
+}
+
+// functions take the value on their right e.g S2
+int is_function_operator(char type){
+    return operator_precedence(type) == PRECEDENCE_FUNCTION;
+}
+
+// pops the values of the operator and pushes the node of the operator in their place
+int reduce_operator(struct Tree* tree, int* values, int* values_length, char type){
+    // functions and factorials replace the top value, everything else takes two values and leaves one
+    int right = -1;
+    if(type != OPERATOR_FACTORIAL && !is_function_operator(type)) right = values[--(*values_length)];
+
+    const int node = make_node(tree, type, 0, values[*values_length - 1], right);
+    if(node < 0) return CAL_ERROR_MEMORY;
+    values[*values_length - 1] = node;
+    return CAL_OK;
+}
+
+// Shunting yard over the tokens into the expression tree. Brackets and precedence are resolved in one pass
+// so the program never has to search for the inner most brackets again.
+// 'operators' and 'values' need room for every element of the expression
+int compile_expression(const struct Expression* expr, char* operators, int* values, struct Tree* tree, int* root){
+    int operators_length = 0;
+    int values_length = 0;
+    int expect_value = TRUE;
+    int status = CAL_OK;
+    char previous = 0;
+
+    for(int i = 0; i < expr->array_length && status == CAL_OK; i++){
+        const char c = expr->types[i];
+
+        // calculate_math only applies a function to a plain value so a function can only follow an operator
+        // or another function when its pass runs first e.g tc12 and 2^S1 work but Sc8 and 8ZS2 need brackets
+        if(c == OPERATOR_FACTORIAL && previous == OPERATOR_FACTORIAL) return CAL_ERROR_SYNTAX;
+        if(is_function_operator(c) && !can_take_prefix(previous, c)) return CAL_ERROR_SYNTAX;
+        previous = c;
+
+        if(expect_value){
+            if(c == NUMBER || c == VARIABLE){
+                const int node = make_node(tree, c, expr->values[i], -1, -1);
+                if(node < 0) return CAL_ERROR_MEMORY;
+                values[values_length++] = node;
+                expect_value = FALSE;
+            } else if(c == BRACKET_OPEN || is_function_operator(c)){
+                operators[operators_length++] = c;
+            } else {
+                return CAL_ERROR_SYNTAX;
+            }
+            continue;
+        }
+
+        if(c == OPERATOR_FACTORIAL){
+            status = reduce_operator(tree, values, &values_length, c);
+        } else if(c == BRACKET_CLOSE){
+            while(status == CAL_OK && operators_length > 0 && operators[operators_length - 1] != BRACKET_OPEN){
+                status = reduce_operator(tree, values, &values_length, operators[--operators_length]);
+            }
+
+            // more close brackets than open ones
+            if(operators_length == 0) return CAL_ERROR_SYNTAX;
+            operators_length--;
+        } else {
+            const int precedence = operator_precedence(c);
+            if(precedence == PRECEDENCE_NONE || precedence == PRECEDENCE_FUNCTION) return CAL_ERROR_SYNTAX;
+
+            // everything is left to right e.g 2^3^2 is (2^3)^2
+            while(status == CAL_OK && operators_length > 0 && operators[operators_length - 1] != BRACKET_OPEN
+                && operator_precedence(operators[operators_length - 1]) >= precedence){
+                status = reduce_operator(tree, values, &values_length, operators[--operators_length]);
+            }
+            operators[operators_length++] = c;
+            expect_value = TRUE;
+        }
+    }
+    if(status != CAL_OK) return status;
+
+    // expression ends with an operator or is empty
+    if(expect_value) return CAL_ERROR_SYNTAX;
+
+    while(operators_length > 0 && status == CAL_OK){
+        const char c = operators[--operators_length];
+
+        // an open bracket was never closed
+        if(c == BRACKET_OPEN) return CAL_ERROR_SYNTAX;
+        status = reduce_operator(tree, values, &values_length, c);
+    }
+
+    *root = values[0];
+    return status;
+}
+
+// gives every VARIABLE element the index of its name in the value (instead of where the name starts in 'text')
+// and returns how many names there are. 'names' needs room for every element, 'names_size' is the room needed to copy the names.
+int number_variables(struct Expression* expr, const char* text, size_t length, const char** names, unsigned short* name_lengths, size_t* names_size){
+    int count = 0;
+    *names_size = 0;
+    for(int i = 0; i < expr->array_length; i++){
+        if(expr->types[i] != VARIABLE) continue;
+
+        // the lexer already made sure the name fits in an unsigned short
+        const size_t start = (size_t) expr->values[i];
+        size_t end = start;
+        while(end < length && is_variable_character(text[end], FALSE)) end++;
+        const char* name = text + start;
+        const unsigned short name_length = (unsigned short) (end - start);
+
+        int index = 0;
+        while(index < count && !(name_lengths[index] == name_length && memcmp(names[index], name, name_length) == 0)) index++;
+        if(index == count){
+            names[count] = name;
+            name_lengths[count++] = name_length;
+            *names_size += name_length + 1;
+        }
+        expr->values[i] = index;
+    }
+    return count;
+}
+
+// compile_expression rejects the same text as calql8r_eval but can't always tell which error calql8r_eval gives,
+// the passes of calculate_math over the types of the elements can e.g () is a math error. A variable is a value
+int expression_order_error(struct CalQl8r* ctx, const struct Expression* expr){
+    struct Expression order;
+    order.values = (double *) arena_alloc(&ctx->arena, expr->array_length * sizeof (double));
+    order.types = (char *) arena_alloc(&ctx->arena, expr->array_length);
+    order.array_length = expr->array_length;
+    if(order.values == NULL || order.types == NULL) return CAL_ERROR_MEMORY;
+
+    for(int i = 0; i < expr->array_length; i++) order.types[i] = expr->types[i] == VARIABLE ? NUMBER : expr->types[i];
+    const int status = check_expression_order(&order);
+    return status != CAL_OK ? status : CAL_ERROR_SYNTAX;
+}
+
+int calql8r_compile(struct CalQl8r* ctx, const char* text, size_t length, struct CalQl8rProgram** program){
+    int status = tokenize_expression(ctx, text, length);
+    if(status != CAL_OK) return status;
+    struct Expression* expr = &ctx->tokens;
+
+    const int capacity = expr->array_length;
+    char* operators = (char *) arena_alloc(&ctx->arena, capacity);
+    int* values = (int *) arena_alloc(&ctx->arena, capacity * sizeof (int));
+    const char** names = (const char **) arena_alloc(&ctx->arena, capacity * sizeof (const char*));
+    unsigned short* name_lengths = (unsigned short *) arena_alloc(&ctx->arena, capacity * sizeof (unsigned short));
+    if(operators == NULL || values == NULL || names == NULL || name_lengths == NULL) return CAL_ERROR_MEMORY;
+
+    size_t names_size = 0;
+    const int variables_length = number_variables(expr, text, length, names, name_lengths, &names_size);
+
+    struct Tree tree;
+    int root = 0;
+    status = tree_init(&tree, &ctx->arena, capacity);
+    if(status == CAL_OK) status = compile_expression(expr, operators, values, &tree, &root);
+    if(status == CAL_ERROR_SYNTAX) status = expression_order_error(ctx, expr);
+    if(status != CAL_OK) return status;
+
+    // every node is written once, kept in a slot at most once and each of its two values is
+    // at most one more instruction to load again so allocate everything at once
+    const int code_size = tree.nodes_length * 3 + 1;
+    struct CalQl8rProgram* compiled = (struct CalQl8rProgram*) malloc(sizeof (struct CalQl8rProgram)
+        + code_size * sizeof (double) + variables_length * sizeof (const char*) + code_size + names_size);
+    if(compiled == NULL) return CAL_ERROR_MEMORY;
+    compiled->constants = (double *) (compiled + 1);
+    compiled->variable_names = (const char **) (compiled->constants + code_size);
+    compiled->code = (char *) (compiled->variable_names + variables_length);
+    compiled->variables_length = variables_length;
+    jit_init(compiled);
+
+    // copy the names so the program doesn't need the text anymore
+    char* name_copy = compiled->code + code_size;
+    for(int i = 0; i < variables_length; i++){
+        memcpy(name_copy, names[i], name_lengths[i]);
+        name_copy[name_lengths[i]] = '\0';
+        compiled->variable_names[i] = name_copy;
+        name_copy += name_lengths[i] + 1;
+    }
+
+    status = generate_program(&tree, root, &ctx->arena, compiled);
+    if(status != CAL_OK){
+        free(compiled);
+        return status;
+    }
+
+    *program = compiled;
+    return CAL_OK;
+}
+
+int calql8r_program_variables(const struct CalQl8rProgram* program){
+    return program->variables_length;
+}
+
+const char* calql8r_program_variable(const struct CalQl8rProgram* program, int index){
+    if(index < 0 || index >= program->variables_length) return NULL;
+    return program->variable_names[index];
+}
+
+int calql8r_program_variable_index(const struct CalQl8rProgram* program, const char* name){
+    for(int i = 0; i < program->variables_length; i++){
+        if(strcmp(program->variable_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+// NUMBER with as few digits as still give exactly the same value
+int format_number(char* buffer, size_t size, const char* separator, double value){
+    char digits[32];
+    snprintf(digits, sizeof digits, "%.15g", value);
+    if(strtod(digits, NULL) != value && !isnan(value)) snprintf(digits, sizeof digits, "%.17g", value);
+    return snprintf(buffer, size, "%s%s", separator, digits);
+}
+
+int calql8r_program_dump(const struct CalQl8rProgram* program, char* buffer, size_t size){
+    size_t length = 0;
+    const double* constant = program->constants;
+    if(size > 0) buffer[0] = '\0';
+
+    for(int i = 0; i < program->code_length; i++){
+        char* end = length < size ? buffer + length : NULL;
+        const size_t room = length < size ? size - length : 0;
+        const char* separator = i == 0 ? "" : " ";
+        const char c = program->code[i];
+
+        int written;
+        if(c == NUMBER) written = format_number(end, room, separator, *constant++);
+        else if(c == VARIABLE) written = snprintf(end, room, "%s%s", separator, program->variable_names[(int) *constant++]);
+        else if(c == SLOT_STORE) written = snprintf(end, room, "%s=t%d", separator, (int) *constant++);
+        else if(c == SLOT_LOAD) written = snprintf(end, room, "%st%d", separator, (int) *constant++);
+        else written = snprintf(end, room, "%s%c", separator, c);
+
+        if(written < 0) return CAL_ERROR_SYNTAX;
+        length += written;
+    }
+    return (int) length;
+}
+
+void calql8r_program_free(struct CalQl8rProgram* program){
+    jit_free(program);
+    free(program);
+}
+
+int calql8r_run(const struct CalQl8rProgram* program, double* result){
+    double local_stack[RUN_STACK_SIZE];
+    double* stack = local_stack;
+
+    // only very deep expressions need a stack from the heap, the slots come after the stack
+    const int size = program->stack_size + program->slots_length;
+    if(size > RUN_STACK_SIZE){
+        stack = (double *) malloc(sizeof (double) * size);
+        if(stack == NULL) return CAL_ERROR_MEMORY;
+    }
+
+    int status = run_program(program, stack, result);
+    if(stack != local_stack) free(stack);
+    return status;
+}
+
+int run_program(const struct CalQl8rProgram* program, double* stack, double* result){
+    int top = 0;
+    const double* constant = program->constants;
+    double* slots = stack + program->stack_size;
+
+    for(int i = 0; i < program->code_length; i++){
+        struct Element ele;
+        switch (program->code[i]) {
+            case NUMBER:
+                stack[top++] = *constant++;
+                continue;
+            case SLOT_STORE:
+                slots[(int) *constant++] = stack[top - 1];
+                continue;
+            case SLOT_LOAD:
+                stack[top++] = slots[(int) *constant++];
+                continue;
+
+            // basic arithmitic straight on the stack
+            case OPERATOR_ADD:
+                top--;
+                stack[top - 1] += stack[top];
+                continue;
+            case OPERATOR_SUBSTRACT:
+                top--;
+                stack[top - 1] -= stack[top];
+                continue;
+            case OPERATOR_MULTPILY:
+                top--;
+                stack[top - 1] *= stack[top];
+                continue;
+            case OPERATOR_DIVIDE:
+                top--;
+                if(stack[top] == 0) return CAL_ERROR_SYNTAX;
+                stack[top - 1] /= stack[top];
+                continue;
+
+            // everything else goes through the same functions as calculate_math
+            case OPERATOR_POW: top--; ele = calculate_pow(stack[top - 1], stack[top]); break;
+            case OPERATOR_ROOT: top--; ele = calculate_root(stack[top - 1], stack[top]); break;
+            case OPERATOR_LOGx: top--; ele = calculate_log(stack[top - 1], stack[top]); break;
+            case PERMUTATIONS: top--; ele = calculate_permutation(stack[top - 1], stack[top]); break;
+            case COMBINATIONS: top--; ele = calculate_combinations(stack[top - 1], stack[top]); break;
+            case OPERATOR_FACTORIAL: ele = calculate_factorial(stack[top - 1]); break;
+            case OPERATOR_SIN: ele = calculate_sin(stack[top - 1]); break;
+            case OPERATOR_SINH: ele = calculate_sinh(stack[top - 1]); break;
+            case OPERATOR_COS: ele = calculate_cos(stack[top - 1]); break;
+            case OPERATOR_COSH: ele = calculate_cosh(stack[top - 1]); break;
+            case OPERATOR_TAN: ele = calculate_tan(stack[top - 1]); break;
+            case OPERATOR_TANH: ele = calculate_tanh(stack[top - 1]); break;
+            case OPERATOR_LOG10: ele = calculate_log10(stack[top - 1]); break;
+            case OPERATOR_LN: ele = calculate_ln(stack[top - 1]); break;
+            case OPERATOR_NEGATE: stack[top - 1] = -stack[top - 1]; continue;
+
+            // variables need calql8r_run_columns
+            default: return CAL_ERROR_SYNTAX;
+        }
+
+        if(ele.type == CAL_ELEMENT_ERROR) return CAL_ERROR_SYNTAX;
+        stack[top - 1] = ele.value;
+    }
+
+    *result = stack[0];
+    return CAL_OK;
+}
@@ -0,0 +1,552 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+// A bracket is split at these operators, the opposite order of the passes of calculate_math.
+// No pass before the '+' pass can reach over a '+' (it would need a number there) so the parts between
+// the '+' are calculated on their own and only added up at the end, the same goes for '-' inside them and so on.
+#define SESSION_SEPARATORS "+-*/r^l"
+// level 0 is a whole bracket, the parts at SESSION_LEAF have none of the separators left in them
+#define SESSION_LEVELS 8
+#define SESSION_LEAF 7
+// brackets inside more brackets than this are left to calql8r_eval_exact
+#define SESSION_MAX_DEPTH 64
+#define SESSION_TOO_DEEP 1
+#define SESSION_START_CAPACITY 64
+
+#define PART_VALID 1
+#define PART_SINGLE 2
+#define PART_INTEGER 4
+
+// What is kept of a part of a bracket. A part starts after its key element (the open bracket or a separator)
+// and ends at the next close bracket or separator of its level or a level before it.
+// e.g in (1*2+3-4) the level 1 parts are 1*2 and 3-4 and the level 2 parts are 1*2, 3 and 4.
+struct SessionPart{
+    double value;
+    long long integer;
+    // elements from the key to the element that ends the part
+    int span;
+    // calculation it is from, parts from this calculation are used even when they are dirty
+    unsigned int epoch;
+    // CAL_OK or the error of the passes and the first error of the brackets inside it
+    signed char status;
+    signed char bracket_status;
+    // type of the answer when it is one element (PART_SINGLE)
+    char type;
+    unsigned char flags;
+};
+
+struct CalQl8rSession{
+    char* text;
+    size_t text_length;
+    size_t text_capacity;
+
+    // Elements like lex_expression makes them and where they start in the text. Element 0 is an open
+    // bracket that is never closed so the whole text is calculated like the inside of a bracket.
+    double* values;
+    char* types;
+    int* starts;
+    // first of the SESSION_LEVELS parts kept for the element in 'parts' or -1
+    int* part_blocks;
+    int length;
+    int capacity;
+    // elements that couldn't be read e.g 1.2.3
+    int lex_errors;
+
+    struct SessionPart* parts;
+    int* free_blocks;
+    int blocks_length;
+    int free_length;
+    int blocks_capacity;
+
+    // Elements that changed since the last calculation (none when first > last). A part is calculated
+    // again when one of them is between its key and the element that ends it.
+    int dirty_first;
+    int dirty_last;
+    unsigned int epoch;
+
+    // elements of the parts being calculated, each part uses them from 'scratch_used' on
+    double* scratch_values;
+    char* scratch_types;
+    long long* scratch_integers;
+    int scratch_used;
+    // shunting yard of integer_expression
+    char* operators;
+    long long* integer_values;
+    // where the elements that are read again start
+    int* new_starts;
+
+    // for brackets nested deeper than SESSION_MAX_DEPTH
+    struct CalQl8r* ctx;
+};
+
+static struct Element (*const SEPARATOR_CALCULATIONS[SESSION_LEAF])(double, double) = {
+    calculate_add, calculate_substract, calculate_multiply, calculate_divide, calculate_root, calculate_pow, calculate_log
+};
+
+// level of the parts an operator splits, SESSION_LEAF for everything else
+static inline int separator_level(char type){
+    switch (type) {
+        case OPERATOR_ADD: return 0;
+        case OPERATOR_SUBSTRACT: return 1;
+        case OPERATOR_MULTPILY: return 2;
+        case OPERATOR_DIVIDE: return 3;
+        case OPERATOR_ROOT: return 4;
+        case OPERATOR_POW: return 5;
+        case OPERATOR_LOGx: return 6;
+        default: return SESSION_LEAF;
+    }
+}
+
+int session_grow(void** array, int capacity, size_t size){
+    void* grown = realloc(*array, (size_t) capacity * size);
+    if(grown == NULL) return FALSE;
+    *array = grown;
+    return TRUE;
+}
+
+// room for 'capacity' elements
+int session_reserve(struct CalQl8rSession* session, int capacity){
+    if(capacity <= session->capacity) return CAL_OK;
+    if(capacity < session->capacity * 2) capacity = session->capacity * 2;
+
+    if(!session_grow((void **) &session->values, capacity, sizeof (double))
+        || !session_grow((void **) &session->types, capacity, sizeof (char))
+        || !session_grow((void **) &session->starts, capacity, sizeof (int))
+        || !session_grow((void **) &session->part_blocks, capacity, sizeof (int))
+        || !session_grow((void **) &session->scratch_values, capacity, sizeof (double))
+        || !session_grow((void **) &session->scratch_types, capacity, sizeof (char))
+        || !session_grow((void **) &session->scratch_integers, capacity, sizeof (long long))
+        || !session_grow((void **) &session->operators, capacity, sizeof (char))
+        || !session_grow((void **) &session->integer_values, capacity, sizeof (long long))
+        || !session_grow((void **) &session->new_starts, capacity, sizeof (int))){
+        return CAL_ERROR_MEMORY;
+    }
+    session->capacity = capacity;
+    return CAL_OK;
+}
+
+// room for the parts of every element
+int session_reserve_parts(struct CalQl8rSession* session){
+    if(session->length <= session->blocks_capacity) return CAL_OK;
+    int capacity = session->blocks_capacity * 2;
+    if(capacity < session->length) capacity = session->length;
+
+    if(!session_grow((void **) &session->parts, capacity, SESSION_LEVELS * sizeof (struct SessionPart))
+        || !session_grow((void **) &session->free_blocks, capacity, sizeof (int))){
+        return CAL_ERROR_MEMORY;
+    }
+    session->blocks_capacity = capacity;
+    return CAL_OK;
+}
+
+struct CalQl8rSession* calql8r_session_create(void){
+    struct CalQl8rSession* session = (struct CalQl8rSession*) calloc(1, sizeof (struct CalQl8rSession));
+    if(session == NULL) return NULL;
+    session->ctx = calql8r_create();
+    session->text = (char *) malloc(SESSION_START_CAPACITY);
+    session->text_capacity = SESSION_START_CAPACITY;
+    if(session->ctx == NULL || session->text == NULL || session_reserve(session, SESSION_START_CAPACITY) != CAL_OK){
+        calql8r_session_destroy(session);
+        return NULL;
+    }
+
+    session->values[0] = 0.0;
+    session->types[0] = BRACKET_OPEN;
+    session->starts[0] = 0;
+    session->part_blocks[0] = -1;
+    session->length = 1;
+    session->dirty_first = 1;
+    session->dirty_last = 0;
+    return session;
+}
+
+void calql8r_session_destroy(struct CalQl8rSession* session){
+    if(session == NULL) return;
+    calql8r_destroy(session->ctx);
+    free(session->text);
+    free(session->values);
+    free(session->types);
+    free(session->starts);
+    free(session->part_blocks);
+    free(session->parts);
+    free(session->free_blocks);
+    free(session->scratch_values);
+    free(session->scratch_types);
+    free(session->scratch_integers);
+    free(session->operators);
+    free(session->integer_values);
+    free(session->new_starts);
+    free(session);
+}
+
+const char* calql8r_session_text(const struct CalQl8rSession* session, size_t* length){
+    *length = session->text_length;
+    return session->text;
+}
+
+// Reads the elements around an edit of the text again. It starts at the last element that starts before the edit
+// (a number can get another digit, or the number before an 'e' an exponent) and stops once an element starts after the edit where an old one did with the
+// same element before it, from there on lex_token reads the same elements as before.
+void session_lex(struct CalQl8rSession* session, int offset, int added, int moved){
+    const char* text = session->text;
+    const size_t text_length = session->text_length;
+    const int edit_end = offset + added;
+
+    int found = 0;
+    int low = 1;
+    int high = session->length - 1;
+    while(low <= high){
+        const int middle = low + (high - low) / 2;
+        if(session->starts[middle] < offset){
+            found = middle;
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    // 1e and 1e- are a number and an 'e' (and a sign) until a digit comes after them, then they are one number
+    // e.g 1e12 or 1.5e-3 typed one key at a time so the number before the 'e' is read again too
+    const char last = session->types[found];
+    if(found > 1 && (last == OPERATOR_ADD || last == OPERATOR_SUBSTRACT || last == OPERATOR_NEGATE || last == CAL_ELEMENT_ERROR)
+        && session->types[found - 1] == EXPONENT) found--;
+    if(found > 1 && session->types[found] == EXPONENT && session->types[found - 1] == NUMBER) found--;
+
+    const int first = found > 0 ? found : 1;
+    size_t i = found > 0 ? (size_t) session->starts[found] : 0;
+
+    int old = first;
+    int count = 0;
+    char prev = session->types[first - 1];
+    while(TRUE){
+        while(i < text_length && is_whitespace(text[i])) i++;
+        if(i >= text_length){
+            old = session->length;
+            break;
+        }
+        if((int) i >= edit_end){
+            const int old_start = (int) i - moved;
+            while(old < session->length && session->starts[old] < old_start) old++;
+            if(old < session->length && session->starts[old] == old_start && session->types[old - 1] == prev) break;
+        }
+
+        // an element that can't be read still takes up at least one character, the calculation is a syntax error anyway
+        const size_t start = i;
+        double value = 0.0;
+        char type;
+        if(lex_token(text, text_length, &i, prev, &value, &type) != CAL_OK){
+            type = CAL_ELEMENT_ERROR;
+            if(i <= start) i = start + 1;
+        }
+        session->scratch_values[count] = value;
+        session->scratch_types[count] = type;
+        session->new_starts[count++] = (int) start;
+        prev = type;
+    }
+
+    // the new elements take the place of first up to old
+    for(int j = first; j < old; j++){
+        if(session->types[j] == CAL_ELEMENT_ERROR) session->lex_errors--;
+        if(session->part_blocks[j] != -1) session->free_blocks[session->free_length++] = session->part_blocks[j];
+    }
+    const int shift = count - (old - first);
+    const int kept = session->length - old;
+    memmove(session->values + old + shift, session->values + old, kept * sizeof (double));
+    memmove(session->types + old + shift, session->types + old, kept);
+    memmove(session->starts + old + shift, session->starts + old, kept * sizeof (int));
+    memmove(session->part_blocks + old + shift, session->part_blocks + old, kept * sizeof (int));
+    for(int j = old + shift; j < old + shift + kept; j++) session->starts[j] += moved;
+
+    for(int j = 0; j < count; j++){
+        session->values[first + j] = session->scratch_values[j];
+        session->types[first + j] = session->scratch_types[j];
+        session->starts[first + j] = session->new_starts[j];
+        session->part_blocks[first + j] = -1;
+        if(session->scratch_types[j] == CAL_ELEMENT_ERROR) session->lex_errors++;
+    }
+    session->length += shift;
+
+    // the element after the new ones is dirty too so a part that only lost elements is found
+    if(session->dirty_first > session->dirty_last){
+        session->dirty_first = first;
+        session->dirty_last = first + count;
+    } else {
+        if(session->dirty_last >= old) session->dirty_last += shift;
+        if(first < session->dirty_first) session->dirty_first = first;
+        if(first + count > session->dirty_last) session->dirty_last = first + count;
+    }
+}
+
+// replaces 'removed' characters at 'offset' with 'added' characters of 'text'
+int session_edit(struct CalQl8rSession* session, size_t offset, size_t removed, const char* text, size_t added){
+    if(offset > session->text_length) offset = session->text_length;
+    if(removed > session->text_length - offset) removed = session->text_length - offset;
+    if(removed == 0 && added == 0) return CAL_OK;
+
+    // there can't be more elements than characters, and element 0
+    const size_t length = session->text_length - removed + added;
+    if(length > INT_MAX - 2) return CAL_ERROR_TOO_MANY_VALUES;
+    if(session_reserve(session, (int) length + 2) != CAL_OK) return CAL_ERROR_MEMORY;
+    if(length > session->text_capacity){
+        size_t capacity = session->text_capacity * 2;
+        if(capacity < length) capacity = length;
+        char* grown = (char *) realloc(session->text, capacity);
+        if(grown == NULL) return CAL_ERROR_MEMORY;
+        session->text = grown;
+        session->text_capacity = capacity;
+    }
+
+    memmove(session->text + offset + added, session->text + offset + removed, session->text_length - offset - removed);
+    if(added > 0) memcpy(session->text + offset, text, added);
+    session->text_length = length;
+
+    session_lex(session, (int) offset, (int) added, (int) added - (int) removed);
+    return CAL_OK;
+}
+
+int calql8r_session_insert(struct CalQl8rSession* session, size_t offset, const char* text, size_t length){
+    return session_edit(session, offset, 0, text, length);
+}
+
+int calql8r_session_delete(struct CalQl8rSession* session, size_t offset, size_t length){
+    return session_edit(session, offset, length, NULL, 0);
+}
+
+int session_part(struct CalQl8rSession* session, int level, int key, int depth, struct SessionPart* part);
+
+// Copies the elements from 'first' to the end of a part at 'level' into the scratch with every bracket
+// replaced by its answer, the way calculate_all_brackets leaves them. 'end' is the element that ends the part.
+int session_items(struct CalQl8rSession* session, int first, int level, int depth, struct Expression* items,
+    int* integers_ok, signed char* bracket_status, int* end){
+    const int base = session->scratch_used;
+    double* values = session->scratch_values + base;
+    char* types = session->scratch_types + base;
+    long long* integers = session->scratch_integers + base;
+    int count = 0;
+    int i = first;
+
+    while(i < session->length){
+        const char c = session->types[i];
+        if(c == BRACKET_CLOSE || separator_level(c) < level) break;
+
+        if(c != BRACKET_OPEN){
+            values[count] = session->values[i];
+            types[count] = c;
+            if(c == NUMBER && is_exact_integer(values[count])) integers[count] = (long long) values[count];
+            else if(c == NUMBER) *integers_ok = FALSE;
+            count++;
+            i++;
+            continue;
+        }
+
+        if(depth == SESSION_MAX_DEPTH){
+            session->scratch_used = base;
+            return SESSION_TOO_DEEP;
+        }
+        struct SessionPart group;
+        session->scratch_used = base + count;
+        const int status = session_part(session, 0, i, depth + 1, &group);
+        if(status != CAL_OK){
+            session->scratch_used = base;
+            return status;
+        }
+
+        // same errors as calculate_all_brackets, an open bracket that is never closed is a syntax error
+        const int close = i + group.span;
+        const int closed = close < session->length && session->types[close] == BRACKET_CLOSE;
+        int group_status = group.bracket_status;
+        if(group_status == CAL_OK && !closed) group_status = CAL_ERROR_SYNTAX;
+        if(group_status == CAL_OK) group_status = group.status;
+        if(group_status == CAL_OK && !(group.flags & PART_SINGLE)) group_status = CAL_ERROR_MATH;
+        if(*bracket_status == CAL_OK) *bracket_status = (signed char) group_status;
+
+        values[count] = group.value;
+        types[count] = group_status == CAL_OK ? group.type : CAL_ELEMENT_ERROR;
+        if(closed && (group.flags & PART_INTEGER)) integers[count] = group.integer;
+        else *integers_ok = FALSE;
+        count++;
+        i = closed ? close + 1 : session->length;
+    }
+
+    session->scratch_used = base;
+    items->values = values;
+    items->types = types;
+    items->array_length = count;
+    *end = i;
+    return CAL_OK;
+}
+
+// part with no separators left, its elements go through integer_expression and calculate_math
+int session_leaf(struct CalQl8rSession* session, int key, int depth, struct SessionPart* part){
+    struct Expression items;
+    int integers_ok = TRUE;
+    int end;
+    part->bracket_status = CAL_OK;
+    part->flags = 0;
+    const int status = session_items(session, key + 1, SESSION_LEAF, depth, &items, &integers_ok, &part->bracket_status, &end);
+    if(status != CAL_OK) return status;
+    part->span = end - key;
+
+    long long integer;
+    if(integers_ok && integer_expression(&items, session->scratch_integers + session->scratch_used, session->operators, session->integer_values, &integer)){
+        part->flags |= PART_INTEGER;
+        part->integer = integer;
+    }
+
+    part->status = (signed char) calculate_math(&items);
+    if(part->status == CAL_OK && items.array_length == 1){
+        part->flags |= PART_SINGLE;
+        part->value = items.values[0];
+        part->type = items.types[0];
+    }
+    return CAL_OK;
+}
+
+// Part made of the parts of the next level between the separators of this level. Their answers are put together
+// the way the pass of the separator would (and the way the integer shunting yard would), only when one of them
+// isn't a single element the whole part is calculated again from its elements.
+int session_split(struct CalQl8rSession* session, int level, int key, int depth, struct SessionPart* part){
+    const char separator = SESSION_SEPARATORS[level];
+    int parts_status = CAL_OK;
+    int fold_status = CAL_OK;
+    int single = TRUE;
+    int integer_ok = TRUE;
+    double value = 0.0;
+    char type = NUMBER;
+    long long integer = 0;
+    part->bracket_status = CAL_OK;
+
+    int sub_key = key;
+    int end;
+    while(TRUE){
+        struct SessionPart sub;
+        const int status = session_part(session, level + 1, sub_key, depth, &sub);
+        if(status != CAL_OK) return status;
+        if(part->bracket_status == CAL_OK) part->bracket_status = sub.bracket_status;
+        if(sub.status != CAL_OK) parts_status = sub.status;
+        if(!(sub.flags & PART_SINGLE)) single = FALSE;
+
+        if(single && fold_status == CAL_OK){
+            if(sub_key == key){
+                value = sub.value;
+                type = sub.type;
+            } else if(type != NUMBER || sub.type != NUMBER){
+                fold_status = CAL_ERROR_SYNTAX;
+            } else {
+                const struct Element answer = SEPARATOR_CALCULATIONS[level](value, sub.value);
+                if(answer.type == CAL_ELEMENT_ERROR) fold_status = CAL_ERROR_SYNTAX;
+                value = answer.value;
+            }
+        }
+
+        if(!(sub.flags & PART_INTEGER)) integer_ok = FALSE;
+        else if(sub_key == key) integer = sub.integer;
+        else if(integer_ok && !integer_operator(separator, integer, sub.integer, &integer)) integer_ok = FALSE;
+
+        end = sub_key + sub.span;
+        if(end == session->length || session->types[end] != separator) break;
+        sub_key = end;
+    }
+
+    part->span = end - key;
+    part->flags = integer_ok ? PART_INTEGER : 0;
+    part->integer = integer;
+    if(parts_status != CAL_OK){
+        part->status = (signed char) parts_status;
+        return CAL_OK;
+    }
+
+    if(!single){
+        struct Expression items;
+        signed char bracket_status = CAL_OK;
+        int items_integers = TRUE;
+        const int status = session_items(session, key + 1, level, depth, &items, &items_integers, &bracket_status, &end);
+        if(status != CAL_OK) return status;
+        part->status = (signed char) calculate_math(&items);
+        if(part->status == CAL_OK && items.array_length == 1){
+            part->flags |= PART_SINGLE;
+            part->value = items.values[0];
+            part->type = items.types[0];
+        }
+        return CAL_OK;
+    }
+
+    part->status = (signed char) fold_status;
+    if(fold_status == CAL_OK){
+        part->flags |= PART_SINGLE;
+        part->value = value;
+        part->type = type;
+    }
+    return CAL_OK;
+}
+
+// the part of 'level' after 'key', kept from before when none of its elements changed
+int session_part(struct CalQl8rSession* session, int level, int key, int depth, struct SessionPart* part){
+    const int kept_block = session->part_blocks[key];
+    if(kept_block != -1){
+        const struct SessionPart* kept = &session->parts[kept_block * SESSION_LEVELS + level];
+        const int dirty = key <= session->dirty_last && key + kept->span >= session->dirty_first;
+        if((kept->flags & PART_VALID) && (kept->epoch == session->epoch || !dirty)){
+            *part = *kept;
+            return CAL_OK;
+        }
+    }
+
+    const int status = level == SESSION_LEAF ? session_leaf(session, key, depth, part) : session_split(session, level, key, depth, part);
+    if(status != CAL_OK) return status;
+
+    // session_reserve_parts made room for a block for every element, the next levels may have taken it already
+    int block = session->part_blocks[key];
+    if(block == -1){
+        block = session->free_length > 0 ? session->free_blocks[--session->free_length] : session->blocks_length++;
+        session->part_blocks[key] = block;
+        for(int i = 0; i < SESSION_LEVELS; i++) session->parts[block * SESSION_LEVELS + i].flags = 0;
+    }
+    part->flags |= PART_VALID;
+    part->epoch = session->epoch;
+    session->parts[block * SESSION_LEVELS + level] = *part;
+    return CAL_OK;
+}
+
+int calql8r_session_eval(struct CalQl8rSession* session, double* result, long long* integer, int* exact){
+    *exact = FALSE;
+    if(session->lex_errors > 0 || session->length == 1) return CAL_ERROR_SYNTAX;
+    if(session_reserve_parts(session) != CAL_OK) return CAL_ERROR_MEMORY;
+
+    session->epoch++;
+    session->scratch_used = 0;
+    struct SessionPart root;
+    if(session_part(session, 0, 0, 0, &root) != CAL_OK){
+        return calql8r_eval_exact(session->ctx, session->text, session->text_length, result, integer, exact);
+    }
+
+    // A close bracket without an open one stops calculate_all_brackets. The parts after it are still
+    // calculated (and kept) like the inside of a bracket so nothing is left dirty for the next calculation.
+    int status = CAL_OK;
+    for(int key = root.span; key < session->length; ){
+        struct SessionPart rest;
+        if(session_part(session, 0, key, 0, &rest) != CAL_OK){
+            return calql8r_eval_exact(session->ctx, session->text, session->text_length, result, integer, exact);
+        }
+        key += rest.span;
+        status = root.bracket_status != CAL_OK ? root.bracket_status : CAL_ERROR_SYNTAX;
+    }
+    session->dirty_first = 1;
+    session->dirty_last = 0;
+    if(status != CAL_OK) return status;
+
+    if((root.flags & PART_INTEGER) && root.integer != 0){
+        *exact = TRUE;
+        *integer = root.integer;
+        *result = (double) root.integer;
+        return CAL_OK;
+    }
+    if(root.bracket_status != CAL_OK) return root.bracket_status;
+    if(root.status != CAL_OK) return root.status;
+    if(!(root.flags & PART_SINGLE) || root.type != NUMBER) return CAL_ERROR_SYNTAX;
+
+    *result = root.value;
+    return CAL_OK;
+}
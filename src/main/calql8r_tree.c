@@ -0,0 +1,225 @@
+#include <string.h>
+#include <math.h>
+#include "calql8r.h"
+#include "calql8r_internal.h"
+
+#define TREE_MIN_TABLE_SIZE 16
+#define NO_NODE -1
+
+// Calculates one operator the same way the program would. Gives CAL_ERROR_SYNTAX when
+// the values can't be calculated e.g 1/0, the tree then keeps the operator so running it fails the same way
+int calculate_operator(char type, double num1, double num2, double* answer){
+    struct Element ele;
+    switch (type) {
+        case OPERATOR_ADD: *answer = num1 + num2; return CAL_OK;
+        case OPERATOR_SUBSTRACT: *answer = num1 - num2; return CAL_OK;
+        case OPERATOR_MULTPILY: *answer = num1 * num2; return CAL_OK;
+        case OPERATOR_NEGATE: *answer = -num1; return CAL_OK;
+        case OPERATOR_DIVIDE: ele = calculate_divide(num1, num2); break;
+        case OPERATOR_POW: ele = calculate_pow(num1, num2); break;
+        case OPERATOR_ROOT: ele = calculate_root(num1, num2); break;
+        case OPERATOR_LOGx: ele = calculate_log(num1, num2); break;
+        case PERMUTATIONS: ele = calculate_permutation(num1, num2); break;
+        case COMBINATIONS: ele = calculate_combinations(num1, num2); break;
+        case OPERATOR_FACTORIAL: ele = calculate_factorial(num1); break;
+        case OPERATOR_SIN: ele = calculate_sin(num1); break;
+        case OPERATOR_SINH: ele = calculate_sinh(num1); break;
+        case OPERATOR_COS: ele = calculate_cos(num1); break;
+        case OPERATOR_COSH: ele = calculate_cosh(num1); break;
+        case OPERATOR_TAN: ele = calculate_tan(num1); break;
+        case OPERATOR_TANH: ele = calculate_tanh(num1); break;
+        case OPERATOR_LOG10: ele = calculate_log10(num1); break;
+        case OPERATOR_LN: ele = calculate_ln(num1); break;
+        default: return CAL_ERROR_SYNTAX;
+    }
+
+    if(ele.type == CAL_ELEMENT_ERROR) return CAL_ERROR_SYNTAX;
+    *answer = ele.value;
+    return CAL_OK;
+}
+
+// 'capacity' is the most nodes the tree will need, one per element of the expression is enough
+int tree_init(struct Tree* tree, struct Arena* arena, int capacity){
+    int table_size = TREE_MIN_TABLE_SIZE;
+    while(table_size < capacity * 2) table_size *= 2;
+
+    tree->nodes = (struct Node *) arena_alloc(arena, sizeof (struct Node) * (capacity > 0 ? capacity : 1));
+    tree->table = (int *) arena_alloc(arena, sizeof (int) * table_size);
+    if(tree->nodes == NULL || tree->table == NULL) return CAL_ERROR_MEMORY;
+
+    // every byte 0xff is -1
+    memset(tree->table, 0xff, sizeof (int) * table_size);
+    tree->table_mask = table_size - 1;
+    tree->nodes_length = 0;
+    tree->capacity = capacity;
+    tree->slots_length = 0;
+    return CAL_OK;
+}
+
+unsigned long long hash_node(char type, double value, int left, int right){
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof bits);
+
+    // FNV-1a over the fields instead of the bytes
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = (hash ^ (unsigned char) type) * 1099511628211ULL;
+    hash = (hash ^ bits) * 1099511628211ULL;
+    hash = (hash ^ (unsigned int) left) * 1099511628211ULL;
+    hash = (hash ^ (unsigned int) right) * 1099511628211ULL;
+    return hash ^ (hash >> 32);
+}
+
+int is_constant(const struct Tree* tree, int index, double value){
+    if(index == NO_NODE || tree->nodes[index].type != NUMBER) return FALSE;
+
+    // compare the bits so that 0 and -0 are not the same
+    return memcmp(&tree->nodes[index].value, &value, sizeof value) == 0;
+}
+
+// constant folding e.g 2r4, S(p/2) and 6! become one NUMBER
+int fold_constants(const struct Tree* tree, char type, int left, int right, double* answer){
+    if(type == NUMBER || type == VARIABLE) return FALSE;
+    if(tree->nodes[left].type != NUMBER) return FALSE;
+    if(right != NO_NODE && tree->nodes[right].type != NUMBER) return FALSE;
+
+    const double num2 = right == NO_NODE ? 0 : tree->nodes[right].value;
+    return calculate_operator(type, tree->nodes[left].value, num2, answer) == CAL_OK;
+}
+
+// algebra that gives exactly the same answer for every value including NAN, infinity and -0.
+// x+0 stays because -0+0 is 0 and 0*x stays because NAN*0 is NAN.
+// Gives the node to use instead or NO_NODE
+int simplify_node(struct Tree* tree, char type, int left, int right){
+    switch (type) {
+        case OPERATOR_MULTPILY:
+            if(is_constant(tree, right, 1)) return left;
+            if(is_constant(tree, left, 1)) return right;
+            if(is_constant(tree, right, -1)) return make_node(tree, OPERATOR_NEGATE, 0, left, NO_NODE);
+            if(is_constant(tree, left, -1)) return make_node(tree, OPERATOR_NEGATE, 0, right, NO_NODE);
+            break;
+        case OPERATOR_DIVIDE:
+        case OPERATOR_POW:
+            if(is_constant(tree, right, 1)) return left;
+            break;
+        case OPERATOR_SUBSTRACT:
+            if(is_constant(tree, right, 0.0)) return left;
+            break;
+        case OPERATOR_ADD:
+            if(is_constant(tree, right, -0.0)) return left;
+            if(is_constant(tree, left, -0.0)) return right;
+            break;
+        case OPERATOR_NEGATE:
+            // -(-(x))
+            if(tree->nodes[left].type == OPERATOR_NEGATE) return tree->nodes[left].left;
+            break;
+    }
+    return NO_NODE;
+}
+
+// common subexpressions, gives the node that is the same as this one or adds it to the tree
+int find_node(struct Tree* tree, char type, double value, int left, int right){
+    int i = (int) (hash_node(type, value, left, right) & tree->table_mask);
+    while(tree->table[i] != NO_NODE){
+        const struct Node* node = &tree->nodes[tree->table[i]];
+        if(node->type == type && node->left == left && node->right == right
+            && memcmp(&node->value, &value, sizeof value) == 0) return tree->table[i];
+        i = (i + 1) & tree->table_mask;
+    }
+
+    if(tree->nodes_length == tree->capacity) return NO_NODE;
+    struct Node* node = &tree->nodes[tree->nodes_length];
+    node->type = type;
+    node->value = value;
+    node->left = left;
+    node->right = right;
+    node->uses = 0;
+    node->slot = NO_NODE;
+    tree->table[i] = tree->nodes_length;
+    return tree->nodes_length++;
+}
+
+// Adds a NUMBER, VARIABLE (index in 'value') or an operator on the 'left' and 'right' nodes.
+// The node is folded, simplified and shared with an identical one on the way in
+// so the tree never holds the unoptimized form. Gives NO_NODE when the tree is full
+int make_node(struct Tree* tree, char type, double value, int left, int right){
+    double answer = 0;
+    if(fold_constants(tree, type, left, right, &answer)) return find_node(tree, NUMBER, answer, NO_NODE, NO_NODE);
+
+    if(type != NUMBER && type != VARIABLE){
+        const int simplified = simplify_node(tree, type, left, right);
+        if(simplified != NO_NODE) return simplified;
+        value = 0;
+    }
+    return find_node(tree, type, value, left, right);
+}
+
+void count_uses(struct Tree* tree, int root, int* pending){
+    int pending_length = 0;
+    tree->nodes[root].uses = 1;
+    pending[pending_length++] = root;
+
+    // every node that can be reached is walked once, 'uses' counts its parents
+    while(pending_length > 0){
+        const struct Node* node = &tree->nodes[pending[--pending_length]];
+        if(node->left != NO_NODE && tree->nodes[node->left].uses++ == 0) pending[pending_length++] = node->left;
+        if(node->right != NO_NODE && tree->nodes[node->right].uses++ == 0) pending[pending_length++] = node->right;
+    }
+}
+
+void emit_code(struct CalQl8rProgram* program, char type, double constant, int change, int* depth){
+    program->code[program->code_length++] = type;
+    if(type == NUMBER || type == VARIABLE || type == SLOT_STORE || type == SLOT_LOAD){
+        program->constants[program->constants_length++] = constant;
+    }
+
+    *depth += change;
+    if(*depth > program->stack_size) program->stack_size = *depth;
+}
+
+// Writes the postfix instructions of the tree into 'program'. A node with more than one parent is calculated
+// the first time it is needed and kept in a slot for the other times.
+// 'program' needs room for three instructions per node
+int generate_program(struct Tree* tree, int root, struct Arena* arena, struct CalQl8rProgram* program){
+    // a node waiting for its operator to be written is pushed as -2 - node
+    const int pending_size = tree->nodes_length * 2 + 1;
+    int* pending = (int *) arena_alloc(arena, sizeof (int) * pending_size);
+    if(pending == NULL) return CAL_ERROR_MEMORY;
+
+    program->code_length = 0;
+    program->constants_length = 0;
+    program->stack_size = 0;
+    tree->slots_length = 0;
+    count_uses(tree, root, pending);
+
+    int depth = 0;
+    int pending_length = 0;
+    pending[pending_length++] = root;
+    while(pending_length > 0){
+        const int index = pending[--pending_length];
+
+        if(index <= -2){
+            struct Node* node = &tree->nodes[-2 - index];
+            emit_code(program, node->type, 0, node->right == NO_NODE ? 0 : -1, &depth);
+            if(node->uses > 1){
+                node->slot = tree->slots_length++;
+                emit_code(program, SLOT_STORE, node->slot, 0, &depth);
+            }
+            continue;
+        }
+
+        const struct Node* node = &tree->nodes[index];
+        if(node->type == NUMBER || node->type == VARIABLE){
+            emit_code(program, node->type, node->value, 1, &depth);
+        } else if(node->slot != NO_NODE){
+            emit_code(program, SLOT_LOAD, node->slot, 1, &depth);
+        } else {
+            // left is written first so it is pushed last
+            pending[pending_length++] = -2 - index;
+            if(node->right != NO_NODE) pending[pending_length++] = node->right;
+            pending[pending_length++] = node->left;
+        }
+    }
+
+    program->slots_length = tree->slots_length;
+    return CAL_OK;
+}
@@ -1,3 +1,4 @@
+import 'dart:io';
 import 'dart:math';
 
 // Constamts
@@ -339,28 +340,24 @@ List<dynamic>? calculate_innermost_brackets(
   return expression;
 }
 
-void main(List<String> args) {
-
-  if (args.length < 1) return print("PLEASE ADD AN EXPRESSION TO CALCULATE");
+// calculates one expression, gives back the answer or the error message main prints
+String calculate(String text) {
   List<dynamic>? expression = [];
 
-  // construct expression for arguments e.g 1+1 +2 /4 *4
-  // whitespaces are automatically handled by joining each argument
-  for (var arg in args) {
-    for (var c in arg.split("")) {
-      if(c != ' '){
-        expression.add(c);
-      }   
-    }
+  // whitespaces are skipped
+  for (var c in text.split("")) {
+    if(c != ' '){
+      expression.add(c);
+    }   
   }
 
   // calculate integer numbers
   expression = construct_numbers_from_string_of_integers(expression);
-  if (expression == null) return print("INVALID NUMBER FORMAT");
+  if (expression == null) return "INVALID NUMBER FORMAT";
 
   // calculate decimal numbers
   expression = construct_decimal_numbers(expression);
-  if (expression == null) return print("INVALID DECIMAL NUMBER FORMAT");
+  if (expression == null) return "INVALID DECIMAL NUMBER FORMAT";
 
   // replace all PI symbols with value
   for (int i = 0; i < expression.length; i++) {
@@ -369,16 +366,40 @@ void main(List<String> args) {
 
   // convert negative numbers
   expression = convert_negative_numbers(expression);
-  if (expression == null) return print("INVALID NEGATIVE NUMBER FORMAT");
+  if (expression == null) return "INVALID NEGATIVE NUMBER FORMAT";
 
   // Calculate inner bracket expressions
   do {
     expression = calculate_innermost_brackets(expression!, calculate_math);
-    if (expression == null) return print("MATH ERROR");
+    if (expression == null) return "MATH ERROR";
   } while (expression.contains("("));
 
   var value = calculate_math(expression);
-  if (value == null) return print("MATH ERROR");
+  if (value == null) return "MATH ERROR";
+
+  return value.toString();
+}
+
+void main(List<String> args) {
 
-  print(value);
+  // one expression per line from stdin and one answer (or error) per line back
+  if (args.length == 1 && args[0] == '--batch') {
+    var answers = StringBuffer();
+    String? line;
+    while ((line = stdin.readLineSync()) != null) {
+      try {
+        answers.writeln(calculate(line!));
+      } catch (e) {
+        answers.writeln("MATH ERROR");
+      }
+    }
+    stdout.write(answers);
+    return;
+  }
+
+  if (args.length < 1) return print("PLEASE ADD AN EXPRESSION TO CALCULATE");
+
+  // construct expression for arguments e.g 1+1 +2 /4 *4
+  // whitespaces are automatically handled by joining each argument
+  print(calculate(args.join()));
 }
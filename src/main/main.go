@@ -1,6 +1,7 @@
 package main
 
 import (
+	"bufio"
 	"bytes"
 	"errors"
 	"fmt"
@@ -8,6 +9,7 @@ import (
 	"math"
 	"os"
 	"strconv"
+	"strings"
 )
 
 // Constants
@@ -512,46 +514,36 @@ func containsBrackets(expression []Element) bool {
 	return false
 }
 
-func main() {
-
-	if len(os.Args) < 2 {
-		log.Fatal("PLEASE ADD AN EXPRESSION TO CALCULATE")
-	}
+// calculates one expression, the error is the message main prints for it
+func calculate(text string) (float64, error) {
 
-	// construct expression for agruments e.g 1+1 +2 /4 *4
-	// whitesplaces are automatically handled by joining each argument
+	// whitespaces are skipped
 	expression := []Element{}
-
-	// Get arguments from command line in expreesion
-	for i := 1; i < len(os.Args); i++ {
-		arg := os.Args[i]
-		for j := 0; j < len(arg); j++ {
-			if arg[j] != ' ' { // skip white space
-				var ele Element
-				ele.chr = rune(arg[j])
-				ele.digit_length = 0
-				ele.integers = 0
-				ele.value = 0.0
-				expression = append(expression, ele)
-			}
-
+	for j := 0; j < len(text); j++ {
+		if text[j] != ' ' { // skip white space
+			var ele Element
+			ele.chr = rune(text[j])
+			ele.digit_length = 0
+			ele.integers = 0
+			ele.value = 0.0
+			expression = append(expression, ele)
 		}
 	}
 
 	const MAX_ARRAY_SIZE = 200
 	if len(expression) >= MAX_ARRAY_SIZE {
-		log.Fatal("EXPRESSION TOO LONG")
+		return 0, errors.New("EXPRESSION TOO LONG")
 	}
 
 	expression, err := construct_numbers_from_string_of_integers(expression)
 	if err != nil {
-		log.Fatal("INVALID NUMBER FORMAT")
+		return 0, errors.New("INVALID NUMBER FORMAT")
 	}
 
 	// calculate decimal numbers
 	expression, err = construct_decimal_numbers(expression)
 	if err != nil {
-		log.Fatal("INVALID DECIMAL NUMBER FORMAT")
+		return 0, errors.New("INVALID DECIMAL NUMBER FORMAT")
 	}
 
 	// replace all PI symbols with value
@@ -566,14 +558,14 @@ func main() {
 	// convert negative numbers
 	expression, err = convert_negative_numbers(expression)
 	if err != nil {
-		log.Fatal("INVALID NEGATIVE NUMBER FORMAT")
+		return 0, errors.New("INVALID NEGATIVE NUMBER FORMAT")
 	}
 
 	// while loop to check for brackets
 	for containsBrackets(expression) {
 		expression, err = calculate_innermost_brackets(expression, calculate_math)
 		if err != nil {
-			log.Fatal("BRACKET MATH ERROR")
+			return 0, errors.New("BRACKET MATH ERROR")
 		}
 	}
 
@@ -581,7 +573,50 @@ func main() {
 	value, err := calculate_math(expression)
 
 	if err != nil {
-		log.Fatal("MATH ERROR")
+		return 0, errors.New("MATH ERROR")
+	}
+
+	return value, nil
+}
+
+// a panic on one line is that line's error, the lines after it still get calculated
+func calculate_line(text string) (value float64, err error) {
+	defer func() {
+		if recover() != nil {
+			err = errors.New("MATH ERROR")
+		}
+	}()
+	return calculate(text)
+}
+
+func main() {
+
+	if len(os.Args) < 2 {
+		log.Fatal("PLEASE ADD AN EXPRESSION TO CALCULATE")
+	}
+
+	// one expression per line from stdin and one answer (or error) per line back
+	if len(os.Args) == 2 && os.Args[1] == "--batch" {
+		scanner := bufio.NewScanner(os.Stdin)
+		scanner.Buffer(make([]byte, 64*1024), 64*1024*1024)
+		writer := bufio.NewWriter(os.Stdout)
+		defer writer.Flush()
+		for scanner.Scan() {
+			value, err := calculate_line(strings.TrimRight(scanner.Text(), "\r"))
+			if err != nil {
+				fmt.Fprintln(writer, err.Error())
+			} else {
+				fmt.Fprintln(writer, value)
+			}
+		}
+		return
+	}
+
+	// construct expression for agruments e.g 1+1 +2 /4 *4
+	// whitesplaces are automatically handled by joining each argument
+	value, err := calculate(strings.Join(os.Args[1:], ""))
+	if err != nil {
+		log.Fatal(err.Error())
 	}
 
 	fmt.Println(value)
@@ -523,12 +523,34 @@ function calculate(expression) {
     }
 
     // recursive calcalutions until answer is found.
-    while (list.includes('(')) list = calculate_innermost_brackets(list, math_calculation);
-    while (list.length > 1) list = math_calculation(list);
+    // when a step doesn't make the expression any shorter it would go round forever
+    while (list.includes('(')) {
+        const length = list.length;
+        list = calculate_innermost_brackets(list, math_calculation);
+        if (list.length >= length) throw Error('Math Error: Could not calculate');
+    }
+    while (list.length > 1) {
+        const length = list.length;
+        list = math_calculation(list);
+        if (list.length >= length) throw Error('Math Error: Could not calculate');
+    }
     return list[0];
 }
 
 
 // Entry Point for calculations
-if (process.argv.length != 3) console.warn('Invalid Math Expression')
+if (process.argv.length == 3 && process.argv[2] == '--batch') {
+    // one expression per line from stdin and one answer (or error) per line back
+    const lines = require('fs').readFileSync(0, 'utf8').split('\n');
+    if (lines[lines.length - 1] == '') lines.pop();
+    const answers = lines.map(line => {
+        try {
+            return String(calculate(line));
+        } catch (error) {
+            return error.message;
+        }
+    });
+    if (answers.length > 0) process.stdout.write(answers.join('\n') + '\n');
+}
+else if (process.argv.length != 3) console.warn('Invalid Math Expression')
 else console.log(calculate(process.argv[2]));
\ No newline at end of file
@@ -310,32 +310,24 @@ def calculate_innermost_brackets(expression:list, calculate_math: Callable[[list
     return expression
 
 
-def main():
-
-
-    if len(sys.argv) <= 1:
-        return print("PLEASE ADD AN EXPRESSION TO CALCULATE")
-
+def calculate(text: str) -> str:
 
-    # construct expression for agruments e.g 1+1 +2 /4 *4
-    # whitesplaces are automatically handled by joining each argument
+    # construct expression from the characters, whitespaces are skipped
     expression = []
-    for i in range(1, len(sys.argv)):
-        arg = sys.argv[i]
-        for j in range(0, len(arg)):
-            if arg[j] != ' ':
-                expression.append(arg[j])
+    for j in range(0, len(text)):
+        if text[j] != ' ':
+            expression.append(text[j])
 
 
     expression = construct_numbers_from_string_of_integers(expression)
     if (expression == None):
-        return print("INVALID NUMBER FORMAT")
+        return "INVALID NUMBER FORMAT"
 
 
     # calculate decimal numbers
     expression = construct_decimal_numbers(expression)
     if (expression == None):
-        return print("INVALID DECIMAL NUMBER FORMAT")
+        return "INVALID DECIMAL NUMBER FORMAT"
 
 
     # replace all PI symbols with value
@@ -347,21 +339,40 @@ def main():
     # convert negative numbers
     expression = convert_negative_numbers(expression)
     if (expression == None):
-        return print("INVALID NEGATIVE NUMBER FORMAT")
+        return "INVALID NEGATIVE NUMBER FORMAT"
     
     
     # Calculate inner bracket expressions
     while expression.count('('):
         expression = calculate_innermost_brackets(expression, calculate_math)
         if (expression == None):
-            return print("MATH ERROR")
+            return "MATH ERROR"
     
     # Calculate final expression
     value = calculate_math(expression)
     if (value == None):
-        return print("MATH ERROR")
+        return "MATH ERROR"
       
-    print(value)
+    return str(value)
+
+
+def main():
+
+
+    if len(sys.argv) <= 1:
+        return print("PLEASE ADD AN EXPRESSION TO CALCULATE")
+
+
+    # one expression per line from stdin and one answer per line back
+    if len(sys.argv) == 2 and sys.argv[1] == '--batch':
+        for line in sys.stdin:
+            print(calculate(line.rstrip('\r\n')))
+        return
+
+
+    # construct expression for agruments e.g 1+1 +2 /4 *4
+    # whitesplaces are automatically handled by joining each argument
+    print(calculate("".join(sys.argv[1:])))
 
 if __name__ == "__main__":
     main()
@@ -0,0 +1,340 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calql8r.h"
+#include "batch.h"
+#include "server.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define SERVER_READ_SIZE (64 * 1024)
+#define SERVER_MAX_LINE (1 << 20)
+#define SERVER_MAX_PENDING (1 << 20)
+#define SERVER_BACKLOG 1024
+#define SERVER_EVENTS 64
+
+struct ServerConnection{
+    int fd;
+    // bytes of a line that hasn't got its newline yet
+    char* in;
+    size_t in_length;
+    size_t in_capacity;
+    // answers, the first 'sent' bytes are already gone
+    struct OutputBuffer out;
+    size_t sent;
+    // what epoll is asked to wait for right now
+    unsigned int events;
+    // the client has closed its side, only the answers are left to send
+    int closing;
+    struct ServerConnection* previous;
+    struct ServerConnection* next;
+};
+
+struct ServerWorker{
+    struct Server* server;
+    struct CalQl8r* ctx;
+    int epoll;
+    pthread_t thread;
+    // every connection of this worker so they can be closed when the server stops
+    struct ServerConnection* connections;
+};
+
+struct Server{
+    char* path;
+    int listener;
+    int bound;
+    // written once to wake every worker up when the server stops
+    int stop;
+    struct ServerWorker* workers;
+    int workers_length;
+};
+
+void close_connection(struct ServerWorker* worker, struct ServerConnection* conn){
+    epoll_ctl(worker->epoll, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    if(conn->previous != NULL) conn->previous->next = conn->next;
+    else worker->connections = conn->next;
+    if(conn->next != NULL) conn->next->previous = conn->previous;
+    free(conn->in);
+    output_free(&conn->out);
+    free(conn);
+}
+
+// one connection per wake up, with EPOLLEXCLUSIVE the next one wakes up another worker
+void accept_connection(struct ServerWorker* worker){
+    const int fd = accept4(worker->server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd < 0) return;
+
+    struct ServerConnection* conn = (struct ServerConnection*) calloc(1, sizeof (struct ServerConnection));
+    if(conn == NULL){
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    conn->in = (char *) malloc(SERVER_READ_SIZE);
+    conn->in_capacity = SERVER_READ_SIZE;
+    conn->events = EPOLLIN;
+
+    struct epoll_event event;
+    event.events = conn->events;
+    event.data.ptr = conn;
+    if(conn->in == NULL || output_init(&conn->out, SERVER_READ_SIZE) != CAL_OK
+        || epoll_ctl(worker->epoll, EPOLL_CTL_ADD, fd, &event) != 0){
+        close(fd);
+        free(conn->in);
+        output_free(&conn->out);
+        free(conn);
+        return;
+    }
+
+    conn->next = worker->connections;
+    if(worker->connections != NULL) worker->connections->previous = conn;
+    worker->connections = conn;
+}
+
+// one read and the answers of every line it completed, 0 when the connection has to be closed
+int read_connection(struct ServerWorker* worker, struct ServerConnection* conn){
+    if(conn->in_length == conn->in_capacity){
+        // nobody sends a line this long on purpose
+        if(conn->in_capacity >= SERVER_MAX_LINE) return 0;
+        char* in = (char *) realloc(conn->in, conn->in_capacity * 2);
+        if(in == NULL) return 0;
+        conn->in = in;
+        conn->in_capacity *= 2;
+    }
+
+    const ssize_t received = recv(conn->fd, conn->in + conn->in_length, conn->in_capacity - conn->in_length, 0);
+    if(received < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    // the bytes before these had no newline, so only the new ones have to be searched
+    size_t complete = 0;
+    for(size_t i = conn->in_length + received; i > conn->in_length; i--){
+        if(conn->in[i - 1] == '\n'){
+            complete = i;
+            break;
+        }
+    }
+    conn->in_length += received;
+
+    // like batch mode the last line doesn't need a newline once the client is done
+    if(received == 0){
+        conn->closing = 1;
+        complete = conn->in_length;
+    }
+    if(complete == 0) return 1;
+
+    if(conn->sent > 0){
+        memmove(conn->out.data, conn->out.data + conn->sent, conn->out.length - conn->sent);
+        conn->out.length -= conn->sent;
+        conn->sent = 0;
+    }
+    if(batch_calculate_lines(worker->ctx, conn->in, complete, &conn->out) != CAL_OK) return 0;
+
+    memmove(conn->in, conn->in + complete, conn->in_length - complete);
+    conn->in_length -= complete;
+    return 1;
+}
+
+// sends as much as the socket takes, 0 when the connection is broken
+int write_connection(struct ServerConnection* conn){
+    while(conn->sent < conn->out.length){
+        const ssize_t sent = send(conn->fd, conn->out.data + conn->sent, conn->out.length - conn->sent, MSG_NOSIGNAL);
+        if(sent < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        conn->sent += sent;
+    }
+    conn->out.length = 0;
+    conn->sent = 0;
+    return 1;
+}
+
+void connection_event(struct ServerWorker* worker, struct ServerConnection* conn, unsigned int events){
+    int open = 1;
+    if((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !conn->closing) open = read_connection(worker, conn);
+    if(open) open = write_connection(conn);
+
+    const size_t pending = conn->out.length - conn->sent;
+    if(!open || (conn->closing && pending == 0)){
+        close_connection(worker, conn);
+        return;
+    }
+
+    // backpressure, a client that isn't reading its answers doesn't get more lines calculated
+    unsigned int wanted = 0;
+    if(!conn->closing && pending < SERVER_MAX_PENDING) wanted |= EPOLLIN;
+    if(pending > 0) wanted |= EPOLLOUT;
+    if(wanted != conn->events){
+        struct epoll_event event;
+        event.events = wanted;
+        event.data.ptr = conn;
+        if(epoll_ctl(worker->epoll, EPOLL_CTL_MOD, conn->fd, &event) != 0){
+            close_connection(worker, conn);
+            return;
+        }
+        conn->events = wanted;
+    }
+}
+
+void* server_worker_main(void* arg){
+    struct ServerWorker* worker = (struct ServerWorker*) arg;
+    struct epoll_event events[SERVER_EVENTS];
+    int running = 1;
+
+    while(running){
+        const int count = epoll_wait(worker->epoll, events, SERVER_EVENTS, -1);
+        if(count < 0 && errno != EINTR) break;
+
+        // the listener is NULL and the stop event is the server, everything else is a connection
+        for(int i = 0; i < count; i++){
+            void* ptr = events[i].data.ptr;
+            if(ptr == NULL) accept_connection(worker);
+            else if(ptr == worker->server) running = 0;
+            else connection_event(worker, (struct ServerConnection*) ptr, events[i].events);
+        }
+    }
+
+    while(worker->connections != NULL) close_connection(worker, worker->connections);
+    return NULL;
+}
+
+int start_worker(struct Server* server, struct ServerWorker* worker){
+    worker->server = server;
+    worker->ctx = calql8r_create();
+    worker->epoll = epoll_create1(EPOLL_CLOEXEC);
+    if(worker->ctx == NULL || worker->epoll < 0) return 0;
+
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = NULL;
+    if(epoll_ctl(worker->epoll, EPOLL_CTL_ADD, server->listener, &event) != 0) return 0;
+
+    event.events = EPOLLIN;
+    event.data.ptr = server;
+    if(epoll_ctl(worker->epoll, EPOLL_CTL_ADD, server->stop, &event) != 0) return 0;
+
+    return pthread_create(&worker->thread, NULL, server_worker_main, worker) == 0;
+}
+
+// a socket file that nothing answers on is left over from a server that is gone
+int stale_socket(const char* path, const struct sockaddr_un* address){
+    struct stat file;
+    if(stat(path, &file) != 0 || !S_ISSOCK(file.st_mode)) return 0;
+
+    const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(probe < 0) return 0;
+    const int alive = connect(probe, (const struct sockaddr*) address, sizeof (struct sockaddr_un)) == 0;
+    close(probe);
+    return !alive;
+}
+
+struct Server* server_create(const char* path, int workers){
+    struct sockaddr_un address;
+    if(workers < 1 || strlen(path) >= sizeof address.sun_path) return NULL;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path, strlen(path));
+
+    struct Server* server = (struct Server*) calloc(1, sizeof (struct Server));
+    if(server == NULL) return NULL;
+    server->listener = -1;
+    server->stop = -1;
+    server->path = strdup(path);
+    server->workers = (struct ServerWorker*) calloc(workers, sizeof (struct ServerWorker));
+    if(server->path == NULL || server->workers == NULL){
+        server_destroy(server);
+        return NULL;
+    }
+
+    if(stale_socket(path, &address)) unlink(path);
+    server->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->stop = eventfd(0, EFD_CLOEXEC);
+    if(server->listener < 0 || server->stop < 0
+        || bind(server->listener, (const struct sockaddr*) &address, sizeof address) != 0){
+        server_destroy(server);
+        return NULL;
+    }
+    server->bound = 1;
+    if(listen(server->listener, SERVER_BACKLOG) != 0){
+        server_destroy(server);
+        return NULL;
+    }
+
+    for(int i = 0; i < workers; i++){
+        struct ServerWorker* worker = &server->workers[i];
+        if(!start_worker(server, worker)){
+            calql8r_destroy(worker->ctx);
+            if(worker->epoll >= 0) close(worker->epoll);
+            server_destroy(server);
+            return NULL;
+        }
+        server->workers_length++;
+    }
+    return server;
+}
+
+void server_destroy(struct Server* server){
+    if(server == NULL) return;
+
+    if(server->stop >= 0) eventfd_write(server->stop, 1);
+    for(int i = 0; i < server->workers_length; i++){
+        struct ServerWorker* worker = &server->workers[i];
+        pthread_join(worker->thread, NULL);
+        calql8r_destroy(worker->ctx);
+        close(worker->epoll);
+    }
+
+    if(server->listener >= 0) close(server->listener);
+    if(server->stop >= 0) close(server->stop);
+    if(server->bound) unlink(server->path);
+    free(server->path);
+    free(server->workers);
+    free(server);
+}
+
+int run_server(const char* path, int workers){
+    // blocked before the workers start so only this thread gets them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct Server* server = server_create(path, workers);
+    if(server == NULL) return EOF;
+
+    int received;
+    sigwait(&signals, &received);
+    server_destroy(server);
+    return CAL_OK;
+}
+
+#else
+
+struct Server* server_create(const char* path, int workers){
+    (void) path;
+    (void) workers;
+    return NULL;
+}
+
+void server_destroy(struct Server* server){
+    (void) server;
+}
+
+int run_server(const char* path, int workers){
+    (void) path;
+    (void) workers;
+    return EOF;
+}
+
+#endif
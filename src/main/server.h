@@ -0,0 +1,26 @@
+#ifndef CALQL8R_SERVER_H
+#define CALQL8R_SERVER_H
+
+// Calculator daemon on a Unix domain socket for processes that calculate a lot and
+// can't start main every time. Same protocol as batch mode: one expression per line in,
+// one answer (or error) per line out in the same order. A connection stays open for as
+// many lines as the client wants and it can send the next lines before the answers come back.
+//
+// Every worker thread has its own epoll loop and context, connections stay on the worker
+// that accepted them. A connection with more than SERVER_MAX_PENDING bytes of answers
+// it hasn't read yet isn't read from until it catches up, so the kernel buffers push back
+// on a client that sends faster than it reads.
+// Only on Linux, on other systems server_create gives NULL.
+struct Server;
+
+// Listens on 'path' (a socket file left there by an old server is replaced) and starts 'workers' threads
+struct Server* server_create(const char* path, int workers);
+
+// stops the workers, closes every connection and removes the socket file
+void server_destroy(struct Server* server);
+
+// server_create and then waits for SIGINT or SIGTERM before server_destroy.
+// Returns CAL_OK, or EOF when the socket couldn't be made
+int run_server(const char* path, int workers);
+
+#endif
@@ -0,0 +1,596 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calql8r.h"
+#include "shm.h"
+
+#ifdef __linux__
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_DIRECTORY "/dev/shm/"
+#define SHM_MAGIC 0x384c4143u
+#define SHM_RING_SIZE (256 * 1024)
+#define SHM_RING_MASK (SHM_RING_SIZE - 1)
+#define SHM_RECORD_ALIGNMENT 8
+#define SHM_WRAP 0xffffffffu
+// a few microseconds of spinning before going to sleep, most answers come back sooner than that.
+// Busy polling gives the CPU away this often so the other side still gets to run on a machine with few cores
+#define SHM_SPINS 128
+#define SHM_MAX_CHANNELS 1024
+
+// futex that is only woken up (a system call) when the other side said it is sleeping on it
+struct ShmSignal{
+    _Atomic uint32_t sequence;
+    _Atomic uint32_t sleeping;
+};
+
+// records of a 4 byte length and the bytes, 8 byte aligned. head and tail only go up,
+// their position in 'records' is the bottom bits. A record that doesn't fit before the end of
+// 'records' goes to the start and the rest of the end is marked with SHM_WRAP
+struct ShmRing{
+    // the reader's side
+    _Alignas(64) _Atomic uint64_t head;
+    struct ShmSignal space;
+    // the writer's side
+    _Alignas(64) _Atomic uint64_t tail;
+    struct ShmSignal data;
+    _Alignas(64) unsigned char records[SHM_RING_SIZE];
+};
+
+struct ShmChannel{
+    // pid of the client that has the channel, 0 when it is free
+    _Alignas(64) _Atomic int32_t claimed;
+    _Atomic uint32_t busy_poll;
+    // set by a client taking over the channel of a client that died, the server's thread empties the rings and clears it
+    _Atomic uint32_t reset;
+    struct ShmRing requests;
+    struct ShmRing answers;
+};
+
+struct ShmSegment{
+    uint32_t magic;
+    uint32_t channels;
+    int32_t pid;
+    _Atomic uint32_t stop;
+    struct ShmChannel channel[];
+};
+
+struct ShmAnswer{
+    double value;
+    long long integer;
+    int status;
+    int exact;
+};
+_Static_assert(SHM_MAX_PENDING * ((sizeof (uint32_t) + sizeof (struct ShmAnswer) + SHM_RECORD_ALIGNMENT - 1) & ~(size_t) (SHM_RECORD_ALIGNMENT - 1)) <= SHM_RING_SIZE,
+    "the answer ring has to hold the answers of SHM_MAX_PENDING expressions");
+
+// one side of a ring in the memory of the process using it, 'position' is the head of a reader or
+// the tail of a writer and 'cached' the last value seen of the other one so it isn't read every time
+struct RingEnd{
+    struct ShmRing* ring;
+    uint64_t position;
+    uint64_t cached;
+    const _Atomic uint32_t* busy_poll;
+    const _Atomic uint32_t* stop;
+    // the server's thread also stops waiting when the channel is reset, NULL for a client
+    const _Atomic uint32_t* reset;
+    // how long to spin before sleeping, 0 with one CPU because the other side can't run while this one spins
+    int spins;
+};
+
+struct ShmWorker{
+    struct ShmServer* server;
+    struct ShmChannel* channel;
+    struct CalQl8r* ctx;
+    pthread_t thread;
+};
+
+struct ShmServer{
+    char* path;
+    struct ShmSegment* segment;
+    size_t size;
+    struct ShmWorker* workers;
+    int workers_length;
+};
+
+struct ShmClient{
+    struct ShmSegment* segment;
+    size_t size;
+    struct ShmChannel* channel;
+    struct RingEnd requests;
+    struct RingEnd answers;
+    // sent and not received yet
+    long long pending;
+};
+
+static inline void cpu_relax(void){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static inline uint32_t record_size(size_t length){
+    return (uint32_t) ((sizeof (uint32_t) + length + SHM_RECORD_ALIGNMENT - 1) & ~(size_t) (SHM_RECORD_ALIGNMENT - 1));
+}
+
+// the segment can be in another process so these can't be the private futexes
+void futex_wait(_Atomic uint32_t* word, uint32_t value){
+    syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+void futex_wake(_Atomic uint32_t* word){
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// the server stopped or (for the server's thread) the channel has to be reset
+static inline int ring_interrupted(const struct RingEnd* end){
+    return atomic_load(end->stop) || (end->reset != NULL && atomic_load(end->reset));
+}
+
+// Sleeps unless 'watched' moved on from 'seen' or the wait was interrupted. Saying it sleeps before looking
+// again means the other side either sees that and wakes it up or it sees the change itself
+void signal_sleep(struct ShmSignal* signal, const _Atomic uint64_t* watched, uint64_t seen, const struct RingEnd* end){
+    const uint32_t sequence = atomic_load(&signal->sequence);
+    atomic_store(&signal->sleeping, 1);
+    if(atomic_load(watched) == seen && !ring_interrupted(end)) futex_wait(&signal->sequence, sequence);
+    atomic_store(&signal->sleeping, 0);
+}
+
+void signal_wake(struct ShmSignal* signal){
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&signal->sleeping, memory_order_relaxed)){
+        atomic_fetch_add(&signal->sequence, 1);
+        futex_wake(&signal->sequence);
+    }
+}
+
+// spins for a while (or forever with busy polling) before sleeping, 0 when the server stopped or the channel is reset
+int ring_wait(struct RingEnd* end, int* spins, struct ShmSignal* signal, const _Atomic uint64_t* watched, uint64_t seen){
+    if(atomic_load_explicit(end->stop, memory_order_relaxed)) return 0;
+    if(end->reset != NULL && atomic_load_explicit(end->reset, memory_order_relaxed)) return 0;
+    ++*spins;
+    if(atomic_load_explicit(end->busy_poll, memory_order_relaxed)){
+        if(*spins % SHM_SPINS == 0 || end->spins == 0) sched_yield();
+        else cpu_relax();
+        return 1;
+    }
+    if(*spins < end->spins){
+        cpu_relax();
+        return 1;
+    }
+    signal_sleep(signal, watched, seen, end);
+    return 1;
+}
+
+void ring_end_init(struct RingEnd* end, struct ShmRing* ring, int writer, const _Atomic uint32_t* busy_poll, const _Atomic uint32_t* stop, const _Atomic uint32_t* reset){
+    end->ring = ring;
+    end->position = atomic_load(writer ? &ring->tail : &ring->head);
+    end->cached = atomic_load(writer ? &ring->head : &ring->tail);
+    end->busy_poll = busy_poll;
+    end->stop = stop;
+    end->reset = reset;
+    end->spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPINS : 0;
+}
+
+// writes one record, waits while the ring is full. CAL_OK, CAL_ERROR_MEMORY or SHM_ERROR_STOPPED (also when the channel is reset)
+int ring_push(struct RingEnd* end, const void* payload, size_t length){
+    struct ShmRing* ring = end->ring;
+    const uint32_t size = record_size(length);
+    if(size > SHM_RING_SIZE / 2) return CAL_ERROR_MEMORY;
+
+    const uint32_t offset = (uint32_t) (end->position & SHM_RING_MASK);
+    const uint32_t skip = SHM_RING_SIZE - offset < size ? SHM_RING_SIZE - offset : 0;
+    int spins = 0;
+    while(end->position + skip + size - end->cached > SHM_RING_SIZE){
+        end->cached = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if(end->position + skip + size - end->cached <= SHM_RING_SIZE) break;
+        if(!ring_wait(end, &spins, &ring->space, &ring->head, end->cached)) return SHM_ERROR_STOPPED;
+    }
+
+    if(skip > 0){
+        memcpy(ring->records + offset, &(uint32_t){SHM_WRAP}, sizeof (uint32_t));
+        end->position += skip;
+    }
+    unsigned char* record = ring->records + (end->position & SHM_RING_MASK);
+    const uint32_t record_length = (uint32_t) length;
+    memcpy(record, &record_length, sizeof record_length);
+    memcpy(record + sizeof record_length, payload, length);
+    end->position += size;
+
+    atomic_store_explicit(&ring->tail, end->position, memory_order_release);
+    signal_wake(&ring->data);
+    return CAL_OK;
+}
+
+// the next record without taking it out, waits while the ring is empty. NULL when the server stopped or the channel is reset
+const unsigned char* ring_peek(struct RingEnd* end, uint32_t* length){
+    struct ShmRing* ring = end->ring;
+    int spins = 0;
+    for(;;){
+        if(end->position == end->cached) end->cached = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if(end->position == end->cached){
+            if(!ring_wait(end, &spins, &ring->data, &ring->tail, end->position)) return NULL;
+            continue;
+        }
+
+        const unsigned char* record = ring->records + (end->position & SHM_RING_MASK);
+        memcpy(length, record, sizeof (uint32_t));
+        if(*length == SHM_WRAP){
+            end->position += SHM_RING_SIZE - (end->position & SHM_RING_MASK);
+            continue;
+        }
+        return record + sizeof (uint32_t);
+    }
+}
+
+// takes out the record ring_peek gave, the writer can use its space again
+void ring_pop(struct RingEnd* end, uint32_t length){
+    end->position += record_size(length);
+    atomic_store_explicit(&end->ring->head, end->position, memory_order_release);
+    signal_wake(&end->ring->space);
+}
+
+void ring_reset(struct ShmRing* ring){
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->space.sleeping, 0);
+    atomic_store(&ring->data.sleeping, 0);
+}
+
+// Empties the rings of a channel whose client died with expressions or answers still in them (or waiting on a full
+// ring) so the client that took it over starts from nothing. Gives 0 when the server stopped instead
+int worker_reset(struct ShmWorker* worker, struct RingEnd* requests, struct RingEnd* answers){
+    struct ShmSegment* segment = worker->server->segment;
+    struct ShmChannel* channel = worker->channel;
+    if(atomic_load(&segment->stop) || !atomic_load(&channel->reset)) return 0;
+
+    ring_reset(&channel->requests);
+    ring_reset(&channel->answers);
+    ring_end_init(requests, &channel->requests, 0, &channel->busy_poll, &segment->stop, &channel->reset);
+    ring_end_init(answers, &channel->answers, 1, &channel->busy_poll, &segment->stop, &channel->reset);
+    atomic_store(&channel->reset, 0);
+    return 1;
+}
+
+void* shm_worker_main(void* arg){
+    struct ShmWorker* worker = (struct ShmWorker*) arg;
+    struct ShmSegment* segment = worker->server->segment;
+    struct ShmChannel* channel = worker->channel;
+    struct RingEnd requests;
+    struct RingEnd answers;
+    ring_end_init(&requests, &channel->requests, 0, &channel->busy_poll, &segment->stop, &channel->reset);
+    ring_end_init(&answers, &channel->answers, 1, &channel->busy_poll, &segment->stop, &channel->reset);
+
+    for(;;){
+        uint32_t length;
+        const unsigned char* text = ring_peek(&requests, &length);
+        if(text == NULL){
+            if(worker_reset(worker, &requests, &answers)) continue;
+            break;
+        }
+
+        struct ShmAnswer answer;
+        answer.value = 0;
+        answer.integer = 0;
+        answer.status = calql8r_eval_exact(worker->ctx, (const char *) text, length, &answer.value, &answer.integer, &answer.exact);
+        ring_pop(&requests, length);
+        if(ring_push(&answers, &answer, sizeof answer) != CAL_OK){
+            if(worker_reset(worker, &requests, &answers)) continue;
+            break;
+        }
+    }
+    return NULL;
+}
+
+char* segment_path(const char* name){
+    if(name[0] == '\0' || strchr(name, '/') != NULL) return NULL;
+    char* path = (char *) malloc(strlen(SHM_DIRECTORY) + strlen(name) + 1);
+    if(path == NULL) return NULL;
+    strcpy(path, SHM_DIRECTORY);
+    strcat(path, name);
+    return path;
+}
+
+// a process that doesn't exist anymore
+int process_gone(int32_t pid){
+    return kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+// a segment of a server process that doesn't exist anymore
+int stale_segment(const char* path){
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return 0;
+    struct ShmSegment header;
+    const int complete = pread(fd, &header, sizeof header, 0) == (ssize_t) sizeof header;
+    close(fd);
+    return complete && header.magic == SHM_MAGIC && process_gone(header.pid);
+}
+
+size_t segment_size(int channels){
+    return sizeof (struct ShmSegment) + sizeof (struct ShmChannel) * channels;
+}
+
+struct ShmServer* shm_server_create(const char* name, int channels){
+    if(channels < 1 || channels > SHM_MAX_CHANNELS) return NULL;
+    struct ShmServer* server = (struct ShmServer*) calloc(1, sizeof (struct ShmServer));
+    if(server == NULL) return NULL;
+    server->path = segment_path(name);
+    server->workers = (struct ShmWorker*) calloc(channels, sizeof (struct ShmWorker));
+    if(server->path == NULL || server->workers == NULL){
+        shm_server_destroy(server);
+        return NULL;
+    }
+
+    if(stale_segment(server->path)) unlink(server->path);
+    const int fd = open(server->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if(fd < 0){
+        shm_server_destroy(server);
+        return NULL;
+    }
+
+    // the new pages are zeros so every ring starts empty and every channel free
+    server->size = segment_size(channels);
+    void* memory = ftruncate(fd, server->size) == 0 ? mmap(NULL, server->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(memory == MAP_FAILED){
+        unlink(server->path);
+        shm_server_destroy(server);
+        return NULL;
+    }
+    server->segment = (struct ShmSegment*) memory;
+    server->segment->channels = (uint32_t) channels;
+    server->segment->pid = (int32_t) getpid();
+
+    for(int i = 0; i < channels; i++){
+        struct ShmWorker* worker = &server->workers[i];
+        worker->server = server;
+        worker->channel = &server->segment->channel[i];
+        worker->ctx = calql8r_create();
+        if(worker->ctx == NULL || pthread_create(&worker->thread, NULL, shm_worker_main, worker) != 0){
+            calql8r_destroy(worker->ctx);
+            shm_server_destroy(server);
+            return NULL;
+        }
+        server->workers_length++;
+    }
+
+    // clients only use the segment once they see the magic
+    atomic_thread_fence(memory_order_release);
+    server->segment->magic = SHM_MAGIC;
+    return server;
+}
+
+void shm_server_destroy(struct ShmServer* server){
+    if(server == NULL) return;
+
+    if(server->segment != NULL){
+        struct ShmSegment* segment = server->segment;
+        atomic_store(&segment->stop, 1);
+
+        // everyone sleeping on the segment, the server's threads and the clients, wakes up and sees the stop
+        for(uint32_t i = 0; i < segment->channels; i++){
+            struct ShmSignal* signals[4] = {
+                &segment->channel[i].requests.data, &segment->channel[i].requests.space,
+                &segment->channel[i].answers.data, &segment->channel[i].answers.space
+            };
+            for(int s = 0; s < 4; s++){
+                atomic_fetch_add(&signals[s]->sequence, 1);
+                futex_wake(&signals[s]->sequence);
+            }
+        }
+        for(int i = 0; i < server->workers_length; i++){
+            pthread_join(server->workers[i].thread, NULL);
+            calql8r_destroy(server->workers[i].ctx);
+        }
+        munmap(segment, server->size);
+        unlink(server->path);
+    }
+
+    free(server->path);
+    free(server->workers);
+    free(server);
+}
+
+int run_shm_server(const char* name, int channels){
+    // blocked before the threads start so only this thread gets them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct ShmServer* server = shm_server_create(name, channels);
+    if(server == NULL) return EOF;
+
+    int received;
+    sigwait(&signals, &received);
+    shm_server_destroy(server);
+    return CAL_OK;
+}
+
+struct ShmClient* shm_client_open(const char* name, int busy_poll){
+    char* path = segment_path(name);
+    if(path == NULL) return NULL;
+    const int fd = open(path, O_RDWR | O_CLOEXEC);
+    free(path);
+    if(fd < 0) return NULL;
+
+    struct stat file;
+    void* memory = MAP_FAILED;
+    if(fstat(fd, &file) == 0 && (size_t) file.st_size >= sizeof (struct ShmSegment)){
+        memory = mmap(NULL, file.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(memory == MAP_FAILED) return NULL;
+
+    struct ShmSegment* segment = (struct ShmSegment*) memory;
+    const uint32_t magic = segment->magic;
+    atomic_thread_fence(memory_order_acquire);
+    struct ShmClient* client = NULL;
+    if(magic == SHM_MAGIC && (size_t) file.st_size == segment_size(segment->channels)){
+        client = (struct ShmClient*) calloc(1, sizeof (struct ShmClient));
+    }
+    if(client == NULL){
+        munmap(memory, file.st_size);
+        return NULL;
+    }
+    client->segment = segment;
+    client->size = file.st_size;
+
+    // a free channel, or else one whose client died without closing it
+    const int32_t pid = (int32_t) getpid();
+    int reclaimed = 0;
+    for(uint32_t i = 0; i < segment->channels && client->channel == NULL; i++){
+        int32_t free_channel = 0;
+        if(atomic_compare_exchange_strong(&segment->channel[i].claimed, &free_channel, pid)) client->channel = &segment->channel[i];
+    }
+    for(uint32_t i = 0; i < segment->channels && client->channel == NULL; i++){
+        int32_t owner = atomic_load(&segment->channel[i].claimed);
+        if(owner != 0 && process_gone(owner) && atomic_compare_exchange_strong(&segment->channel[i].claimed, &owner, pid)){
+            client->channel = &segment->channel[i];
+            reclaimed = 1;
+        }
+    }
+    if(client->channel == NULL){
+        munmap(memory, client->size);
+        free(client);
+        return NULL;
+    }
+
+    // A client that closed the channel received every answer so the rings are empty and carry on from where
+    // it left them. One that died can have left expressions, answers or the server's thread waiting on a full
+    // ring, the thread empties the rings first
+    struct ShmChannel* channel = client->channel;
+    if(reclaimed){
+        atomic_store(&channel->reset, 1);
+        struct ShmSignal* signals[2] = {&channel->requests.data, &channel->answers.space};
+        for(int s = 0; s < 2; s++){
+            atomic_fetch_add(&signals[s]->sequence, 1);
+            futex_wake(&signals[s]->sequence);
+        }
+        while(atomic_load(&channel->reset) && !atomic_load(&segment->stop) && !process_gone(segment->pid)) sched_yield();
+        if(atomic_load(&channel->reset)){
+            atomic_store(&channel->claimed, 0);
+            munmap(memory, client->size);
+            free(client);
+            return NULL;
+        }
+    }
+    atomic_store(&channel->busy_poll, busy_poll ? 1 : 0);
+    ring_end_init(&client->requests, &channel->requests, 1, &channel->busy_poll, &segment->stop, NULL);
+    ring_end_init(&client->answers, &channel->answers, 0, &channel->busy_poll, &segment->stop, NULL);
+    return client;
+}
+
+void shm_client_close(struct ShmClient* client){
+    if(client == NULL) return;
+
+    double result;
+    long long integer;
+    int exact;
+    while(client->pending > 0 && shm_client_receive(client, &result, &integer, &exact) != SHM_ERROR_STOPPED);
+
+    atomic_store(&client->channel->busy_poll, 0);
+    atomic_store(&client->channel->claimed, 0);
+    munmap(client->segment, client->size);
+    free(client);
+}
+
+int shm_client_send(struct ShmClient* client, const char* text, size_t length){
+    if(client->pending >= SHM_MAX_PENDING) return SHM_ERROR_FULL;
+    const int status = ring_push(&client->requests, text, length);
+    if(status == CAL_OK) client->pending++;
+    return status;
+}
+
+int shm_client_receive(struct ShmClient* client, double* result, long long* integer, int* exact){
+    uint32_t length;
+    const unsigned char* record = ring_peek(&client->answers, &length);
+    if(record == NULL) return SHM_ERROR_STOPPED;
+
+    struct ShmAnswer answer;
+    memcpy(&answer, record, sizeof answer);
+    ring_pop(&client->answers, length);
+    client->pending--;
+
+    *result = answer.value;
+    *integer = answer.integer;
+    *exact = answer.exact;
+    return answer.status;
+}
+
+int shm_client_eval(struct ShmClient* client, const char* text, size_t length, double* result){
+    const int status = shm_client_send(client, text, length);
+    if(status != CAL_OK) return status;
+
+    long long integer;
+    int exact;
+    return shm_client_receive(client, result, &integer, &exact);
+}
+
+#else
+
+struct ShmServer* shm_server_create(const char* name, int channels){
+    (void) name;
+    (void) channels;
+    return NULL;
+}
+
+void shm_server_destroy(struct ShmServer* server){
+    (void) server;
+}
+
+int run_shm_server(const char* name, int channels){
+    (void) name;
+    (void) channels;
+    return EOF;
+}
+
+struct ShmClient* shm_client_open(const char* name, int busy_poll){
+    (void) name;
+    (void) busy_poll;
+    return NULL;
+}
+
+void shm_client_close(struct ShmClient* client){
+    (void) client;
+}
+
+int shm_client_send(struct ShmClient* client, const char* text, size_t length){
+    (void) client;
+    (void) text;
+    (void) length;
+    return SHM_ERROR_STOPPED;
+}
+
+int shm_client_receive(struct ShmClient* client, double* result, long long* integer, int* exact){
+    (void) client;
+    (void) result;
+    (void) integer;
+    (void) exact;
+    return SHM_ERROR_STOPPED;
+}
+
+int shm_client_eval(struct ShmClient* client, const char* text, size_t length, double* result){
+    (void) client;
+    (void) text;
+    (void) length;
+    (void) result;
+    return SHM_ERROR_STOPPED;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CALQL8R_SHM_H
+#define CALQL8R_SHM_H
+
+#include <stddef.h>
+#include "calql8r.h"
+
+// the server of a shared memory segment stopped while a client was waiting on it
+#define SHM_ERROR_STOPPED -100
+// shm_client_send was called with SHM_MAX_PENDING answers still to receive
+#define SHM_ERROR_FULL -101
+
+// how many expressions a client can send before it has to receive answers, the answer ring holds no more.
+// With more the server's thread would wait on the client to take answers while the client waits on it to take expressions
+#define SHM_MAX_PENDING 8192
+
+// Calculator on shared memory for processes on the same machine that can't wait for a socket.
+// The server makes /dev/shm/<name> with 'channels' channels and a thread for each one.
+// A client process claims a free channel, which is a ring of expressions it writes and a ring of answers
+// the server's thread writes back, each with exactly one writer and one reader so neither needs a lock.
+// Whoever waits on an empty (or full) ring spins for a moment and then sleeps on a futex the other
+// side only wakes when someone is sleeping, or with busy polling never sleeps at all.
+// Only on Linux, on other systems shm_server_create and shm_client_open give NULL.
+struct ShmServer;
+struct ShmClient;
+
+// Makes the segment (one left over from a server that is gone is replaced) and starts a thread per channel
+struct ShmServer* shm_server_create(const char* name, int channels);
+
+// stops the threads and removes the segment, clients still attached get SHM_ERROR_STOPPED
+void shm_server_destroy(struct ShmServer* server);
+
+// shm_server_create and then waits for SIGINT or SIGTERM before shm_server_destroy.
+// Returns CAL_OK, or EOF when the segment couldn't be made
+int run_shm_server(const char* name, int channels);
+
+// Claims a free channel of the segment 'name', NULL when there is none (or no segment).
+// The channel of a client process that died without closing it is free again once its rings are emptied.
+// With 'busy_poll' both this client and the server's thread of the channel spin instead of sleeping,
+// the fastest answers for the price of two busy cores.
+struct ShmClient* shm_client_open(const char* name, int busy_poll);
+
+// waits for the answers still on the way and gives the channel back
+void shm_client_close(struct ShmClient* client);
+
+// Puts an expression in the ring without waiting for its answer (unless the ring is full), so up to
+// SHM_MAX_PENDING can be on the way at once. Returns CAL_OK, CAL_ERROR_MEMORY when the expression is longer
+// than half the ring, SHM_ERROR_FULL when SHM_MAX_PENDING answers have to be received first or SHM_ERROR_STOPPED
+int shm_client_send(struct ShmClient* client, const char* text, size_t length);
+
+// The answer of the oldest expression sent, in the same order they were sent.
+// Returns its status like calql8r_eval_exact, or SHM_ERROR_STOPPED
+int shm_client_receive(struct ShmClient* client, double* result, long long* integer, int* exact);
+
+// shm_client_send and shm_client_receive of one expression, same answer as calql8r_eval
+int shm_client_eval(struct ShmClient* client, const char* text, size_t length, double* result);
+
+#endif
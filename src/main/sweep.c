@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "calql8r.h"
+#include "batch.h"
+#include "sweep.h"
+
+// points a thread calculates at a time, their answers are written out together
+#define SWEEP_CHUNK_SIZE (64 * 1024)
+// the longest CSV line, two values and an answer of at most 24 characters each
+#define SWEEP_LINE_LENGTH 96
+
+// 'length' points starting at point 'first' of the grid
+struct SweepChunk{
+    double* values[SWEEP_MAX_RANGES];
+    double* answers;
+    struct OutputBuffer out;
+    size_t first;
+    size_t length;
+    int status;
+};
+
+struct Sweep;
+
+// a thread has two chunks, one for the round being calculated and one for the round being written
+struct SweepWorker{
+    struct Sweep* sweep;
+    struct SweepChunk chunks[2];
+    pthread_t thread;
+    int id;
+};
+
+struct Sweep{
+    const struct CalQl8rProgram* program;
+    const struct SweepRange* ranges;
+    int ranges_length;
+    int format;
+    size_t points;
+
+    // the range of every variable of the program
+    int variable_ranges[SWEEP_MAX_RANGES];
+
+    struct SweepWorker* workers;
+    int threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    // the chunk of worker i in round r starts at point (r * threads + i) * SWEEP_CHUNK_SIZE
+    unsigned long round;
+    int busy_workers;
+    int stop;
+};
+
+int sweep_parse_range(const char* text, struct SweepRange* range){
+    const char* equals = strchr(text, '=');
+    if(equals == NULL || equals == text || (size_t) (equals - text) >= sizeof range->name) return CAL_ERROR_SYNTAX;
+    memcpy(range->name, text, equals - text);
+    range->name[equals - text] = '\0';
+
+    char* end;
+    const double start = strtod(equals + 1, &end);
+    if(end == equals + 1 || *end != ':') return CAL_ERROR_SYNTAX;
+    const char* stop_text = end + 1;
+    const double stop = strtod(stop_text, &end);
+    if(end == stop_text || *end != ':') return CAL_ERROR_SYNTAX;
+    const char* step_text = end + 1;
+    const double step = strtod(step_text, &end);
+    if(end == step_text || *end != '\0') return CAL_ERROR_SYNTAX;
+
+    // (stop - start) / step is a hair under a whole number when the last step lands on stop e.g 0:10:1e-6
+    const double steps = (stop - start) / step;
+    if(step == 0 || !isfinite(start) || !(steps >= 0) || steps > 1e15) return CAL_ERROR_SYNTAX;
+    range->start = start;
+    range->step = step;
+    range->count = (size_t) floor(steps * (1 + 1e-12) + 1e-9) + 1;
+    return CAL_OK;
+}
+
+// 'shortest' writes as few digits as still give exactly the same value, that is nice for the values of the ranges
+// but answers nearly always need all 17 and trying 15 first costs twice as much
+int sweep_number(char* buffer, double value, int shortest, char end){
+    if(isnan(value)){
+        memcpy(buffer, "nan", 3);
+        buffer[3] = end;
+        return 4;
+    }
+    int length = snprintf(buffer, SWEEP_LINE_LENGTH / 3, shortest ? "%.15g" : "%.17g", value);
+    if(shortest && strtod(buffer, NULL) != value) length = snprintf(buffer, SWEEP_LINE_LENGTH / 3, "%.17g", value);
+    buffer[length] = end;
+    return length + 1;
+}
+
+// the answers of the chunk, the values of the ranges are filled in first as the columns of the variables
+int sweep_chunk(const struct Sweep* sweep, struct SweepChunk* chunk){
+    const struct SweepRange* ranges = sweep->ranges;
+    const size_t length = chunk->length;
+
+    // the last range changes fastest, only the first one can be more than one step along at the end of a row
+    if(sweep->ranges_length == 1){
+        double* x = chunk->values[0];
+        for(size_t i = 0; i < length; i++) x[i] = ranges[0].start + (double) (chunk->first + i) * ranges[0].step;
+    } else {
+        double* x = chunk->values[0];
+        double* y = chunk->values[1];
+        size_t row = chunk->first / ranges[1].count;
+        size_t column = chunk->first % ranges[1].count;
+        for(size_t i = 0; i < length; i++){
+            x[i] = ranges[0].start + (double) row * ranges[0].step;
+            y[i] = ranges[1].start + (double) column * ranges[1].step;
+            if(++column == ranges[1].count){
+                column = 0;
+                row++;
+            }
+        }
+    }
+
+    const double* columns[SWEEP_MAX_RANGES];
+    const int variables = calql8r_program_variables(sweep->program);
+    for(int i = 0; i < variables; i++) columns[i] = chunk->values[sweep->variable_ranges[i]];
+    const int status = calql8r_run_columns(sweep->program, columns, length, chunk->answers);
+    if(status != CAL_OK || sweep->format != SWEEP_CSV) return status;
+
+    chunk->out.length = 0;
+    for(size_t i = 0; i < length; i++){
+        char line[SWEEP_LINE_LENGTH];
+        int line_length = 0;
+        for(int r = 0; r < sweep->ranges_length; r++) line_length += sweep_number(line + line_length, chunk->values[r][i], 1, ',');
+        line_length += sweep_number(line + line_length, chunk->answers[i], 0, '\n');
+        if(output_write(&chunk->out, line, line_length) != CAL_OK) return CAL_ERROR_MEMORY;
+    }
+    return CAL_OK;
+}
+
+int sweep_write(const struct Sweep* sweep, struct SweepChunk* chunk, FILE* output){
+    if(chunk->status != CAL_OK) return chunk->status;
+    if(sweep->format == SWEEP_CSV) return output_flush(&chunk->out, output);
+
+    // the answers are already little endian on nearly every machine
+    const unsigned int one = 1;
+    if(*(const unsigned char *) &one != 1){
+        for(size_t i = 0; i < chunk->length; i++){
+            unsigned char* bytes = (unsigned char *) &chunk->answers[i];
+            for(int b = 0; b < 4; b++){
+                const unsigned char swap = bytes[b];
+                bytes[b] = bytes[7 - b];
+                bytes[7 - b] = swap;
+            }
+        }
+    }
+    if(fwrite(chunk->answers, sizeof (double), chunk->length, output) != chunk->length) return EOF;
+    return CAL_OK;
+}
+
+int sweep_chunk_init(struct SweepChunk* chunk, int format){
+    chunk->answers = (double *) malloc(SWEEP_CHUNK_SIZE * sizeof (double) * (SWEEP_MAX_RANGES + 1));
+    chunk->values[0] = chunk->answers + SWEEP_CHUNK_SIZE;
+    chunk->values[1] = chunk->values[0] + SWEEP_CHUNK_SIZE;
+    chunk->length = 0;
+    chunk->status = CAL_OK;
+    chunk->out.data = NULL;
+    chunk->out.length = 0;
+    chunk->out.capacity = 0;
+    if(chunk->answers == NULL) return CAL_ERROR_MEMORY;
+    if(format == SWEEP_CSV) return output_init(&chunk->out, (size_t) SWEEP_CHUNK_SIZE * SWEEP_LINE_LENGTH / 2);
+    return CAL_OK;
+}
+
+void sweep_chunk_free(struct SweepChunk* chunk){
+    free(chunk->answers);
+    chunk->answers = NULL;
+    output_free(&chunk->out);
+}
+
+// the points of the chunk of thread 'id' in 'round'
+void sweep_place_chunk(const struct Sweep* sweep, struct SweepChunk* chunk, unsigned long round, int id){
+    const size_t first = ((size_t) round * sweep->threads + id) * SWEEP_CHUNK_SIZE;
+    chunk->first = first;
+    chunk->length = first >= sweep->points ? 0 : sweep->points - first < SWEEP_CHUNK_SIZE ? sweep->points - first : SWEEP_CHUNK_SIZE;
+}
+
+void* sweep_worker_main(void* arg){
+    struct SweepWorker* worker = (struct SweepWorker*) arg;
+    struct Sweep* sweep = worker->sweep;
+    unsigned long done = 0;
+
+    for(;;){
+        pthread_mutex_lock(&sweep->lock);
+        while(!sweep->stop && sweep->round == done) pthread_cond_wait(&sweep->work_ready, &sweep->lock);
+        if(sweep->stop){
+            pthread_mutex_unlock(&sweep->lock);
+            break;
+        }
+        const unsigned long round = sweep->round - 1;
+        done = sweep->round;
+        pthread_mutex_unlock(&sweep->lock);
+
+        struct SweepChunk* chunk = &worker->chunks[round & 1];
+        sweep_place_chunk(sweep, chunk, round, worker->id);
+        chunk->status = chunk->length > 0 ? sweep_chunk(sweep, chunk) : CAL_OK;
+
+        pthread_mutex_lock(&sweep->lock);
+        if(--sweep->busy_workers == 0) pthread_cond_signal(&sweep->work_done);
+        pthread_mutex_unlock(&sweep->lock);
+    }
+    return NULL;
+}
+
+// starts the next round, the one before has to be done
+void sweep_start_round(struct Sweep* sweep){
+    pthread_mutex_lock(&sweep->lock);
+    sweep->busy_workers = sweep->threads;
+    sweep->round++;
+    pthread_cond_broadcast(&sweep->work_ready);
+    pthread_mutex_unlock(&sweep->lock);
+}
+
+void sweep_wait_round(struct Sweep* sweep){
+    pthread_mutex_lock(&sweep->lock);
+    while(sweep->busy_workers > 0) pthread_cond_wait(&sweep->work_done, &sweep->lock);
+    pthread_mutex_unlock(&sweep->lock);
+}
+
+// every round the threads calculate the chunks of the next round while the answers of the last one are written
+int sweep_threads(struct Sweep* sweep, FILE* output){
+    int started = 0;
+    int status = CAL_OK;
+    for(int i = 0; i < sweep->threads && status == CAL_OK; i++){
+        struct SweepWorker* worker = &sweep->workers[i];
+        worker->sweep = sweep;
+        worker->id = i;
+        if(sweep_chunk_init(&worker->chunks[0], sweep->format) != CAL_OK) status = CAL_ERROR_MEMORY;
+        if(sweep_chunk_init(&worker->chunks[1], sweep->format) != CAL_OK) status = CAL_ERROR_MEMORY;
+        if(status == CAL_OK && pthread_create(&worker->thread, NULL, sweep_worker_main, worker) != 0) status = CAL_ERROR_MEMORY;
+        if(status == CAL_OK) started++;
+    }
+
+    const size_t round_points = (size_t) sweep->threads * SWEEP_CHUNK_SIZE;
+    const unsigned long rounds = (unsigned long) ((sweep->points + round_points - 1) / round_points);
+    if(status == CAL_OK && rounds > 0) sweep_start_round(sweep);
+    for(unsigned long round = 0; round < rounds && status == CAL_OK; round++){
+        sweep_wait_round(sweep);
+        if(round + 1 < rounds) sweep_start_round(sweep);
+        for(int i = 0; i < sweep->threads && status == CAL_OK; i++) status = sweep_write(sweep, &sweep->workers[i].chunks[round & 1], output);
+    }
+
+    // a round that was started before an error has to finish before the threads stop
+    sweep_wait_round(sweep);
+    pthread_mutex_lock(&sweep->lock);
+    sweep->stop = 1;
+    pthread_cond_broadcast(&sweep->work_ready);
+    pthread_mutex_unlock(&sweep->lock);
+    for(int i = 0; i < sweep->threads; i++){
+        if(i < started) pthread_join(sweep->workers[i].thread, NULL);
+        sweep_chunk_free(&sweep->workers[i].chunks[0]);
+        sweep_chunk_free(&sweep->workers[i].chunks[1]);
+    }
+    return status;
+}
+
+int run_sweep(const struct CalQl8rProgram* program, const struct SweepRange* ranges, int ranges_length, int format, FILE* output, int threads){
+    struct Sweep sweep;
+    memset(&sweep, 0, sizeof sweep);
+    sweep.program = program;
+    sweep.ranges = ranges;
+    sweep.ranges_length = ranges_length;
+    sweep.format = format;
+    sweep.points = ranges_length == 1 ? ranges[0].count : ranges[0].count * ranges[1].count;
+
+    for(int i = 0; i < calql8r_program_variables(program); i++){
+        int r = 0;
+        while(r < ranges_length && strcmp(ranges[r].name, calql8r_program_variable(program, i)) != 0) r++;
+        if(r == ranges_length) return CAL_ERROR_SYNTAX;
+        sweep.variable_ranges[i] = r;
+    }
+
+    if(format == SWEEP_CSV){
+        char header[3 * sizeof ranges->name + 8];
+        int length = 0;
+        for(int r = 0; r < ranges_length; r++) length += snprintf(header + length, sizeof header - length, "%s,", ranges[r].name);
+        length += snprintf(header + length, sizeof header - length, "answer\n");
+        if(fwrite(header, 1, length, output) != (size_t) length) return EOF;
+    }
+
+    // one thread calculates and writes one chunk after the other
+    if(threads <= 1){
+        struct SweepChunk chunk;
+        int status = sweep_chunk_init(&chunk, format);
+        sweep.threads = 1;
+        for(unsigned long round = 0; status == CAL_OK && round * SWEEP_CHUNK_SIZE < sweep.points; round++){
+            sweep_place_chunk(&sweep, &chunk, round, 0);
+            chunk.status = sweep_chunk(&sweep, &chunk);
+            status = sweep_write(&sweep, &chunk, output);
+        }
+        sweep_chunk_free(&chunk);
+        return status;
+    }
+
+    sweep.threads = threads;
+    sweep.workers = (struct SweepWorker*) calloc(threads, sizeof (struct SweepWorker));
+    if(sweep.workers == NULL) return CAL_ERROR_MEMORY;
+    pthread_mutex_init(&sweep.lock, NULL);
+    pthread_cond_init(&sweep.work_ready, NULL);
+    pthread_cond_init(&sweep.work_done, NULL);
+
+    const int status = sweep_threads(&sweep, output);
+
+    pthread_mutex_destroy(&sweep.lock);
+    pthread_cond_destroy(&sweep.work_ready);
+    pthread_cond_destroy(&sweep.work_done);
+    free(sweep.workers);
+    return status;
+}
@@ -0,0 +1,36 @@
+#ifndef CALQL8R_SWEEP_H
+#define CALQL8R_SWEEP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "calql8r.h"
+
+// a sweep goes over one variable or a grid of two
+#define SWEEP_MAX_RANGES 2
+
+#define SWEEP_RAW 0
+#define SWEEP_CSV 1
+
+// 'count' values of a variable from 'start' in steps of 'step', value i is start + i * step
+struct SweepRange{
+    char name[64];
+    double start;
+    double step;
+    size_t count;
+};
+
+// Reads "x=0:10:1e-6" (name=start:stop:step) into 'range'. 'stop' is the last value when a step lands on it
+// (give or take rounding), a negative step goes down. Gives CAL_ERROR_SYNTAX when it can't be read or the step
+// goes away from 'stop'.
+int sweep_parse_range(const char* text, struct SweepRange* range);
+
+// Calculates the program on every point of the grid of 'ranges' and writes the answers to 'output' in order,
+// the last range changes fastest (a grid of x and y is one row of y values after the other for every x).
+// SWEEP_RAW writes the answers as little endian doubles, SWEEP_CSV a line per point with its values and the answer.
+// Points that can't be calculated are NAN. Every variable of the program needs a range.
+// The points are calculated in chunks with calql8r_run_columns spread over 'threads' threads, the chunks
+// of the next round are calculated while the answers of the last one are written.
+// Returns CAL_OK, CAL_ERROR_MEMORY or EOF when writing failed.
+int run_sweep(const struct CalQl8rProgram* program, const struct SweepRange* ranges, int ranges_length, int format, FILE* output, int threads);
+
+#endif